@@ -21,6 +21,9 @@
 
 #include "nanomysql.h"
 
+#include <algorithm>
+#include <sstream>
+
 
 namespace slave
 {
@@ -60,7 +63,10 @@ void Slave::init()
 
     check_master_binlog_format();
 
-    ext_state.loadMasterInfo( m_master_info.master_log_name, m_master_info.master_log_pos);
+    if (m_master_info.auto_position)
+        ext_state.loadMasterGtidSet(m_gtid_executed);
+    else
+        ext_state.loadMasterInfo( m_master_info.master_log_name, m_master_info.master_log_pos);
 
     LOG_TRACE(log, "Libslave initialized OK");
 }
@@ -73,111 +79,365 @@ void Slave::close_connection()
 }
 
 
-void Slave::createDatabaseStructure_(table_order_t& tabs, RelayLogInfo& rli) const {
+namespace
+{
+
+// "int(10) unsigned" -> "int"
+std::string extract_type(const std::string& type) {
+
+    std::string extract_field;
+
+    for (size_t tmpi = 0; tmpi < type.size(); ++tmpi) {
+
+        if (!((type[tmpi] >= 'a' && type[tmpi] <= 'z') ||
+              (type[tmpi] >= 'A' && type[tmpi] <= 'Z'))) {
+
+            extract_field = type.substr(0, tmpi);
+            break;
+        }
+
+        if (tmpi == type.size()-1) {
+            extract_field = type;
+            break;
+        }
+    }
+
+    if (extract_field.empty())
+        throw std::runtime_error("Slave::create_table(): Regexp error, type not found");
+
+    return extract_field;
+}
+
+// Column type as TABLE_MAP events have it (enum_field_types), with the variants
+// of one type (blob sizes...) reduced to one. The old and the 5.6.4+ temporal storage
+// stay apart: they are decoded differently.
+unsigned char binlog_type_family(unsigned char type) {
+
+    switch (type) {
+    case 0:   return 246;   // DECIMAL -> NEWDECIMAL
+    case 14:  return 10;    // NEWDATE -> DATE
+    case 253: return 15;    // VAR_STRING -> VARCHAR
+    case 247:               // ENUM
+    case 248: return 254;   // SET -> STRING
+    case 249:               // TINY_BLOB
+    case 250:               // MEDIUM_BLOB
+    case 251: return 252;   // LONG_BLOB -> BLOB
+    }
+
+    return type;
+}
+
+// 0 if unknown. 'fractional_temporal' as in Slave::createTable().
+unsigned char binlog_type_family(const std::string& extract_field, bool fractional_temporal) {
+
+    if (fractional_temporal) {
+        if (extract_field == "timestamp")
+            return 17;      // TIMESTAMP2
+        if (extract_field == "datetime")
+            return 18;      // DATETIME2
+        if (extract_field == "time")
+            return 19;      // TIME2
+    }
+
+    static const struct {
+        const char* name;
+        unsigned char type;
+    } types[] = {
+        { "tinyint", 1 }, { "smallint", 2 }, { "int", 3 }, { "float", 4 }, { "double", 5 },
+        { "timestamp", 7 }, { "bigint", 8 }, { "mediumint", 9 }, { "date", 10 }, { "time", 11 },
+        { "datetime", 12 }, { "year", 13 }, { "varchar", 15 }, { "bit", 16 }, { "json", 245 },
+        { "decimal", 246 }, { "enum", 254 }, { "set", 254 }, { "char", 254 },
+        { "tinytext", 252 }, { "text", 252 }, { "mediumtext", 252 }, { "longtext", 252 },
+        { "tinyblob", 252 }, { "blob", 252 }, { "mediumblob", 252 }, { "longblob", 252 }
+    };
+
+    for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); ++i) {
+        if (extract_field == types[i].name)
+            return types[i].type;
+    }
+
+    return 0;
+}
+
+// Index of the column, or an exception naming the query
+size_t result_column(const nanomysql::Result& res, const std::string& name, const std::string& query) {
+
+    if (!res.has(name))
+        throw std::runtime_error("Slave::create_table(): " + query + " query did not return '" + name + "'");
+
+    return res.column(name);
+}
+
+// Text columns have a collation too, though it is not needed to decode them
+bool is_text(const std::string& extract_field) {
+    return extract_field == "tinytext" || extract_field == "text" ||
+           extract_field == "mediumtext" || extract_field == "longtext";
+}
+
+// A string literal for a query
+std::string quote(const std::string& s) {
+
+    std::string q = "'";
+
+    for (std::string::const_iterator i = s.begin(); i != s.end(); ++i) {
+        if (*i == '\'' || *i == '\\')
+            q += '\\';
+        q += *i;
+    }
+
+    return q + "'";
+}
+
+// Tables per information_schema query, see Slave::readColumns()
+const size_t COLUMNS_BATCH = 200;
+
+}// anonymous-namespace
+
+
+void Slave::createDatabaseStructure_(table_order_t& tabs, RelayLogInfo& rli, bool use_cache) const {
 
     LOG_TRACE(log, "enter: createDatabaseStructure");
 
-    nanomysql::Connection conn(m_master_info.host.c_str(), m_master_info.user.c_str(),
-                               m_master_info.password.c_str(), "", m_master_info.port);
-    const collate_map_t collate_map = readCollateMap(conn);
+    std::ostringstream master;
+    master << m_master_info.host << ":" << m_master_info.port;
+
+    SchemaCache cache;
 
+    if (use_cache && !m_schema_cache_path.empty() && cache.load(m_schema_cache_path) &&
+        !cache.validAt(master.str(), m_master_info.master_log_name, m_master_info.master_log_pos)) {
+
+        LOG_INFO(log, "Schema cache " << m_schema_cache_path << " is for " << cache.master << " "
+                 << cache.log_name << ":" << cache.log_pos << ", not using it.");
+        cache.tables.clear();
+    }
+
+    // The tables not in the cache are read from master all at once
+    table_order_t missing;
 
     for (table_order_t::const_iterator it = tabs.begin(); it != tabs.end(); ++ it) {
+        if (cache.tables.find(*it) == cache.tables.end())
+            missing.push_back(*it);
+    }
+
+    SchemaCache::tables_t read;
+
+    if (!missing.empty() && !m_lazy_structure)
+        readColumns(missing, read);
+
+    SchemaCache new_cache;
+    bool changed = false;
 
-        LOG_INFO( log, "Creating database structure for: " << it->first << ", Creating table for: " << it->second );
-        createTable(rli, it->first, it->second, collate_map, conn);
+    for (table_order_t::const_iterator it = tabs.begin(); it != tabs.end(); ++ it) {
+
+        SchemaCache::tables_t::const_iterator c = cache.tables.find(*it);
+
+        if (c != cache.tables.end()) {
+
+            LOG_DEBUG(log, "Creating table from the schema cache: " << it->first << "." << it->second);
+            createTable(rli, it->first, it->second, c->second);
+
+        } else if (m_lazy_structure) {
+
+            LOG_DEBUG(log, "Table " << it->first << "." << it->second << " is to be read on its first event");
+            continue;
+
+        } else {
+
+            LOG_INFO( log, "Creating database structure for: " << it->first << ", Creating table for: " << it->second );
+
+            c = read.find(*it);
+
+            // Not found by information_schema, maybe for the letter case of the name:
+            // SHOW FULL COLUMNS finds it or tells why not.
+            if (c == read.end())
+                c = read.insert(std::make_pair(*it, readColumns(it->first, it->second))).first;
+
+            createTable(rli, it->first, it->second, c->second);
+            changed = true;
+        }
+
+        new_cache.tables[*it] = rli.getTable(*it)->columns;
+    }
+
+    // Lazily read tables are not in it, so it is not saved: it would lose them
+    if ((changed || !use_cache) && !m_schema_cache_path.empty() && !m_lazy_structure) {
+
+        new_cache.master = master.str();
+        new_cache.log_name = m_master_info.master_log_name;
+        new_cache.log_pos = m_master_info.master_log_pos;
+
+        try {
+            new_cache.save(m_schema_cache_path);
+
+        } catch (const std::exception& e) {
+            LOG_WARNING(log, "Could not save the schema cache: " << e.what());
+        }
     }
 
     LOG_TRACE(log, "exit: createDatabaseStructure");
 }
 
 
+std::vector<ColumnInfo> Slave::readColumns(const std::string& db_name, const std::string& tbl_name) const {
 
-void Slave::createTable(RelayLogInfo& rli,
-                        const std::string& db_name, const std::string& tbl_name,
-                        const collate_map_t& collate_map, nanomysql::Connection& conn) const {
+    ConnectionPool::Lease lease(*m_meta_pool);
+    nanomysql::Connection& conn = *lease;
 
-    LOG_TRACE(log, "enter: createTable " << db_name << " " << tbl_name);
+    if (m_collate_map.empty())
+        m_collate_map = readCollateMap(conn);
+
+    nanomysql::Result res;
 
-    nanomysql::Connection::result_t res;
-    
     conn.query("SHOW FULL COLUMNS FROM " + tbl_name + " IN " + db_name);
     conn.store(res);
 
-    boost::shared_ptr<Table> table(new Table(db_name, tbl_name));
+    const size_t field_col = result_column(res, "Field", "DESCRIBE");
+    const size_t type_col = result_column(res, "Type", "DESCRIBE");
+    result_column(res, "Null", "DESCRIBE");
 
+    const bool has_key = res.has("Key");
+    const size_t key_col = has_key ? res.column("Key") : 0;
 
-    LOG_DEBUG(log, "Created new Table object: database:" << db_name << " table: " << tbl_name );
+    std::vector<ColumnInfo> columns;
+    columns.reserve(res.rows());
 
-    for (nanomysql::Connection::result_t::const_iterator i = res.begin(); i != res.end(); ++i) {
+    for (size_t i = 0; i < res.rows(); ++i) {
 
-        //row.at(0) - field name
-        //row.at(1) - field type
-        //row.at(2) - collation
-        //row.at(3) - can be null
+        ColumnInfo column;
 
+        column.name = res.str(i, field_col);
+        column.type = res.str(i, type_col);
+        column.primary = has_key && res.str(i, key_col) == "PRI";
 
-        std::map<std::string,nanomysql::field>::const_iterator z = i->find("Field");
+        const std::string extract_field = extract_type(column.type);
 
-        if (z == i->end())
-            throw std::runtime_error("Slave::create_table(): DESCRIBE query did not return 'Field'");
+        if ("varchar" == extract_field || "char" == extract_field)
+        {
+            if (!res.has("Collation"))
+                throw std::runtime_error("Slave::create_table(): DESCRIBE query did not return 'Collation' for field '" + column.name + "'");
+            column.collate = findCollate(res.str(i, res.column("Collation")), column);
+        }
+        else if (is_text(extract_field) && res.has("Collation") && !res.isNull(i, res.column("Collation")))
+            column.collate = findCollate(res.str(i, res.column("Collation")), column);
 
-        std::string name = z->second.data;
+        columns.push_back(column);
+    }
 
-        z = i->find("Type");
+    return columns;
+}
 
-        if (z == i->end())
-            throw std::runtime_error("Slave::create_table(): DESCRIBE query did not return 'Type'");
 
-        std::string type = z->second.data;
+void Slave::readColumns(const table_order_t& tabs, SchemaCache::tables_t& out) const {
 
-        z = i->find("Null");
+    ConnectionPool::Lease lease(*m_meta_pool);
+    nanomysql::Connection& conn = *lease;
 
-        if (z == i->end())
-            throw std::runtime_error("Slave::create_table(): DESCRIBE query did not return 'Null'");
+    if (m_collate_map.empty())
+        m_collate_map = readCollateMap(conn);
 
-        std::string extract_field;
+    const std::set<std::pair<std::string, std::string> > wanted(tabs.begin(), tabs.end());
 
-        // Extract field type
-        for (size_t tmpi = 0; tmpi < type.size(); ++tmpi) {
+    for (size_t start = 0; start < tabs.size(); start += COLUMNS_BATCH) {
 
-            if (!((type[tmpi] >= 'a' && type[tmpi] <= 'z') ||
-                  (type[tmpi] >= 'A' && type[tmpi] <= 'Z'))) {
+        // Database -> its tables in the batch
+        std::map<std::string, std::set<std::string> > batch;
 
-                extract_field = type.substr(0, tmpi);
-                break;
-            }
+        for (size_t i = start; i < tabs.size() && i < start + COLUMNS_BATCH; ++i)
+            batch[tabs[i].first].insert(tabs[i].second);
 
-            if (tmpi == type.size()-1) {
-                extract_field = type;
-                break;
+        std::string query = "SELECT TABLE_SCHEMA, TABLE_NAME, COLUMN_NAME, COLUMN_TYPE, COLUMN_KEY, COLLATION_NAME"
+                            " FROM information_schema.COLUMNS WHERE ";
+
+        for (std::map<std::string, std::set<std::string> >::const_iterator d = batch.begin(); d != batch.end(); ++d) {
+
+            if (d != batch.begin())
+                query += " OR ";
+
+            query += "(TABLE_SCHEMA = " + quote(d->first) + " AND TABLE_NAME IN (";
+
+            for (std::set<std::string>::const_iterator t = d->second.begin(); t != d->second.end(); ++t) {
+                if (t != d->second.begin())
+                    query += ", ";
+                query += quote(*t);
             }
+
+            query += "))";
         }
 
-        if (extract_field.empty())
-            throw std::runtime_error("Slave::create_table(): Regexp error, type not found");
+        query += " ORDER BY TABLE_SCHEMA, TABLE_NAME, ORDINAL_POSITION";
+
+        nanomysql::Result res;
+
+        conn.query(query);
+        conn.store(res);
+
+        for (size_t i = 0; i < res.rows(); ++i) {
+
+            const std::pair<std::string, std::string> key(res.str(i, 0), res.str(i, 1));
+
+            if (wanted.find(key) == wanted.end())
+                continue;
+
+            ColumnInfo column;
+
+            column.name = res.str(i, 2);
+            column.type = res.str(i, 3);
+            column.primary = res.str(i, 4) == "PRI";
+
+            const std::string extract_field = extract_type(column.type);
+
+            if ("varchar" == extract_field || "char" == extract_field ||
+                (is_text(extract_field) && !res.isNull(i, 5)))
+                column.collate = findCollate(res.str(i, 5), column);
+
+            out[key].push_back(column);
+        }
+    }
+}
+
+
+const collate_info& Slave::findCollate(const std::string& collate, const ColumnInfo& column) const {
+
+    collate_map_t::const_iterator it = m_collate_map.find(collate);
+
+    if (m_collate_map.end() == it)
+        throw std::runtime_error("Slave::create_table(): cannot find collate '" + collate + "' from field "
+                                 + column.name + " type " + column.type + " in collate info map");
+    return it->second;
+}
+
+
+void Slave::createTable(RelayLogInfo& rli,
+                        const std::string& db_name, const std::string& tbl_name,
+                        const std::vector<ColumnInfo>& columns) const {
+
+    LOG_TRACE(log, "enter: createTable " << db_name << " " << tbl_name);
+
+    boost::shared_ptr<Table> table(new Table(db_name, tbl_name));
+
+
+    LOG_DEBUG(log, "Created new Table object: database:" << db_name << " table: " << tbl_name );
+
+    for (std::vector<ColumnInfo>::const_iterator i = columns.begin(); i != columns.end(); ++i) {
+
+        const std::string& name = i->name;
+        const std::string& type = i->type;
+        const collate_info& ci = i->collate;
+
+        const std::string extract_field = extract_type(type);
 
-        collate_info ci;
         if ("varchar" == extract_field || "char" == extract_field)
-        {
-            z = i->find("Collation");
-            if (z == i->end())
-                throw std::runtime_error("Slave::create_table(): DESCRIBE query did not return 'Collation' for field '" + name + "'");
-            const std::string collate = z->second.data;
-            collate_map_t::const_iterator it = collate_map.find(collate);
-            if (collate_map.end() == it)
-                throw std::runtime_error("Slave::create_table(): cannot find collate '" + collate + "' from field "
-                                         + name + " type " + type + " in collate info map");
-            ci = it->second;
             LOG_DEBUG(log, "Created column: name-type: " << name << " - " << type
                       << " Field type: " << extract_field << " Collation: " << ci.name);
-        }
         else
             LOG_DEBUG(log, "Created column: name-type: " << name << " - " << type
                       << " Field type: " << extract_field );
 
         PtrField field;
 
+        // Since 5.6.4 new tables get the temporal types with fractional seconds
+        const bool fractional_temporal = (m_master_version >= 50604);
+
         if (extract_field == "int")
             field = PtrField(new Field_long(name, type));
 
@@ -188,10 +448,12 @@ void Slave::createTable(RelayLogInfo& rli,
             field = PtrField(new Field_float(name, type));
 
         else if (extract_field == "timestamp")
-            field = PtrField(new Field_timestamp(name, type));
+            field = fractional_temporal ? PtrField(new Field_timestamp2(name, type))
+                                        : PtrField(new Field_timestamp(name, type));
 
         else if (extract_field == "datetime")
-            field = PtrField(new Field_datetime(name, type));
+            field = fractional_temporal ? PtrField(new Field_datetime2(name, type))
+                                        : PtrField(new Field_datetime(name, type));
 
         else if (extract_field == "date")
             field = PtrField(new Field_date(name, type));
@@ -200,7 +462,8 @@ void Slave::createTable(RelayLogInfo& rli,
             field = PtrField(new Field_year(name, type));
 
         else if (extract_field == "time")
-            field = PtrField(new Field_time(name, type));
+            field = fractional_temporal ? PtrField(new Field_time2(name, type))
+                                        : PtrField(new Field_time(name, type));
 
         else if (extract_field == "enum")
             field = PtrField(new Field_enum(name, type));
@@ -250,21 +513,128 @@ void Slave::createTable(RelayLogInfo& rli,
         else if (extract_field == "longblob")
             field = PtrField(new Field_longblob(name, type));
 
+        else if (extract_field == "json")
+            field = PtrField(new Field_json(name, type));
+
+        else if (extract_field == "bit")
+            field = PtrField(new Field_bit(name, type));
+
+        else if (extract_field == "decimal")
+            field = PtrField(new Field_new_decimal(name, type));
+
         else {
             LOG_ERROR(log, "createTable: class name don't exist: " << extract_field );
             throw std::runtime_error("class name does not exist: " + extract_field);
         }
 
-        table->fields.push_back(field);
+        Field_longstr* str = dynamic_cast<Field_longstr*>(field.get());
+
+        if (str && !ci.charset.empty() && (m_transcode_utf8 || m_validate_utf8)) {
+
+            if (m_transcode_utf8 && !Transcoder::isSupported(ci.charset))
+                LOG_WARNING(log, "Column " << db_name << "." << tbl_name << "." << name << " is in charset "
+                            << ci.charset << ", its values are not transcoded to UTF-8.");
+
+            str->setTranscoder(Transcoder::find(ci.charset, m_transcode_utf8, m_validate_utf8));
+        }
+
+        if (m_epoch_tz) {
+            if (Field_temporal* temporal = dynamic_cast<Field_temporal*>(field.get()))
+                temporal->setEpoch(m_epoch_tz.get(), m_epoch_usec);
+        }
 
+        if (m_decimal_scaled) {
+
+            Field_new_decimal* decimal = dynamic_cast<Field_new_decimal*>(field.get());
+
+            if (decimal && !decimal->setScaled(true))
+                LOG_WARNING(log, "Column " << db_name << "." << tbl_name << "." << name << " is " << type
+                            << ", wider than 18 digits: its values are given as text.");
+        }
+
+        table->fields.push_back(field);
+        table->column_types.push_back(binlog_type_family(extract_field, fractional_temporal));
     }
 
+    table->columns = columns;
+    table->m_fixed_layout = FixedLayout::make(table->fields);
 
     rli.setTable(tbl_name, db_name, table);
 
 }
 
 
+PtrTable Slave::loadTable(unsigned long table_id, const std::pair<std::string, std::string>& key) {
+
+    std::map<unsigned long, std::pair<std::string, std::string> >::const_iterator u = m_unmatched_ids.find(table_id);
+
+    if (u != m_unmatched_ids.end() && u->second == key)
+        return PtrTable();
+
+    if (m_lazy_structure && isWatched(key)) {
+
+        LOG_INFO(log, "Creating table for: " << key.first << "." << key.second << " on its first event");
+
+        createTable(m_rli, key.first, key.second, readColumns(key.first, key.second));
+
+        PtrTable table = m_rli.getTable(key);
+        attachTable(key, *table);
+
+        return table;
+    }
+
+    for (patterns_t::const_iterator i = m_patterns.begin(); i != m_patterns.end(); ++i) {
+
+        if (!i->first.matches(key.first, key.second))
+            continue;
+
+        LOG_INFO(log, "Creating table for: " << key.first << "." << key.second << " (matches " << i->first.text() << ")");
+
+        createTable(m_rli, key.first, key.second, readColumns(key.first, key.second));
+
+        PtrTable table = m_rli.getTable(key);
+
+        attachTable(key, *table);
+        table->m_callback = i->second;
+
+        if (m_pattern_tables.insert(key).second)
+            ext_state.initTableCount(table->full_name);
+
+        return table;
+    }
+
+    m_unmatched_ids[table_id] = key;
+
+    return PtrTable();
+}
+
+
+void Slave::fitTable(Table& table, const Table_map_event_info& tmi) const {
+
+    if (!fit_temporal_storage(table, tmi))
+        return;
+
+    if (table.m_row_handler)
+        table.m_row_handler->onTable(table);
+}
+
+
+bool Slave::checkTable(const Table& table, const Table_map_event_info& tmi) const {
+
+    if (tmi.m_column_types.size() != table.column_types.size())
+        return false;
+
+    for (size_t i = 0; i < table.column_types.size(); ++i) {
+
+        if (table.column_types[i] != 0 &&
+            table.column_types[i] != binlog_type_family(tmi.m_column_types[i]))
+            return false;
+    }
+
+    return true;
+}
+
+
 struct raii_mysql_connector {
 
     MYSQL* mysql;
@@ -302,6 +672,8 @@ struct raii_mysql_connector {
 
         mysql_options(mysql, MYSQL_OPT_CONNECT_TIMEOUT, &timeout); //(const char*) slave_net_timeout.c_str());
 
+        timeout = m_master_info.read_timeout;
+
         /* Timeout for reads from server (works only for TCP/IP connections, and only for Windows prior to MySQL 4.1.22).
          * You can this option so that a lost connection can be detected earlier than the TCP/IP
          * Close_Wait_Timeout value of 10 minutes. Added in 4.1.1.
@@ -360,27 +732,56 @@ void Slave::get_remote_binlog( const boost::function< bool() >& _interruptFlag)
 
 connected:
 
-        //   ,   ext_state ,   
-        //  persistent . false  ,     .
-        if( !ext_state.getMasterInfo(
-                    m_master_info.master_log_name,
-                    m_master_info.master_log_pos) ) {
-            //      ,
-            //      
-            std::pair<std::string,unsigned int> row = getLastBinlog();
+        // A transaction cut by reconnect is not in m_gtid_executed and will be sent again.
+        m_gtid_pending_gno = 0;
+        m_trx_commit_usec = m_trx_apply_usec = 0;
+
+        if (m_coalescer)
+            m_coalescer->clear();
+
+        if (m_master_info.auto_position) {
+
+            if (m_gtid_executed.empty() && !ext_state.loadMasterGtidSet(m_gtid_executed)) {
+
+                m_gtid_executed = getMasterGtidExecuted();
+
+                ext_state.setMasterGtidSet(m_gtid_executed);
+                ext_state.saveMasterInfo();
+            }
+
+            LOG_INFO(log, "Starting from GTID set: " << m_gtid_executed.str());
+
+        } else {
+
+            //   ,   ext_state ,   
+            //  persistent . false  ,     .
+            if( !ext_state.getMasterInfo(
+                        m_master_info.master_log_name,
+                        m_master_info.master_log_pos) ) {
+                //      ,
+                //      
+                std::pair<std::string,unsigned int> row = getLastBinlog();
+
+                m_master_info.master_log_name = row.first;
+                m_master_info.master_log_pos = row.second;
 
-            m_master_info.master_log_name = row.first;
-            m_master_info.master_log_pos = row.second;
+                ext_state.setMasterLogNamePos(m_master_info.master_log_name, m_master_info.master_log_pos);
+                ext_state.saveMasterInfo();
+            }
 
-            ext_state.setMasterLogNamePos(m_master_info.master_log_name, m_master_info.master_log_pos);
-            ext_state.saveMasterInfo();
+            LOG_INFO(log, "Starting from binlog_name:binlog_pos : " << m_master_info.master_log_name
+                    << ":" << m_master_info.master_log_pos );
         }
 
-        LOG_INFO(log, "Starting from binlog_name:binlog_pos : " << m_master_info.master_log_name
-                << ":" << m_master_info.master_log_pos );
 
+        m_checksum_alg = negotiate_binlog_checksum(&mysql);
 
-        request_dump(m_master_info.master_log_name, m_master_info.master_log_pos, &mysql);
+        set_heartbeat_period(&mysql);
+
+        if (m_master_info.auto_position)
+            request_dump_gtid(m_gtid_executed, &mysql);
+        else
+            request_dump(m_master_info.master_log_name, m_master_info.master_log_pos, &mysql);
 
         while (!_interruptFlag()) {
 
@@ -393,6 +794,15 @@ connected:
 
                 ext_state.setStateProcessing(true);
 
+                if (len == packet_end_data && m_master_info.non_blocking && mysql_errno(&mysql) == 0) {
+                    LOG_INFO(log, "Reached the end of binlog at " << m_master_info.master_log_name
+                             << ":" << m_master_info.master_log_pos);
+                    break;
+                }
+
+                if (len != packet_error)
+                    ext_state.addReceivedBytes(len);
+
                 count_packet++;
                 LOG_TRACE(log, "Got event with length: " << len << " Packet number: " << count_packet );
 
@@ -431,73 +841,24 @@ connected:
                     continue;
                 }
 
-                slave::Basic_event_info event;
-
-                if (!slave::read_log_event((const char*) mysql.net.read_pos + 1,
-                            len - 1, 
-                            event)) {
-
-                    LOG_TRACE(log, "Skipping unknown event.");
-                    continue;
+                if (m_master_info.large_event_size != 0 && len > m_master_info.large_event_size) {
+                    LOG_WARNING(log, "Event of " << len << " bytes at " << m_master_info.master_log_name
+                                << ":" << m_master_info.master_log_pos << ". Maybe a corrupted event!");
                 }
 
-                //
-
-                LOG_TRACE(log, "Event log position: " << event.log_pos );
+                if (m_recorder)
+                    m_recorder->record((const char*) mysql.net.read_pos + 1, len - 1, m_packet_usec, m_checksum_alg,
+                                       m_master_info.master_log_name, m_master_info.master_log_pos);
 
-                if (event.log_pos != 0) {
-                    m_master_info.master_log_pos = event.log_pos;
-                    ext_state.setLastEventTimePos(event.when, event.log_pos);
-                }
+                handle_event((const char*) mysql.net.read_pos + 1, len - 1);
 
-                LOG_TRACE(log, "seconds_behind_master: " << (::time(NULL) - event.when) );
+                // Only closing the connection gives the buffer back; between transactions
+                // it continues from where it stopped, as after a lost connection.
+                if (m_trx_boundary && oversized_net_buffer(&mysql)) {
 
+                    __conn.connect(true);
 
-                // MySQL5.1.23 binlogs can be read only starting from a XID_EVENT
-                // MySQL5.1.23 ev->log_pos -- the binlog offset
-
-                if (event.type == XID_EVENT) {
-
-                    ext_state.setMasterLogNamePos(m_master_info.master_log_name, m_master_info.master_log_pos);
-
-                    LOG_TRACE(log, "Got XID event. Using binlog name:pos: "
-                            << m_master_info.master_log_name << ":" << m_master_info.master_log_pos);
-
-
-                    if (m_xid_callback)
-                        m_xid_callback(event.server_id);
-
-                } else  if (event.type == ROTATE_EVENT) {
-
-                    slave::Rotate_event_info rei(event.buf, event.event_len);
-
-                    /*
-                     * new_log_ident - new binlog name
-                     * pos - position of the starting event
-                     */
-
-                    LOG_INFO(log, "Got rotate event.");
-
-                    /* WTF
-                     */
-
-                    if (event.when == 0) {
-
-                        //LOG_TRACE(log, "ROTATE_FAKE");
-                    }
-
-                    m_master_info.master_log_name = rei.new_log_ident;
-                    m_master_info.master_log_pos = rei.pos; // this will always be equal to 4
-
-                    ext_state.setMasterLogNamePos(m_master_info.master_log_name, m_master_info.master_log_pos);
-
-                    LOG_TRACE(log, "ROTATE_EVENT processed OK.");
-                }
-
-
-                if (process_event(event, m_rli, m_master_info.master_log_pos)) {
-
-                    LOG_TRACE(log, "Error in processing event.");
+                    goto connected;
                 }
 
 
@@ -537,42 +898,35 @@ connected:
 std::map<std::string,std::string> Slave::getRowType(const std::string& db_name,
                                                     const std::set<std::string>& tbl_names) const {
 
-    nanomysql::Connection conn(m_master_info.host.c_str(), m_master_info.user.c_str(),
-                               m_master_info.password.c_str(), "", m_master_info.port);
+    ConnectionPool::Lease lease(*m_meta_pool);
+    nanomysql::Connection& conn = *lease;
 
-    nanomysql::Connection::result_t res;
+    nanomysql::Result res;
 
     conn.query("SHOW TABLE STATUS FROM " + db_name);
     conn.store(res);
 
     std::map<std::string,std::string> ret;
 
-    for (nanomysql::Connection::result_t::const_iterator i = res.begin(); i != res.end(); ++i) {
-
-        if (i->size() <= 3) {
-            LOG_ERROR(log, "WARNING: Broken SHOW TABLE STATUS FROM " << db_name);
-            continue;
-        }
-        
-        //row[0] - the table name
-        //row[3] - row_format
-
-        std::map<std::string,nanomysql::field>::const_iterator z = i->find("Name");
+    if (res.rows() == 0)
+        return ret;
 
-        if (z == i->end())
-            throw std::runtime_error("Slave::create_table(): SHOW TABLE STATUS query did not return 'Name'");
-
-        std::string name = z->second.data;
+    if (res.columns() <= 3) {
+        LOG_ERROR(log, "WARNING: Broken SHOW TABLE STATUS FROM " << db_name);
+        return ret;
+    }
 
-        z = i->find("Row_format");
+    const size_t name_col = result_column(res, "Name", "SHOW TABLE STATUS");
+    const size_t format_col = result_column(res, "Row_format", "SHOW TABLE STATUS");
 
-        if (z == i->end())
-            throw std::runtime_error("Slave::create_table(): SHOW TABLE STATUS query did not return 'Row_format'");
+    for (size_t i = 0; i < res.rows(); ++i) {
 
-        std::string format = z->second.data;
+        std::string name = res.str(i, name_col);
 
         if (tbl_names.count(name) != 0) {
 
+            std::string format = res.str(i, format_col);
+
             ret[name] = format;
 
             LOG_DEBUG(log, name << " row_type = " << format);
@@ -636,8 +990,8 @@ void Slave::deregister_slave_on_master(MYSQL* mysql) {
 
 void Slave::check_master_version() {
 
-    nanomysql::Connection conn(m_master_info.host.c_str(), m_master_info.user.c_str(),
-                               m_master_info.password.c_str(), "", m_master_info.port);
+    ConnectionPool::Lease lease(*m_meta_pool);
+    nanomysql::Connection& conn = *lease;
 
     nanomysql::Connection::result_t res;
 
@@ -648,7 +1002,8 @@ void Slave::check_master_version() {
 
         std::string tmp = res[0].begin()->second.data;
 
-        bool ok = true;
+        // "5.6.17-log" -> 50617
+        int version = 0;
 
         const char* v = tmp.data();
 
@@ -658,27 +1013,21 @@ void Slave::check_master_version() {
 
             int z = ::strtoul(v, &e, 10);
 
-            /* Mysql version >= 5.1.23 */
-
-            if ((z >= 5 && i == 0) ||
-                (z >= 1 && i == 1) ||
-                (z >= 23 && i == 2)) {
+            version = version * 100 + z;
 
-                //
+            if (*e != '.' || e == v) {
 
-            }  else {
-                ok = false;
+                for (++i; i < 3; ++i)
+                    version *= 100;
                 break;
             }
 
-            if (*e == '\0' || e == v) 
-                break;
-
             v = e+1;
         }
 
-        /* */
-        if (ok) {
+        /* Mysql version >= 5.1.23 */
+        if (version >= 50123) {
+            m_master_version = version;
             return;
         }
 
@@ -691,8 +1040,8 @@ void Slave::check_master_version() {
 
 void Slave::check_master_binlog_format() {
 
-    nanomysql::Connection conn(m_master_info.host.c_str(), m_master_info.user.c_str(),
-                               m_master_info.password.c_str(), "", m_master_info.port);
+    ConnectionPool::Lease lease(*m_meta_pool);
+    nanomysql::Connection& conn = *lease;
 
     nanomysql::Connection::result_t res;
 
@@ -801,6 +1150,14 @@ bool checkDropTableQuery(const std::string& str)
     }
     return false;
 }
+
+// Statements the master logs inside a transaction: they do not end it
+bool checkInTransactionQuery(const std::string& str)
+{
+    return str == "BEGIN" ||
+        0 == ::strncasecmp("savepoint ", str.c_str(), 10) ||
+        0 == ::strncasecmp("rollback to ", str.c_str(), 12);
+}
 }
 
 int Slave::process_event(const slave::Basic_event_info& bei, RelayLogInfo &m_rli, unsigned long long pos)
@@ -821,10 +1178,16 @@ int Slave::process_event(const slave::Basic_event_info& bei, RelayLogInfo &m_rli
 
         LOG_TRACE(log, "Received QUERY_EVENT: " << qei.query);
 
+        // DDL, COMMIT of non-transactional tables and ROLLBACK end the transaction without XID.
+        if (!checkInTransactionQuery(qei.query)) {
+            commit_gtid();
+            commit_rows();
+        }
+
         if (checkAlterQuery(qei.query) || checkCreateQuery(qei.query) || checkDropTableQuery(qei.query)) {
 
             LOG_DEBUG(log, "Rebuilding database structure.");
-            createDatabaseStructure();
+            reloadDatabaseStructure();
         }
         break;
     }
@@ -837,18 +1200,69 @@ int Slave::process_event(const slave::Basic_event_info& bei, RelayLogInfo &m_rli
 
         m_rli.setTableName(tmi.m_table_id, tmi.m_tblnam, tmi.m_dbnam);
 
+        const std::pair<std::string, std::string> key(tmi.m_dbnam, tmi.m_tblnam);
+
+        // Tables may come from the schema cache, or the master may have changed them quietly.
+        PtrTable table = m_rli.getTable(key);
+
+        if (!table && (m_lazy_structure || !m_patterns.empty()))
+            table = loadTable(tmi.m_table_id, key);
+
+        if (table && !table->validated) {
+
+            fitTable(*table, tmi);
+
+            if (!checkTable(*table, tmi)) {
+
+                LOG_WARNING(log, "Table " << table->full_name << " does not match its TABLE_MAP event, "
+                            "re-reading database structure.");
+                reloadDatabaseStructure();
+
+                table = m_rli.getTable(key);
+
+                if (!table && (m_lazy_structure || !m_patterns.empty()))
+                    table = loadTable(tmi.m_table_id, key);
+
+                if (table)
+                    fitTable(*table, tmi);
+
+                if (table && !checkTable(*table, tmi))
+                    LOG_ERROR(log, "Table " << table->full_name << " on master does not match its TABLE_MAP event.");
+            }
+
+            if (table)
+                table->validated = true;
+        }
+
+        break;
+    }
+
+    case GTID_LOG_EVENT:
+    {
+        slave::Gtid_event_info gei(bei.buf, bei.event_len);
+
+        LOG_TRACE(log, "Got GTID_LOG_EVENT: gno " << gei.gno);
+
+        m_gtid_pending_sid.assign((const char*)gei.sid, GTID_ENCODED_SID_LENGTH);
+        m_gtid_pending_gno = gei.gno;
+
+        m_trx_commit_usec = gei.commit_ts;
+
         break;
     }
 
     case WRITE_ROWS_EVENT:
     case UPDATE_ROWS_EVENT:
     case DELETE_ROWS_EVENT:
+    case WRITE_ROWS_EVENT_V2:
+    case UPDATE_ROWS_EVENT_V2:
+    case DELETE_ROWS_EVENT_V2:
     {
-        LOG_TRACE(log, "Got " << (bei.type == WRITE_ROWS_EVENT ? "WRITE" :
-                                  bei.type == DELETE_ROWS_EVENT ? "DELETE" :
-                                  "UPDATE") << "_ROWS_EVENT");
+        LOG_TRACE(log, "Got " << (is_write_rows_event(bei.type) ? "WRITE" :
+                                  is_delete_rows_event(bei.type) ? "DELETE" :
+                                  "UPDATE") << "_ROWS_EVENT" << (is_rows_event_v2(bei.type) ? "_V2" : ""));
 
-        Row_event_info roi(bei.buf, bei.event_len, (bei.type == UPDATE_ROWS_EVENT));
+        Row_event_info roi(bei.buf, bei.event_len, is_update_rows_event(bei.type), is_rows_event_v2(bei.type));
 
         apply_row_event(m_rli, bei, roi, ext_state);
 
@@ -874,7 +1288,7 @@ void Slave::request_dump(const std::string& logname, unsigned long start_positio
     //
     //start_position = 4;
 
-    int binlog_flags = 0;
+    int binlog_flags = m_master_info.non_blocking ? BINLOG_DUMP_NON_BLOCK : 0;
     int4store(buf, (uint32)start_position);
     int2store(buf + BIN_LOG_HEADER_SIZE, binlog_flags);
 
@@ -891,6 +1305,287 @@ void Slave::request_dump(const std::string& logname, unsigned long start_positio
 }
 
 
+void Slave::request_dump_gtid(const GtidSet& gtid_set, MYSQL* mysql) {
+
+    // Not in the pre-5.6 headers.
+    static const enum_server_command com_binlog_dump_gtid = (enum_server_command)0x1e;
+
+    const std::string data = gtid_set.encode();
+
+    // flags, server id, binlog name length, (empty) binlog name, position, data length, data
+    std::vector<uchar> buf(2 + 4 + 4 + 8 + 4 + data.size());
+    uchar* p = &buf[0];
+
+    int2store(p, BINLOG_THROUGH_GTID | (m_master_info.non_blocking ? BINLOG_DUMP_NON_BLOCK : 0));
+    int4store(p + 2, m_server_id);
+    int4store(p + 6, 0);
+    int8store(p + 10, (ulonglong)BIN_LOG_HEADER_SIZE);
+    int4store(p + 18, data.size());
+    memcpy(p + 22, data.data(), data.size());
+
+    if (simple_command(mysql, com_binlog_dump_gtid, p, buf.size(), 1)) {
+
+        LOG_ERROR(log, "Error sending COM_BINLOG_DUMP_GTID");
+        throw std::runtime_error("Error in sending COM_BINLOG_DUMP_GTID");
+    }
+}
+
+
+// Master sends HEARTBEAT_LOG_EVENT after this many idle nanoseconds.
+void Slave::set_heartbeat_period(MYSQL* mysql) {
+
+    const unsigned long long period = (unsigned long long)(m_master_info.heartbeat_period * 1e9);
+
+    if (period == 0)
+        return;
+
+    if (m_master_info.heartbeat_period >= m_master_info.read_timeout)
+        LOG_WARNING(log, "Heartbeat period " << m_master_info.heartbeat_period
+                    << " s is not less than the read timeout " << m_master_info.read_timeout << " s");
+
+    std::ostringstream query;
+    query << "SET @master_heartbeat_period = " << period;
+
+    if (mysql_real_query(mysql, query.str().data(), query.str().size()))
+        LOG_WARNING(log, "Could not set heartbeat period: " << mysql_error(mysql));
+}
+
+
+void Slave::replay(BinlogReplayer& _replayer, bool _original_timing, const boost::function< bool() >& _interruptFlag) {
+
+    m_gtid_pending_gno = 0;
+    m_trx_commit_usec = m_trx_apply_usec = 0;
+
+    if (m_coalescer)
+        m_coalescer->clear();
+
+    BinlogReplayer::Event event;
+
+    const unsigned long long start = now_usec();
+    unsigned long long first = 0;
+
+    while (!_interruptFlag() && _replayer.next(event)) {
+
+        if (_original_timing) {
+
+            if (first == 0)
+                first = event.usec;
+
+            const unsigned long long due = start + (event.usec > first ? event.usec - first : 0);
+
+            // In small steps, to see the interrupt flag during long pauses
+            for (unsigned long long now = now_usec(); now < due && !_interruptFlag(); now = now_usec())
+                ::usleep(std::min(due - now, 100000ULL));
+        }
+
+        m_packet_usec = now_usec();
+        m_checksum_alg = event.checksum_alg;
+
+        handle_event(event.data, event.len);
+    }
+}
+
+
+// An event as it came from master (without the leading OK byte), from get_remote_binlog() or replay().
+void Slave::handle_event(const char* buf, unsigned long len) {
+
+    slave::Basic_event_info event;
+
+    m_trx_boundary = false;
+
+    if (!slave::read_log_event(buf, len, event, m_checksum_alg, m_verify_checksum)) {
+
+        // Master is idle and we have everything: no lag, whatever the last event time was.
+        // A good time to close the metadata connections nobody has needed for long.
+        if (event.type == HEARTBEAT_LOG_EVENT) {
+            ext_state.setLastEventTimePos(::time(NULL), m_master_info.master_log_pos);
+            add_lag_sample(LAG_NETWORK, 0);
+            add_lag_sample(LAG_TOTAL, 0);
+            m_meta_pool->reap();
+        }
+
+        LOG_TRACE(log, "Skipping unknown event.");
+        return;
+    }
+
+    //
+
+    LOG_TRACE(log, "Event log position: " << event.log_pos );
+
+    if (event.log_pos != 0) {
+        m_master_info.master_log_pos = event.log_pos;
+        ext_state.setLastEventTimePos(event.when, event.log_pos);
+    }
+
+    LOG_TRACE(log, "seconds_behind_master: " << (::time(NULL) - event.when) );
+
+
+    // MySQL5.1.23 binlogs can be read only starting from a XID_EVENT
+    // MySQL5.1.23 ev->log_pos -- the binlog offset
+
+    if (event.type == XID_EVENT) {
+
+        commit_gtid();
+        commit_rows();
+
+        ext_state.setMasterLogNamePos(m_master_info.master_log_name, m_master_info.master_log_pos);
+
+        LOG_TRACE(log, "Got XID event. Using binlog name:pos: "
+                << m_master_info.master_log_name << ":" << m_master_info.master_log_pos);
+
+
+        if (m_xid_callback)
+            m_xid_callback(event.server_id);
+
+    } else  if (event.type == ROTATE_EVENT) {
+
+        slave::Rotate_event_info rei(event.buf, event.event_len);
+
+        /*
+         * new_log_ident - new binlog name
+         * pos - position of the starting event
+         */
+
+        LOG_INFO(log, "Got rotate event.");
+
+        /* WTF
+         */
+
+        if (event.when == 0) {
+
+            //LOG_TRACE(log, "ROTATE_FAKE");
+        }
+
+        m_master_info.master_log_name = rei.new_log_ident;
+        m_master_info.master_log_pos = rei.pos; // this will always be equal to 4
+
+        ext_state.setMasterLogNamePos(m_master_info.master_log_name, m_master_info.master_log_pos);
+
+        LOG_TRACE(log, "ROTATE_EVENT processed OK.");
+    }
+
+
+    if (process_event(event, m_rli, m_master_info.master_log_pos)) {
+
+        LOG_TRACE(log, "Error in processing event.");
+    }
+
+    m_trx_apply_usec += now_usec() - m_packet_usec;
+
+    if (event.type == XID_EVENT)
+        add_lag_samples(event.when);
+}
+
+
+bool Slave::oversized_net_buffer(const MYSQL* mysql) const {
+
+    if (m_master_info.max_buffer_size == 0 || mysql->net.max_packet <= m_master_info.max_buffer_size)
+        return false;
+
+    LOG_INFO(log, "Network buffer has grown to " << mysql->net.max_packet << " bytes, reconnecting to release it.");
+
+    return true;
+}
+
+
+void Slave::add_lag_samples(time_t when) {
+
+    const unsigned long long done = now_usec();
+
+    // Before 8.0 there is only the XID event's header: the second its statement started,
+    // not the commit. Better than nothing, but the lag is off by up to a second and more.
+    const unsigned long long commit = m_trx_commit_usec ? m_trx_commit_usec : (unsigned long long)when * 1000000;
+
+    // Clocks of master and slave may disagree a bit
+    add_lag_sample(LAG_NETWORK, m_packet_usec > commit ? m_packet_usec - commit : 0);
+    add_lag_sample(LAG_APPLY, m_trx_apply_usec);
+    add_lag_sample(LAG_TOTAL, done > commit ? done - commit : 0);
+
+    m_trx_commit_usec = m_trx_apply_usec = 0;
+}
+
+
+void Slave::add_lag_sample(LagStage stage, unsigned long long usec) {
+
+    m_lag_stats->add(stage, usec);
+    ext_state.addLagSample(stage, usec);
+}
+
+
+// Called at the end of every transaction.
+void Slave::commit_gtid() {
+
+    if (m_gtid_pending_gno == 0)
+        return;
+
+    m_gtid_executed.add(m_gtid_pending_sid, m_gtid_pending_gno);
+    m_gtid_pending_gno = 0;
+
+    ext_state.setMasterGtidSet(m_gtid_executed);
+}
+
+
+void Slave::commit_rows() {
+
+    m_trx_boundary = true;
+
+    if (m_coalescer)
+        m_coalescer->commit(ext_state);
+
+    // A handler may be set for several tables
+    std::set<RowHandler*> done;
+
+    for (row_handlers_t::const_iterator i = m_row_handlers.begin(); i != m_row_handlers.end(); ++i) {
+        if (i->second && done.insert(i->second.get()).second)
+            i->second->onCommit();
+    }
+}
+
+
+// Tells master that we understand binlog checksums, otherwise a master with
+// binlog_checksum != NONE refuses to send us events.
+unsigned char Slave::negotiate_binlog_checksum(MYSQL* mysql) {
+
+    static const std::string set_query = "SET @master_binlog_checksum = @@global.binlog_checksum";
+    static const std::string select_query = "SELECT @master_binlog_checksum";
+
+    if (mysql_real_query(mysql, set_query.data(), set_query.size())) {
+
+        // Masters before 5.6.1 know nothing about checksums.
+        LOG_DEBUG(log, "Master does not support binlog checksums: " << mysql_error(mysql));
+        return BINLOG_CHECKSUM_ALG_OFF;
+    }
+
+    if (mysql_real_query(mysql, select_query.data(), select_query.size())) {
+
+        throw std::runtime_error("Slave::negotiate_binlog_checksum(): " + select_query + " failed: " +
+                                 std::string(mysql_error(mysql)));
+    }
+
+    MYSQL_RES* res = mysql_store_result(mysql);
+
+    if (res == NULL) {
+        throw std::runtime_error("Slave::negotiate_binlog_checksum(): mysql_store_result() failed: " +
+                                 std::string(mysql_error(mysql)));
+    }
+
+    MYSQL_ROW row = mysql_fetch_row(res);
+    const std::string alg = (row && row[0]) ? row[0] : "";
+
+    mysql_free_result(res);
+
+    LOG_DEBUG(log, "Master binlog checksum: " << alg);
+
+    if (alg == "CRC32")
+        return BINLOG_CHECKSUM_ALG_CRC32;
+
+    if (alg == "NONE" || alg.empty())
+        return BINLOG_CHECKSUM_ALG_OFF;
+
+    throw std::runtime_error("Slave::negotiate_binlog_checksum(): unsupported binlog checksum: " + alg);
+}
+
+
 ulong Slave::read_event(MYSQL* mysql)
 {
 
@@ -899,6 +1594,8 @@ ulong Slave::read_event(MYSQL* mysql)
 
     len = cli_safe_read(mysql);
 
+    m_packet_usec = now_usec();
+
     if (len == packet_error) {
         LOG_ERROR(log, "Myslave:Error reading packet from server: " << mysql_error(mysql)
                   << "; mysql_error: " << mysql_errno(mysql));
@@ -922,8 +1619,8 @@ void Slave::generateSlaveId()
 
     std::set<unsigned int> server_ids;
 
-    nanomysql::Connection conn(m_master_info.host.c_str(), m_master_info.user.c_str(),
-                               m_master_info.password.c_str(), "", m_master_info.port);
+    ConnectionPool::Lease lease(*m_meta_pool);
+    nanomysql::Connection& conn = *lease;
 
     nanomysql::Connection::result_t res;
 
@@ -968,15 +1665,16 @@ std::pair<std::string,unsigned int> Slave::getLastBinlog()
 {
 
 
-    nanomysql::Connection conn(m_master_info.host.c_str(), m_master_info.user.c_str(),
-                               m_master_info.password.c_str(), "", m_master_info.port);
+    ConnectionPool::Lease lease(*m_meta_pool);
+    nanomysql::Connection& conn = *lease;
 
     nanomysql::Connection::result_t res;
 
     conn.query("SHOW MASTER STATUS");
     conn.store(res);
 
-    if (res.size() == 1 && res[0].size() == 4) {
+    // 5.6+ has one more column, Executed_Gtid_Set.
+    if (res.size() == 1 && res[0].size() >= 4) {
 
         std::map<std::string,nanomysql::field>::const_iterator z = res[0].find("File");
         
@@ -999,6 +1697,28 @@ std::pair<std::string,unsigned int> Slave::getLastBinlog()
 }
 
 
+GtidSet Slave::getMasterGtidExecuted()
+{
+    ConnectionPool::Lease lease(*m_meta_pool);
+    nanomysql::Connection& conn = *lease;
+
+    nanomysql::Connection::result_t res;
+
+    conn.query("SELECT @@GLOBAL.gtid_executed AS gtid_executed");
+    conn.store(res);
+
+    if (res.size() == 1) {
+
+        std::map<std::string,nanomysql::field>::const_iterator z = res[0].find("gtid_executed");
+
+        if (z != res[0].end())
+            return GtidSet(z->second.data);
+    }
+
+    throw std::runtime_error("Slave::getMasterGtidExecuted(): Could not SELECT @@GLOBAL.gtid_executed");
+}
+
+
 
 
 } //namespace slave
@@ -55,6 +55,12 @@ void end_server(MYSQL *mysql);
 
 #include "slave_log_event.h"
 #include "SlaveStats.h"
+#include "coalesce.h"
+#include "connection_pool.h"
+#include "recorder.h"
+#include "schema_cache.h"
+#include "table_pattern.h"
+#include "table_stats.h"
 
 
 
@@ -64,6 +70,12 @@ void end_server(MYSQL *mysql);
 #define ER_MASTER_FATAL_ERROR_READING_BINLOG 1236
 #define BIN_LOG_HEADER_SIZE	4
 
+// COM_BINLOG_DUMP flag: send EOF at the end of binlog instead of waiting.
+#define BINLOG_DUMP_NON_BLOCK 0x01
+
+// COM_BINLOG_DUMP_GTID flag: the GTID set follows.
+#define BINLOG_THROUGH_GTID 0x04
+
 
 
 namespace slave
@@ -79,6 +91,9 @@ public:
 
     typedef std::vector<std::pair<std::string, std::string> > table_order_t;
     typedef std::map<std::pair<std::string, std::string>, callback> callbacks_t;
+    typedef std::map<std::pair<std::string, std::string>, PtrRowHandler> row_handlers_t;
+    typedef std::map<std::pair<std::string, std::string>, fixed_callback> fixed_callbacks_t;
+    typedef std::vector<std::pair<TablePattern, callback> > patterns_t;
 
 
 private:
@@ -88,25 +103,152 @@ private:
 
     int m_server_id;	
 
+    // Master version as a number: 5.6.17 -> 50617
+    int m_master_version;
+
     MasterInfo m_master_info;
     ExtStateIface &ext_state;
 
     table_order_t m_table_order;
     callbacks_t m_callbacks;
+    row_handlers_t m_row_handlers;
+    fixed_callbacks_t m_fixed_callbacks;
+    patterns_t m_patterns;
+
+    // The tables a pattern has matched so far; their counters are set up once, not on every reload.
+    std::set<std::pair<std::string, std::string> > m_pattern_tables;
+
+    // Table id -> the name of the table, for the tables loadTable() does not take. Cleared with the structure.
+    std::map<unsigned long, std::pair<std::string, std::string> > m_unmatched_ids;
 
     typedef boost::function<void (unsigned int)> xid_callback_t; 
     xid_callback_t m_xid_callback;
 
     RelayLogInfo m_rli;
 
+    // Checksum algorithm of the binlog stream being read, see read_log_event().
+    unsigned char m_checksum_alg;
+    bool m_verify_checksum;
+
+    bool m_update_diff;
+
+    // Watched tables are read on their first TABLE_MAP event, see setLazyStructure().
+    bool m_lazy_structure;
+
+    // String values are given as UTF-8, see setTranscodeUtf8() and setValidateUtf8().
+    bool m_transcode_utf8;
+    bool m_validate_utf8;
+
+    // DATE, TIME and DATETIME are given as epoch values, see setTemporalEpoch().
+    boost::shared_ptr<TimeZone> m_epoch_tz;
+    bool m_epoch_usec;
+
+    // DECIMAL values are given as scaled integers, see setDecimalScaled().
+    bool m_decimal_scaled;
+
+    // NULL unless the cost of the tables is counted, see setTableStats().
+    boost::shared_ptr<TableStatsRegistry> m_table_stats;
+
+    boost::shared_ptr<RowCoalescer> m_coalescer;
+
+    boost::shared_ptr<BinlogRecorder> m_recorder;
+
+    // Transactions received so far, and the one being received now (gno 0 if none).
+    GtidSet m_gtid_executed;
+    std::string m_gtid_pending_sid;
+    long long m_gtid_pending_gno;
+
+    // For the lag stats: when the last packet came, when the current transaction was
+    // committed on master (0 if not known) and how long it has been processed here.
+    unsigned long long m_packet_usec;
+    unsigned long long m_trx_commit_usec;
+    unsigned long long m_trx_apply_usec;
+
+    // Shared with the threads that ask for getLagPercentiles()
+    boost::shared_ptr<SharedLagStats> m_lag_stats;
+
+    // The last event ended a transaction, see commit_rows()
+    bool m_trx_boundary;
+
+
+    // Where the structure of the watched tables is kept between restarts, see setSchemaCache().
+    std::string m_schema_cache_path;
+
+    // Connections for all the metadata queries, opened when first needed.
+    boost::shared_ptr<ConnectionPool> m_meta_pool;
+    mutable collate_map_t m_collate_map;
+
+    void createDatabaseStructure_(table_order_t& tabs, RelayLogInfo& rli, bool use_cache) const;
+
+    // A reload keeps the table ids, it may come in the middle of a statement.
+    void setDatabaseStructure_(bool use_cache) {
+
+        if (use_cache)
+            m_rli.clear();
+        else
+            m_rli.clearTables();
+
+        m_unmatched_ids.clear();
+
+        createDatabaseStructure_(m_table_order, m_rli, use_cache);
+
+        for (RelayLogInfo::name_to_table_t::iterator i = m_rli.m_table_map.begin(); i != m_rli.m_table_map.end(); ++i)
+            attachTable(i->first, *i->second);
+    }
+
+    // Gives the table what was set for it: a callback, a row handler or a fixed callback.
+    void attachTable(const std::pair<std::string, std::string>& key, Table& table) {
+
+        table.m_update_diff = m_update_diff;
+        table.m_coalescer = m_coalescer;
+
+        if (m_table_stats)
+            table.m_stats = m_table_stats->get(table.full_name);
+
+        callbacks_t::const_iterator c = m_callbacks.find(key);
+        if (c != m_callbacks.end())
+            table.m_callback = c->second;
+
+        row_handlers_t::const_iterator h = m_row_handlers.find(key);
+        if (h != m_row_handlers.end()) {
+            h->second->onTable(table);
+            table.m_row_handler = h->second;
+        }
 
-    void createDatabaseStructure_(table_order_t& tabs, RelayLogInfo& rli) const;
+        fixed_callbacks_t::const_iterator f = m_fixed_callbacks.find(key);
+        if (f != m_fixed_callbacks.end()) {
+
+            if (!table.m_fixed_layout)
+                throw std::runtime_error("Slave::setFixedCallback(): " + table.full_name +
+                                         " has columns that are not fixed-width integers");
+
+            table.m_fixed_callback = f->second;
+        }
+    }
+
+    bool isWatched(const std::pair<std::string, std::string>& key) const {
+        return m_callbacks.count(key) || m_row_handlers.count(key) || m_fixed_callbacks.count(key);
+    }
 
 public:
 	
-    Slave(ExtStateIface &state) : ext_state(state) {}
-
-    Slave(MasterInfo& _master_info, ExtStateIface &state) : m_master_info(_master_info), ext_state(state) {}
+    Slave(ExtStateIface &state) :
+        m_master_version(0), ext_state(state),
+        m_checksum_alg(BINLOG_CHECKSUM_ALG_UNDEF), m_verify_checksum(true), m_update_diff(false), m_lazy_structure(false),
+        m_transcode_utf8(false), m_validate_utf8(false), m_epoch_usec(false), m_decimal_scaled(false),
+        m_gtid_pending_gno(0), m_packet_usec(0), m_trx_commit_usec(0), m_trx_apply_usec(0),
+        m_lag_stats(new SharedLagStats), m_trx_boundary(false),
+        m_meta_pool(new ConnectionPool(nanomysql::Connection::Attributes(m_master_info.host, m_master_info.user,
+                                                                         m_master_info.password, "", m_master_info.port))) {}
+
+    Slave(MasterInfo& _master_info, ExtStateIface &state) :
+        m_master_version(0), m_master_info(_master_info), ext_state(state),
+        m_checksum_alg(BINLOG_CHECKSUM_ALG_UNDEF), m_verify_checksum(true), m_update_diff(false), m_lazy_structure(false),
+        m_transcode_utf8(false), m_validate_utf8(false), m_epoch_usec(false), m_decimal_scaled(false),
+        m_gtid_pending_gno(0), m_packet_usec(0), m_trx_commit_usec(0), m_trx_apply_usec(0),
+        m_lag_stats(new SharedLagStats), m_trx_boundary(false),
+        m_meta_pool(new ConnectionPool(nanomysql::Connection::Attributes(m_master_info.host, m_master_info.user,
+                                                                         m_master_info.password, "", m_master_info.port))) {}
 
     void setCallback(const std::string& _db_name, const std::string& _tbl_name, callback _callback) {
 
@@ -116,21 +258,151 @@ public:
         ext_state.initTableCount(_db_name + "." + _tbl_name);
     }
 
+    // Rows of the table go to the handler, as they are in the event, instead of a callback
+    // (see ColumnarHandler in columnar.h). One handler can take several tables.
+    void setRowHandler(const std::string& _db_name, const std::string& _tbl_name, PtrRowHandler _handler) {
+
+        m_table_order.push_back(std::make_pair(_db_name, _tbl_name));
+        m_row_handlers[std::make_pair(_db_name, _tbl_name)] = _handler;
+
+        ext_state.initTableCount(_db_name + "." + _tbl_name);
+    }
+
+    // For tables of integer and timestamp columns only: the rows are decoded straight into
+    // an array of long long (see FixedRow), without RecordSet. Neither setUpdateDiff() nor
+    // setCoalesce() apply to them. createDatabaseStructure() throws if a table does not fit.
+    void setFixedCallback(const std::string& _db_name, const std::string& _tbl_name, fixed_callback _callback) {
+
+        m_table_order.push_back(std::make_pair(_db_name, _tbl_name));
+        m_fixed_callbacks[std::make_pair(_db_name, _tbl_name)] = _callback;
+
+        ext_state.initTableCount(_db_name + "." + _tbl_name);
+    }
+
+    // Rows of every table the pattern matches go to the callback. The tables are matched,
+    // and their structure read, on their first TABLE_MAP event rather than at start-up.
+    // The tables set by name come first; then the patterns, in the order they were set.
+    void setCallback(const TablePattern& _pattern, callback _callback) {
+        m_patterns.push_back(std::make_pair(_pattern, _callback));
+    }
+
     void setXidCallback(xid_callback_t _callback) {
         m_xid_callback = _callback;
     }
+
+    // With binlog_checksum=CRC32 on master, verify the checksum of every event (default).
+    // Turning it off only strips the checksum, which saves a pass over every event.
+    void setVerifyChecksum(bool _verify) {
+        m_verify_checksum = _verify;
+    }
+
+    // Updates bring only the changed columns and the primary key, in both m_old_row and m_row;
+    // the other columns are compared as raw bytes and never unpacked. Set before
+    // createDatabaseStructure(). Needs the primary key to be known, see ColumnInfo::primary.
+    void setUpdateDiff(bool _diff) {
+        m_update_diff = _diff;
+    }
 		
+    // Rows of a transaction go to the callbacks at its end, one net change per primary key
+    // (see RowCoalescer). Set before createDatabaseStructure().
+    void setCoalesce(bool _coalesce) {
+        m_coalescer.reset(_coalesce ? new RowCoalescer : NULL);
+    }
+
+    // The structure of a watched table is read from master on its first TABLE_MAP event rather
+    // than by createDatabaseStructure(), which then takes only what the schema cache has; after
+    // DDL the tables are dropped, to be read again when they next show up. Start-up costs no
+    // query per table, and the tables nobody writes to cost nothing. snapshot() takes only the
+    // tables read so far. Set before createDatabaseStructure().
+    void setLazyStructure(bool _lazy) {
+        m_lazy_structure = _lazy;
+    }
+
+    // Values of char, varchar and text columns in single-byte charsets (latin1, latin2, cp1250,
+    // cp1251, cp866, koi8r, koi8u) are given as UTF-8, in RecordSet and to the row handlers alike.
+    // ASCII values go through untouched. Set before createDatabaseStructure().
+    void setTranscodeUtf8(bool _transcode) {
+        m_transcode_utf8 = _transcode;
+    }
+
+    // Values of utf8 and utf8mb4 columns are checked, and the bytes that are not valid UTF-8
+    // are replaced with U+FFFD. Set before createDatabaseStructure().
+    void setValidateUtf8(bool _validate) {
+        m_validate_utf8 = _validate;
+    }
+
+    // DATE, TIME and DATETIME values are given as seconds since the epoch (TIME: its length
+    // in seconds), or microseconds with _usec, in unsigned long long. They are signed: cast
+    // them to long long. The zone is what the values are local to, e.g. TimeZone::load("Europe/Moscow");
+    // NULL gives the packed MySQL values again. Set before createDatabaseStructure().
+    void setTemporalEpoch(boost::shared_ptr<TimeZone> _tz, bool _usec = false) {
+        m_epoch_tz = _tz;
+        m_epoch_usec = _usec;
+    }
+
+    // DECIMAL(p,s) values are given as the number times 10^s in unsigned long long (signed: cast
+    // them to long long), instead of text. Only up to 18 digits fit: the wider columns are still
+    // text. Set before createDatabaseStructure().
+    void setDecimalScaled(bool _scaled) {
+        m_decimal_scaled = _scaled;
+    }
+
+    // Counts, for every watched table, its row events, rows and bytes, and the nanoseconds spent
+    // decoding its rows and in its callbacks, in a slot of the table itself; see tableStats().
+    // Costs two clock readings per row. Set before createDatabaseStructure(); false drops the counts.
+    void setTableStats(bool _on) {
+        m_table_stats.reset(_on ? new TableStatsRegistry : NULL);
+    }
+
+    // The tables that cost the most so far, the costliest first; all of them with 0. Empty unless
+    // setTableStats(true). Safe to call from any thread.
+    std::vector<TableStats> tableStats(size_t _top = 0) const {
+        return m_table_stats ? m_table_stats->top(_top) : std::vector<TableStats>();
+    }
+
+    // Lag of the transactions so far, at the end of each; heartbeats of an idle master count
+    // as no lag. Without MySQL 8.0 commit timestamps the commit time is the second its
+    // statement started, so the lag is that coarse. Safe to call from any thread.
+    LagPercentiles getLagPercentiles(LagStage _stage) const {
+        return m_lag_stats->percentiles(_stage);
+    }
+
+    void resetLagStats() {
+        m_lag_stats->reset();
+    }
+
     void get_remote_binlog( const boost::function< bool() >& _interruptFlag = &Slave::falseFunction );
+
+    // Every event get_remote_binlog() reads is also written to the recorder, as it came.
+    void setRecorder(boost::shared_ptr<BinlogRecorder> _recorder) {
+        m_recorder = _recorder;
+    }
+
+    // Runs a recording through the decoding and the callbacks, as get_remote_binlog() does,
+    // with no master. Call after createDatabaseStructure(). Without original_timing it goes
+    // as fast as it can; with it, the events come as far apart as they were recorded.
+    void replay(BinlogReplayer& _replayer, bool _original_timing = false,
+                const boost::function< bool() >& _interruptFlag = &Slave::falseFunction);
+
+    // Initial load, call after createDatabaseStructure(). Reads the watched tables as of one
+    // binlog position, giving their rows to the callbacks as RecordSet::PreInit and then one
+    // RecordSet::PostInit per table; get_remote_binlog() continues from that position.
+    // Callbacks are called from the worker threads, but never concurrently.
+    // Needs the RELOAD privilege (FLUSH TABLES WITH READ LOCK); only InnoDB tables are consistent.
+    // Every watched table must have a callback: one with a row handler or a fixed callback is an error.
+    void snapshot(unsigned int threads = 4, unsigned int chunk_rows = 10000);
 	
+    // Reads the structure of the watched tables, from the schema cache if it is usable.
     void createDatabaseStructure() {
 
-        m_rli.clear();
-
-        createDatabaseStructure_(m_table_order, m_rli);
+        setDatabaseStructure_(true);
+    }
 
-        for (RelayLogInfo::name_to_table_t::iterator i = m_rli.m_table_map.begin(); i != m_rli.m_table_map.end(); ++i) {
-            i->second->m_callback = m_callbacks[i->first];
-        }
+    // Keep the structure of the watched tables in this file, so that createDatabaseStructure()
+    // after a restart need not ask the master. Tables are checked against TABLE_MAP events
+    // and re-read if they do not match.
+    void setSchemaCache(const std::string& path) {
+        m_schema_cache_path = path;
     }
 
     RelayLogInfo getRli() const {
@@ -145,6 +417,12 @@ public:
 	
     int getServerOid() const { return m_server_id; }
 
+    // Known after init()
+    int getMasterVersion() const { return m_master_version; }
+
+    // Transactions received so far (master must have gtid_mode=ON).
+    const GtidSet& getGtidExecuted() const { return m_gtid_executed; }
+
     // Closes connection, opened in get_remotee_binlog. Should be called if your have get_remote_binlog
     // blocked on reading data from mysql server in the separate thread and you want to stop this thread.
     // You should take care that interruptFlag will return 'true' after connection is closed.
@@ -166,6 +444,28 @@ protected:
     int process_event(const slave::Basic_event_info& bei, RelayLogInfo &rli, unsigned long long pos);
 		
     void request_dump(const std::string& logname, unsigned long start_position, MYSQL* mysql);
+
+    void request_dump_gtid(const GtidSet& gtid_set, MYSQL* mysql);
+
+    void commit_gtid();
+
+    // The transaction is over: gives away the coalesced rows, tells the row handlers.
+    void commit_rows();
+
+    unsigned char negotiate_binlog_checksum(MYSQL* mysql);
+
+    void set_heartbeat_period(MYSQL* mysql);
+
+    void handle_event(const char* buf, unsigned long len);
+
+    // The connection keeps the memory of a huge event, see MasterInfo::max_buffer_size.
+    bool oversized_net_buffer(const MYSQL* mysql) const;
+
+    // At the end of a transaction, with the XID event's header time.
+    void add_lag_samples(time_t when);
+
+    // To m_lag_stats and to ext_state
+    void add_lag_sample(LagStage stage, unsigned long long usec);
 		
     ulong read_event(MYSQL* mysql);
 		
@@ -173,10 +473,35 @@ protected:
                                                  const std::set<std::string>& tbl_names) const;
 
     std::pair<std::string,unsigned int> getLastBinlog();
+
+    GtidSet getMasterGtidExecuted();
 		
+    // Re-reads the structure from the master, after DDL.
+    void reloadDatabaseStructure() {
+        setDatabaseStructure_(false);
+    }
+
+    std::vector<ColumnInfo> readColumns(const std::string& db_name, const std::string& tbl_name) const;
+
+    // The columns of many tables, with one information_schema query per a couple hundred of
+    // them rather than a SHOW FULL COLUMNS each. The tables it can not find are not in 'out'.
+    void readColumns(const table_order_t& tabs, SchemaCache::tables_t& out) const;
+
+    const collate_info& findCollate(const std::string& collate, const ColumnInfo& column) const;
+
     void createTable(RelayLogInfo& rli,
                      const std::string& db_name, const std::string& tbl_name,
-                     const collate_map_t& collate_map, nanomysql::Connection& conn) const;
+                     const std::vector<ColumnInfo>& columns) const;
+
+    // The table of a TABLE_MAP event that is not read yet, if it is watched with setLazyStructure()
+    // or a pattern takes it. Its structure is read from master right then.
+    PtrTable loadTable(unsigned long table_id, const std::pair<std::string, std::string>& key);
+
+    // Do the table's columns match the TABLE_MAP event?
+    bool checkTable(const Table& table, const Table_map_event_info& tmi) const;
+
+    // The temporal fields in the storage the event has for them, see fit_temporal_storage()
+    void fitTable(Table& table, const Table_map_event_info& tmi) const;
 		
     void register_slave_on_master(MYSQL* mysql);
     void deregister_slave_on_master(MYSQL* mysql);
@@ -29,6 +29,9 @@
 
 #include <sys/time.h>
 
+#include "gtid.h"
+#include "lagstats.h"
+
 
 
 namespace slave
@@ -44,7 +47,32 @@ struct MasterInfo {
     unsigned long master_log_pos;
     unsigned int connect_retry;
 
-    MasterInfo() : port(3306), master_log_pos(0), connect_retry(10) {}
+    // Position by GTIDs (as MASTER_AUTO_POSITION=1) instead of master_log_name:master_log_pos.
+    // Requires gtid_mode=ON on master; survives master failover.
+    bool auto_position;
+
+    // Seconds without any packet from master before the connection is considered lost
+    unsigned int read_timeout;
+
+    // Master sends a heartbeat after this many idle seconds (@master_heartbeat_period),
+    // so that an idle master is not taken for a lost one. 0 turns heartbeats off.
+    double heartbeat_period;
+
+    // Stop at the end of the binlog instead of waiting for new events (BINLOG_DUMP_NON_BLOCK):
+    // get_remote_binlog() returns once it has caught up.
+    bool non_blocking;
+
+    // Events longer than this many bytes are logged as suspicious; 0 turns the warning off
+    unsigned long large_event_size;
+
+    // The client library grows its buffer to the longest packet and keeps it; once it is
+    // over this many bytes, the connection is reopened at the end of the transaction to
+    // release it. 0 keeps the connection.
+    unsigned long max_buffer_size;
+
+    MasterInfo() : port(3306), master_log_pos(0), connect_retry(10), auto_position(false),
+        read_timeout(60), heartbeat_period(30), non_blocking(false),
+        large_event_size(3 * 1024 * 1024), max_buffer_size(16 * 1024 * 1024) {}
 
     MasterInfo(std::string host_, unsigned int port_, std::string user_,
                std::string password_, unsigned int connect_retry_) :
@@ -54,7 +82,13 @@ struct MasterInfo {
         password(password_),
         master_log_name(),
         master_log_pos(0),
-        connect_retry(connect_retry_)
+        connect_retry(connect_retry_),
+        auto_position(false),
+        read_timeout(60),
+        heartbeat_period(30),
+        non_blocking(false),
+        large_event_size(3 * 1024 * 1024),
+        max_buffer_size(16 * 1024 * 1024)
         {}
 };
 
@@ -111,6 +145,14 @@ struct ExtStateIface {
     //  .
     virtual bool loadMasterInfo(std::string& logname, unsigned long& pos) = 0;
 
+    // With MasterInfo::auto_position: the set of transactions received so far,
+    // updated on every commit. saveMasterInfo() should persist it too.
+    virtual void setMasterGtidSet(const GtidSet& gtid_set) {}
+
+    // Same as loadMasterInfo(), for the GTID set. If there is nothing saved (and by
+    // default), reading starts from the master's current @@gtid_executed.
+    virtual bool loadMasterGtidSet(GtidSet& gtid_set) { return false; }
+
     //   ,  loadMasterInfo(),    pos 
     //    ,   .
     bool getMasterInfo(std::string& logname, unsigned long& pos)
@@ -132,6 +174,16 @@ struct ExtStateIface {
     //      .
     virtual void initTableCount(const std::string& t) = 0;
     virtual void incTableCount(const std::string& t) = 0;
+
+    // Traffic: every packet from master, and the row events of each watched table.
+    // The difference is what was read only to be thrown away. Not counted by default.
+    virtual void addReceivedBytes(unsigned long bytes) {}
+    virtual void addTableBytes(const std::string& t, unsigned long bytes) {}
+
+    // Lag of every transaction, in microseconds, by stage, as Slave::getLagPercentiles() counts
+    // it. The commit time is exact with MySQL 8.0 masters; before, it is the second the
+    // statement started. Called from the binlog thread.
+    virtual void addLagSample(LagStage stage, unsigned long long usec) {}
 };
 
 
@@ -153,11 +205,16 @@ struct EmptyExtState: public ExtStateIface, protected State {
     virtual std::string getMasterLogName() { return ""; }
     virtual void saveMasterInfo() {}
     virtual bool loadMasterInfo(std::string& logname, unsigned long& pos) { while(true); return false; }
+    virtual void setMasterGtidSet(const GtidSet& gtid_set) {}
+    virtual bool loadMasterGtidSet(GtidSet& gtid_set) { return false; }
     virtual unsigned int getConnectCount() { return 0; }
     virtual void setStateProcessing(bool _state) {}
     virtual bool getStateProcessing() { return false; }
     virtual void initTableCount(const std::string& t) {}
     virtual void incTableCount(const std::string& t) {}
+    virtual void addReceivedBytes(unsigned long bytes) {}
+    virtual void addTableBytes(const std::string& t, unsigned long bytes) {}
+    virtual void addLagSample(LagStage stage, unsigned long long usec) {}
 };
 
 //      ExtStateIface   
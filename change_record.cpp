@@ -0,0 +1,282 @@
+/* Copyright 2011 ZAO "Begun".
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3 of the License, or (at your option)
+ * any later version.
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+
+#include <stdexcept>
+
+#include "change_record.h"
+
+
+namespace
+{
+
+void put_varint(std::string& out, unsigned long long v) {
+
+    while (v >= 0x80) {
+        out += (char)(v | 0x80);
+        v >>= 7;
+    }
+    out += (char)v;
+}
+
+unsigned long long get_varint(const char*& p, const char* end) {
+
+    unsigned long long ret = 0;
+
+    for (unsigned int shift = 0; shift < 64; shift += 7) {
+
+        if (p == end)
+            break;
+
+        const unsigned char b = *p++;
+        ret |= (unsigned long long)(b & 0x7F) << shift;
+
+        if (!(b & 0x80))
+            return ret;
+    }
+
+    throw std::runtime_error("ChangeRecordReader: broken varint");
+}
+
+unsigned int get_uint32(const char*& p, const char* end) {
+
+    if (end - p < 4)
+        throw std::runtime_error("ChangeRecordReader: record is cut off");
+
+    const unsigned char* u = (const unsigned char*)p;
+    p += 4;
+
+    return u[0] | (u[1] << 8) | (u[2] << 16) | ((unsigned int)u[3] << 24);
+}
+
+// A part of [p, end) that is 'len' long
+const char* take(const char*& p, const char* end, size_t len) {
+
+    if ((size_t)(end - p) < len)
+        throw std::runtime_error("ChangeRecordReader: record is cut off");
+
+    const char* ret = p;
+    p += len;
+    return ret;
+}
+
+template <typename T>
+T get_raw(const char*& p, const char* end) {
+    T ret;
+    ::memcpy(&ret, take(p, end, sizeof(T)), sizeof(T));
+    return ret;
+}
+
+}// anonymous-namespace
+
+
+namespace slave
+{
+
+bool ChangeRecordReader::next(ChangeRecord& record) {
+
+    if (m_ptr == m_end)
+        return false;
+
+    const unsigned int len = get_uint32(m_ptr, m_end);
+    const char* p = take(m_ptr, m_end, len);
+    const char* end = p + len;
+
+    record.table_id = get_varint(p, end);
+
+    const int type = *take(p, end, 1);
+    if (type != RecordSet::Write && type != RecordSet::Update && type != RecordSet::Delete)
+        throw std::runtime_error("ChangeRecordReader: bad event type");
+    record.type = (RecordSet::TypeEvent)type;
+
+    record.when = get_varint(p, end);
+    record.server_id = get_varint(p, end);
+    record.columns = get_varint(p, end);
+
+    record.before = record.after = NULL;
+    record.before_len = record.after_len = 0;
+
+    if (record.type != RecordSet::Write) {
+        record.before_len = get_uint32(p, end);
+        record.before = take(p, end, record.before_len);
+    }
+
+    if (record.type != RecordSet::Delete) {
+        record.after_len = get_uint32(p, end);
+        record.after = take(p, end, record.after_len);
+    }
+
+    return true;
+}
+
+bool ChangeImageReader::next(ChangeValue& value) {
+
+    if (m_ptr == m_end)
+        return false;
+
+    const int tag = (unsigned char)*m_ptr++;
+
+    value.state = tag < CR_VALUE ? (ChangeValueState)tag : CR_VALUE;
+
+    if (value.state != CR_VALUE)
+        return true;
+
+    value.kind = (Field::Value_kind)(tag - CR_VALUE);
+
+    switch (value.kind) {
+    case Field::KIND_CHAR:
+        value.u = (unsigned long long)(long long)(signed char)*take(m_ptr, m_end, 1);
+        break;
+    case Field::KIND_INT: {
+        const unsigned long long z = get_varint(m_ptr, m_end);
+        value.u = (unsigned long long)((long long)(z >> 1) ^ -(long long)(z & 1));
+        break;
+    }
+    case Field::KIND_USHORT:
+    case Field::KIND_UINT:
+    case Field::KIND_ULONGLONG:
+        value.u = get_varint(m_ptr, m_end);
+        break;
+    case Field::KIND_FLOAT:
+        value.d = get_raw<float>(m_ptr, m_end);
+        break;
+    case Field::KIND_DOUBLE:
+        value.d = get_raw<double>(m_ptr, m_end);
+        break;
+    case Field::KIND_STRING:
+        value.len = get_varint(m_ptr, m_end);
+        value.data = take(m_ptr, m_end, value.len);
+        break;
+    default:
+        throw std::runtime_error("ChangeRecordReader: bad value tag");
+    }
+
+    return true;
+}
+
+
+ChangeRecordWriter::ChangeRecordWriter(std::string& buffer, const commit_callback_t& on_commit) :
+    m_buffer(buffer), m_on_commit(on_commit), m_record_at(0) {}
+
+void ChangeRecordWriter::addTable(const std::string& db_name, const std::string& tbl_name, unsigned int id) {
+    m_table_ids[db_name + "." + tbl_name] = id;
+}
+
+const unsigned char* ChangeRecordWriter::onRow(Table& table, Image image, const unsigned char* row,
+                                               const std::vector<unsigned char>& cols,
+                                               time_t when, unsigned int server_id) {
+
+    // The after image of an update continues the record
+    if (image != UpdateAfter) {
+
+        m_record_at = begin_length();
+
+        std::map<std::string, unsigned int>::const_iterator id = m_table_ids.find(table.full_name);
+        put_varint(m_buffer, id == m_table_ids.end() ? 0 : id->second);
+
+        m_buffer += (char)(image == Write ? RecordSet::Write : image == Delete ? RecordSet::Delete : RecordSet::Update);
+
+        put_varint(m_buffer, when);
+        put_varint(m_buffer, server_id);
+        put_varint(m_buffer, table.fields.size());
+    }
+
+    const size_t image_at = begin_length();
+
+    const unsigned char* end = unpack_row_to(table, row, cols, *this);
+
+    if (end == NULL) {
+        m_buffer.resize(m_record_at - 4);
+        return NULL;
+    }
+
+    end_length(image_at);
+
+    if (image != UpdateBefore)
+        end_length(m_record_at);
+
+    return end;
+}
+
+void ChangeRecordWriter::onCommit() {
+
+    if (m_on_commit)
+        m_on_commit(m_buffer);
+}
+
+void ChangeRecordWriter::column(unsigned int i, bool present, bool is_null) {
+
+    if (!present)
+        m_buffer += (char)CR_ABSENT;
+    else if (is_null)
+        m_buffer += (char)CR_NULL;
+}
+
+void ChangeRecordWriter::value(char v) {
+    tag(Field::KIND_CHAR);
+    m_buffer += v;
+}
+
+void ChangeRecordWriter::value(unsigned short v) {
+    tag(Field::KIND_USHORT);
+    put_varint(m_buffer, v);
+}
+
+void ChangeRecordWriter::value(int v) {
+    tag(Field::KIND_INT);
+    put_varint(m_buffer, ((unsigned long long)(long long)v << 1) ^ (unsigned long long)((long long)v >> 63));
+}
+
+void ChangeRecordWriter::value(unsigned int v) {
+    tag(Field::KIND_UINT);
+    put_varint(m_buffer, v);
+}
+
+void ChangeRecordWriter::value(unsigned long long v) {
+    tag(Field::KIND_ULONGLONG);
+    put_varint(m_buffer, v);
+}
+
+void ChangeRecordWriter::value(float v) {
+    tag(Field::KIND_FLOAT);
+    m_buffer.append((const char*)&v, sizeof(v));
+}
+
+void ChangeRecordWriter::value(double v) {
+    tag(Field::KIND_DOUBLE);
+    m_buffer.append((const char*)&v, sizeof(v));
+}
+
+void ChangeRecordWriter::value(const char* data, size_t len) {
+    tag(Field::KIND_STRING);
+    put_varint(m_buffer, len);
+    m_buffer.append(data, len);
+}
+
+// Returns where the counted part starts
+size_t ChangeRecordWriter::begin_length() {
+    m_buffer.append(4, '\0');
+    return m_buffer.size();
+}
+
+void ChangeRecordWriter::end_length(size_t at) {
+
+    const size_t len = m_buffer.size() - at;
+
+    for (int i = 0; i < 4; ++i)
+        m_buffer[at - 4 + i] = (char)(len >> (8 * i));
+}
+
+}// slave
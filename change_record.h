@@ -0,0 +1,166 @@
+/* Copyright 2011 ZAO "Begun".
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3 of the License, or (at your option)
+ * any later version.
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __SLAVE_CHANGE_RECORD_H_
+#define __SLAVE_CHANGE_RECORD_H_
+
+#include <time.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+
+#include "recordset.h"
+#include "slave_log_event.h"
+
+
+/*
+ * Compact binary form of a row change, for passing rows on to queues without
+ * RecordSet and boost::any. Integers are varints (zigzag for signed ones).
+ *
+ *   uint32 LE    length of the rest of the record
+ *   varint       table id, see ChangeRecordWriter::addTable()
+ *   byte         RecordSet::TypeEvent: Write, Update or Delete
+ *   varint       when
+ *   varint       server id
+ *   varint       column count
+ *   image        Write: the new row, Delete: the old one, Update: old, then new
+ *
+ * An image is its uint32 LE length, then for every column a tag: CR_ABSENT,
+ * CR_NULL, or CR_VALUE + Field::Value_kind followed by the value. Strings are
+ * the varint length and the bytes, float and double as they are in memory.
+ */
+
+namespace slave
+{
+
+enum ChangeValueState { CR_ABSENT = 0, CR_NULL = 1, CR_VALUE = 2 };
+
+
+// A column of a change record. Strings point into the buffer being read.
+struct ChangeValue {
+
+    ChangeValueState state;
+
+    Field::Value_kind kind;
+
+    // Integers; int is sign extended
+    unsigned long long u;
+
+    // float and double
+    double d;
+
+    const char* data;
+    size_t len;
+
+    ChangeValue() : state(CR_ABSENT), kind(Field::KIND_CHAR), u(0), d(0), data(NULL), len(0) {}
+};
+
+struct ChangeRecord {
+
+    unsigned int table_id;
+    RecordSet::TypeEvent type;
+    time_t when;
+    unsigned int server_id;
+    unsigned int columns;
+
+    // Images, NULL if the record has none; read them with ChangeImageReader
+    const char* before;
+    size_t before_len;
+    const char* after;
+    size_t after_len;
+};
+
+
+// Goes through a buffer of change records, without copying anything.
+// Throws std::runtime_error on a broken record.
+class ChangeRecordReader {
+public:
+
+    ChangeRecordReader(const char* data, size_t len) : m_ptr(data), m_end(data + len) {}
+
+    // False at the end of the buffer
+    bool next(ChangeRecord& record);
+
+private:
+    const char* m_ptr;
+    const char* m_end;
+};
+
+class ChangeImageReader {
+public:
+
+    ChangeImageReader(const char* image, size_t len) : m_ptr(image), m_end(image + len) {}
+
+    // False after the last column
+    bool next(ChangeValue& value);
+
+private:
+    const char* m_ptr;
+    const char* m_end;
+};
+
+
+// Encodes the rows straight from the event into a buffer given by the caller.
+// The commit callback is called at the end of every transaction, to take the
+// records away (and clear the buffer).
+class ChangeRecordWriter: public RowHandler, private Row_sink {
+public:
+
+    typedef boost::function<void (std::string&)> commit_callback_t;
+
+    ChangeRecordWriter(std::string& buffer, const commit_callback_t& on_commit = commit_callback_t());
+
+    // Id of the table in the records; 0 for the tables not added
+    void addTable(const std::string& db_name, const std::string& tbl_name, unsigned int id);
+
+    const unsigned char* onRow(Table& table, Image image, const unsigned char* row,
+                               const std::vector<unsigned char>& cols,
+                               time_t when, unsigned int server_id);
+
+    void onCommit();
+
+private:
+
+    void column(unsigned int i, bool present, bool is_null);
+
+    void value(char v);
+    void value(unsigned short v);
+    void value(int v);
+    void value(unsigned int v);
+    void value(unsigned long long v);
+    void value(float v);
+    void value(double v);
+    void value(const char* data, size_t len);
+
+    void tag(Field::Value_kind kind) { m_buffer += (char)(CR_VALUE + kind); }
+
+    // Reserves a uint32 length, to be filled by end_length()
+    size_t begin_length();
+    void end_length(size_t at);
+
+    std::string& m_buffer;
+    commit_callback_t m_on_commit;
+
+    std::map<std::string, unsigned int> m_table_ids;
+
+    // The record being written, after its length
+    size_t m_record_at;
+};
+
+}// slave
+
+#endif
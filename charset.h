@@ -0,0 +1,55 @@
+/* Copyright 2011 ZAO "Begun".
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3 of the License, or (at your option)
+ * any later version.
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __SLAVE_CHARSET_H_
+#define __SLAVE_CHARSET_H_
+
+#include <stddef.h>
+
+#include <string>
+
+
+namespace slave
+{
+
+// Conversion of string values to UTF-8, by the charset of the column (collate_info::charset),
+// see Slave::setTranscodeUtf8() and Slave::setValidateUtf8().
+class Transcoder {
+public:
+
+    virtual ~Transcoder() {}
+
+    // The value as UTF-8: 'from' itself if it already is, else 'buf' holding it. 'len' is
+    // the length of what is returned.
+    virtual const char* convert(const char* from, size_t& len, std::string& buf) const = 0;
+
+    // The converter for a charset, NULL if there is nothing to do. Single-byte charsets are
+    // transcoded with 'transcode'; utf8 and utf8mb4 are checked with 'validate', and the bytes
+    // that are not valid UTF-8 are replaced with U+FFFD.
+    static const Transcoder* find(const std::string& charset, bool transcode, bool validate);
+
+    // Can the values of the charset be given as UTF-8?
+    static bool isSupported(const std::string& charset);
+};
+
+// Bytes at the start of 'p' below 0x80, checked a word at a time
+size_t ascii_prefix(const char* p, size_t len);
+
+// Bytes at the start of 'p' that are well-formed UTF-8, with sequences of up to
+// 'max_bytes' (3 for utf8, 4 for utf8mb4)
+size_t utf8_valid_prefix(const char* p, size_t len, unsigned int max_bytes);
+
+}// slave
+
+#endif
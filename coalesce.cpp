@@ -0,0 +1,170 @@
+/* Copyright 2011 ZAO "Begun".
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3 of the License, or (at your option)
+ * any later version.
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "coalesce.h"
+
+
+namespace
+{
+
+// Applies the columns an update changed to 'row'. With Slave::setUpdateDiff() the
+// update only has some of the columns; a column in m_old_row only became NULL.
+void apply_update(slave::Row& row, const slave::RecordSet& update)
+{
+    for (slave::Row::const_iterator i = update.m_old_row.begin(); i != update.m_old_row.end(); ++i) {
+        if (update.m_row.find(i->first) == update.m_row.end())
+            row.erase(i->first);
+    }
+
+    for (slave::Row::const_iterator i = update.m_row.begin(); i != update.m_row.end(); ++i)
+        row[i->first] = i->second;
+}
+
+// Reverts the update on 'row': the values as they were before it.
+void revert_update(slave::Row& row, const slave::RecordSet& update)
+{
+    for (slave::Row::const_iterator i = update.m_row.begin(); i != update.m_row.end(); ++i) {
+        if (update.m_old_row.find(i->first) == update.m_old_row.end())
+            row.erase(i->first);
+    }
+
+    for (slave::Row::const_iterator i = update.m_old_row.begin(); i != update.m_old_row.end(); ++i)
+        row[i->first] = i->second;
+}
+
+}// anonymous-namespace
+
+
+namespace slave
+{
+
+void RowCoalescer::add(const boost::shared_ptr<Table>& table, RecordSet& rs,
+                       const std::string& key, const std::string& key_after) {
+
+    const std::string name = table->full_name + '\0';
+
+    if (!key.empty() && key == key_after) {
+
+        std::map<std::string, size_t>::iterator i = m_index.find(name + key);
+
+        if (i != m_index.end()) {
+
+            Change& prev = m_changes[i->second];
+
+            if (merge(prev.rs, rs, prev.dropped))
+                return;
+        }
+
+    } else if (!key.empty()) {
+
+        // The key changed: later changes of either key must not be moved before this one
+        m_index.erase(name + key);
+        m_index.erase(name + key_after);
+    }
+
+    m_changes.push_back(Change());
+
+    Change& change = m_changes.back();
+    change.table = table;
+    change.rs.m_row.swap(rs.m_row);
+    change.rs.m_old_row.swap(rs.m_old_row);
+    change.rs.tbl_name.swap(rs.tbl_name);
+    change.rs.db_name.swap(rs.db_name);
+    change.rs.when = rs.when;
+    change.rs.type_event = rs.type_event;
+    change.rs.master_id = rs.master_id;
+
+    if (!key.empty() && key == key_after)
+        m_index[name + key] = m_changes.size() - 1;
+}
+
+// Folds 'rs' into 'prev'. False if they do not fold (e.g. insert + insert).
+bool RowCoalescer::merge(RecordSet& prev, RecordSet& rs, bool& dropped) {
+
+    if (dropped) {
+
+        // insert + delete, and now the key is back
+        if (rs.type_event != RecordSet::Write)
+            return false;
+
+        prev.m_row.swap(rs.m_row);
+        prev.m_old_row.clear();
+        prev.type_event = RecordSet::Write;
+        dropped = false;
+
+    } else if (prev.type_event == RecordSet::Write && rs.type_event == RecordSet::Update) {
+
+        apply_update(prev.m_row, rs);
+
+    } else if (prev.type_event == RecordSet::Write && rs.type_event == RecordSet::Delete) {
+
+        dropped = true;
+
+    } else if (prev.type_event == RecordSet::Update && rs.type_event == RecordSet::Update) {
+
+        // The first value of every column, and the last one
+        for (Row::const_iterator i = rs.m_old_row.begin(); i != rs.m_old_row.end(); ++i) {
+            if (prev.m_old_row.find(i->first) == prev.m_old_row.end() && prev.m_row.find(i->first) == prev.m_row.end())
+                prev.m_old_row.insert(*i);
+        }
+
+        apply_update(prev.m_row, rs);
+
+    } else if (prev.type_event == RecordSet::Update && rs.type_event == RecordSet::Delete) {
+
+        // Deletes have the row in m_row
+        revert_update(rs.m_row, prev);
+
+        prev.m_row.swap(rs.m_row);
+        prev.m_old_row.clear();
+        prev.type_event = RecordSet::Delete;
+
+    } else if (prev.type_event == RecordSet::Delete && rs.type_event == RecordSet::Write) {
+
+        prev.m_old_row.swap(prev.m_row);
+        prev.m_row.swap(rs.m_row);
+        prev.type_event = RecordSet::Update;
+
+    } else {
+        return false;
+    }
+
+    prev.when = rs.when;
+    prev.master_id = rs.master_id;
+
+    return true;
+}
+
+void RowCoalescer::commit(ExtStateIface& ext_state) {
+
+    for (std::deque<Change>::iterator i = m_changes.begin(); i != m_changes.end(); ++i) {
+        if (!i->dropped)
+            i->table->call_callback(i->rs, ext_state);
+    }
+
+    // The rows are given out after their events, their time is counted now
+    for (std::deque<Change>::iterator i = m_changes.begin(); i != m_changes.end(); ++i) {
+        if (i->table->m_stats)
+            i->table->m_stats->flush();
+    }
+
+    clear();
+}
+
+void RowCoalescer::clear() {
+    m_changes.clear();
+    m_index.clear();
+}
+
+}// slave
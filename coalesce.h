@@ -0,0 +1,74 @@
+/* Copyright 2011 ZAO "Begun".
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3 of the License, or (at your option)
+ * any later version.
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __SLAVE_COALESCE_H_
+#define __SLAVE_COALESCE_H_
+
+#include <deque>
+#include <map>
+#include <string>
+
+#include <boost/shared_ptr.hpp>
+
+#include "recordset.h"
+#include "table.h"
+
+
+namespace slave
+{
+
+// Holds the row changes of a transaction and gives only the net change of every
+// primary key to the callbacks, at commit:
+//
+//   insert + update -> insert      update + update -> update
+//   insert + delete -> nothing     update + delete -> delete
+//   delete + insert -> update
+//
+// Keys are the raw bytes of the primary key columns. Rows without a known key,
+// and updates that change the key, are passed on as they are.
+class RowCoalescer {
+public:
+
+    // key_after differs from key for updates only
+    void add(const boost::shared_ptr<Table>& table, RecordSet& rs,
+             const std::string& key, const std::string& key_after);
+
+    // Calls the callbacks, in the order the keys were first changed.
+    void commit(ExtStateIface& ext_state);
+
+    // Forgets the changes, for a transaction that will be read again.
+    void clear();
+
+private:
+
+    struct Change {
+        boost::shared_ptr<Table> table;
+        RecordSet rs;
+        bool dropped;
+
+        Change() : dropped(false) {}
+    };
+
+    // A deque does not copy the rows when it grows
+    std::deque<Change> m_changes;
+
+    // Table name and key -> the change in m_changes
+    std::map<std::string, size_t> m_index;
+
+    bool merge(RecordSet& prev, RecordSet& rs, bool& dropped);
+};
+
+}// slave
+
+#endif
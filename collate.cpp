@@ -12,7 +12,7 @@ using namespace slave;
 collate_map_t slave::readCollateMap(nanomysql::Connection& conn)
 {
     collate_map_t res;
-    nanomysql::Connection::result_t nanores;
+    nanomysql::Result nanores;
 
     typedef std::map<std::string, int> charset_maxlen_t;
     charset_maxlen_t cm;
@@ -20,39 +20,36 @@ collate_map_t slave::readCollateMap(nanomysql::Connection& conn)
     conn.query("SHOW CHARACTER SET");
     conn.store(nanores);
 
-    for (nanomysql::Connection::result_t::const_iterator i = nanores.begin(); i != nanores.end(); ++i)
-    {
-        std::map<std::string, nanomysql::field>::const_iterator z = i->find("Charset");
-        if (z == i->end())
-            throw std::runtime_error("Slave::readCollateMap(): SHOW CHARACTER SET query did not return 'Charset'");
-        const std::string name = z->second.data;
-
-        z = i->find("Maxlen");
-        if (z == i->end())
-            throw std::runtime_error("Slave::readCollateMap(): SHOW CHARACTER SET query did not return 'Maxlen'");
+    if (!nanores.has("Charset"))
+        throw std::runtime_error("Slave::readCollateMap(): SHOW CHARACTER SET query did not return 'Charset'");
+    if (!nanores.has("Maxlen"))
+        throw std::runtime_error("Slave::readCollateMap(): SHOW CHARACTER SET query did not return 'Maxlen'");
 
-        const int maxlen = atoi(z->second.data.c_str());
+    const size_t charset_col = nanores.column("Charset");
+    const size_t maxlen_col = nanores.column("Maxlen");
 
-        cm[name] = maxlen;
+    for (size_t i = 0; i < nanores.rows(); ++i)
+    {
+        cm[nanores.str(i, charset_col)] = nanores.toInt(i, maxlen_col);
     }
 
-    nanores.clear();
     conn.query("SHOW COLLATION");
     conn.store(nanores);
 
-    for (nanomysql::Connection::result_t::const_iterator i = nanores.begin(); i != nanores.end(); ++i)
+    if (!nanores.has("Collation"))
+        throw std::runtime_error("Slave::readCollateMap(): SHOW COLLATION query did not return 'Collation'");
+    if (!nanores.has("Charset"))
+        throw std::runtime_error("Slave::readCollateMap(): SHOW COLLATION query did not return 'Charset'");
+
+    const size_t collation_col = nanores.column("Collation");
+    const size_t collation_charset_col = nanores.column("Charset");
+
+    for (size_t i = 0; i < nanores.rows(); ++i)
     {
         collate_info ci;
 
-        std::map<std::string, nanomysql::field>::const_iterator z = i->find("Collation");
-        if (z == i->end())
-            throw std::runtime_error("Slave::readCollateMap(): SHOW COLLATION query did not return 'Collation'");
-        ci.name = z->second.data;
-
-        z = i->find("Charset");
-        if (z == i->end())
-            throw std::runtime_error("Slave::readCollateMap(): SHOW COLLATION query did not return 'Charset'");
-        ci.charset = z->second.data;
+        ci.name = nanores.str(i, collation_col);
+        ci.charset = nanores.str(i, collation_charset_col);
 
         charset_maxlen_t::const_iterator j = cm.find(ci.charset);
         if (j == cm.end())
@@ -0,0 +1,150 @@
+/* Copyright 2011 ZAO "Begun".
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3 of the License, or (at your option)
+ * any later version.
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "columnar.h"
+
+
+namespace slave
+{
+
+size_t Column::width(Field::Value_kind kind) {
+
+    switch (kind) {
+    case Field::KIND_CHAR:      return sizeof(char);
+    case Field::KIND_USHORT:    return sizeof(unsigned short);
+    case Field::KIND_INT:       return sizeof(int);
+    case Field::KIND_UINT:      return sizeof(unsigned int);
+    case Field::KIND_ULONGLONG: return sizeof(unsigned long long);
+    case Field::KIND_FLOAT:     return sizeof(float);
+    case Field::KIND_DOUBLE:    return sizeof(double);
+    case Field::KIND_STRING:    return 0;
+    }
+
+    return 0;
+}
+
+
+void ColumnarHandler::Appender::column(unsigned int i, bool present, bool is_null) {
+
+    m_column = &m_batch->columns[i];
+
+    const size_t row = m_batch->rows;
+
+    if ((row & 7) == 0)
+        m_column->validity.push_back(0);
+
+    if (present && !is_null) {
+        m_column->validity.back() |= (1 << (row & 7));
+        return;
+    }
+
+    // No value will follow: fill the slot
+    if (m_column->kind == Field::KIND_STRING)
+        m_column->offsets.push_back(m_column->values.size());
+    else
+        m_column->values.resize(m_column->values.size() + Column::width(m_column->kind));
+}
+
+void ColumnarHandler::Appender::value(const char* data, size_t len) {
+
+    m_column->values.insert(m_column->values.end(), data, data + len);
+    m_column->offsets.push_back(m_column->values.size());
+}
+
+
+ColumnarHandler::ColumnarHandler(const batch_callback_t& callback, size_t max_rows) :
+    m_callback(callback), m_max_rows(max_rows == 0 ? 1 : max_rows) {}
+
+const unsigned char* ColumnarHandler::onRow(Table& table, Image image, const unsigned char* row,
+                                            const std::vector<unsigned char>& cols,
+                                            time_t when, unsigned int server_id) {
+
+    Batch& batch = m_batches[table.full_name];
+
+    if (batch.data.rows == 0)
+        start(batch, table);
+
+    m_appender.start(batch.data);
+
+    const unsigned char* end = unpack_row_to(table, row, cols, m_appender);
+
+    if (end == NULL)
+        return NULL;
+
+    batch.data.images.push_back(image);
+    batch.data.when.push_back(when);
+    batch.data.server_id.push_back(server_id);
+
+    if (++batch.data.rows >= m_max_rows)
+        flush(batch);
+
+    return end;
+}
+
+void ColumnarHandler::onTable(const Table& table) {
+
+    std::map<std::string, Batch>::iterator i = m_batches.find(table.full_name);
+
+    if (i != m_batches.end())
+        flush(i->second);
+}
+
+void ColumnarHandler::flush() {
+
+    for (std::map<std::string, Batch>::iterator i = m_batches.begin(); i != m_batches.end(); ++i)
+        flush(i->second);
+}
+
+// The columns are set up again from the table, the buffers keep their memory.
+void ColumnarHandler::start(Batch& batch, const Table& table) {
+
+    batch.data.db_name = table.database_name;
+    batch.data.tbl_name = table.table_name;
+
+    batch.data.columns.resize(table.fields.size());
+
+    for (size_t i = 0; i < table.fields.size(); ++i) {
+
+        Column& column = batch.data.columns[i];
+
+        column.name = table.fields[i]->getFieldName();
+        column.kind = table.fields[i]->kind();
+        column.offsets.clear();
+
+        if (column.kind == Field::KIND_STRING)
+            column.offsets.push_back(0);
+    }
+}
+
+// Does not touch the table, it may be gone already.
+void ColumnarHandler::flush(Batch& batch) {
+
+    ColumnBatch& data = batch.data;
+
+    if (data.rows != 0)
+        m_callback(data);
+
+    data.rows = 0;
+    data.images.clear();
+    data.when.clear();
+    data.server_id.clear();
+
+    for (std::vector<Column>::iterator i = data.columns.begin(); i != data.columns.end(); ++i) {
+        i->validity.clear();
+        i->values.clear();
+        i->offsets.clear();
+    }
+}
+
+}// slave
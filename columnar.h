@@ -0,0 +1,163 @@
+/* Copyright 2011 ZAO "Begun".
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3 of the License, or (at your option)
+ * any later version.
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __SLAVE_COLUMNAR_H_
+#define __SLAVE_COLUMNAR_H_
+
+#include <string.h>
+#include <time.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+
+#include "slave_log_event.h"
+
+
+namespace slave
+{
+
+// One column of a ColumnBatch, laid out as in Apache Arrow.
+struct Column {
+
+    std::string name;
+
+    // What the values are, see Field::kind()
+    Field::Value_kind kind;
+
+    // A bit per row, the least significant first. 0 if the value is NULL,
+    // or the column is not in the row image (binlog_row_image=MINIMAL).
+    std::vector<unsigned char> validity;
+
+    // Fixed width values, zeros for invalid rows; or the bytes of all the strings.
+    std::vector<char> values;
+
+    // Strings only: row i is values[offsets[i], offsets[i + 1]).
+    std::vector<unsigned int> offsets;
+
+    bool valid(size_t row) const {
+        return validity[row / 8] & (1 << (row & 7));
+    }
+
+    // T must be the type of kind
+    template <typename T>
+    T get(size_t row) const {
+        T ret;
+        ::memcpy(&ret, &values[row * sizeof(T)], sizeof(T));
+        return ret;
+    }
+
+    std::string getString(size_t row) const {
+        return std::string(values.begin() + offsets[row], values.begin() + offsets[row + 1]);
+    }
+
+    // Width of a fixed width value, 0 for strings
+    static size_t width(Field::Value_kind kind);
+};
+
+// Rows of one table.
+struct ColumnBatch {
+
+    std::string db_name;
+    std::string tbl_name;
+
+    size_t rows;
+
+    // Per row: RowHandler::Image, and the event it came from
+    std::vector<unsigned char> images;
+    std::vector<time_t> when;
+    std::vector<unsigned int> server_id;
+
+    // As the table's fields
+    std::vector<Column> columns;
+
+    ColumnBatch() : rows(0) {}
+};
+
+
+// Decodes the rows straight into column buffers, per table. A batch is given to the
+// callback when it has max_rows rows, and at the end of every transaction; so a batch
+// never has rows of two transactions. The buffers are reused, copy what is needed.
+class ColumnarHandler: public RowHandler {
+public:
+
+    typedef boost::function<void (const ColumnBatch&)> batch_callback_t;
+
+    ColumnarHandler(const batch_callback_t& callback, size_t max_rows = 65536);
+
+    const unsigned char* onRow(Table& table, Image image, const unsigned char* row,
+                               const std::vector<unsigned char>& cols,
+                               time_t when, unsigned int server_id);
+
+    void onCommit() { flush(); }
+
+    // The table was read again (DDL, a TABLE_MAP mismatch): its pending rows have the old
+    // columns, they go out now and the next row lays the batch out anew.
+    void onTable(const Table& table);
+
+    // Gives away all the non-empty batches.
+    void flush();
+
+private:
+
+    struct Batch {
+        ColumnBatch data;
+    };
+
+    // Appends the row to a batch.
+    class Appender: public Row_sink {
+    public:
+        Appender() : m_batch(NULL), m_column(NULL) {}
+
+        void start(ColumnBatch& batch) { m_batch = &batch; }
+
+        void column(unsigned int i, bool present, bool is_null);
+
+        void value(char v) { put(v); }
+        void value(unsigned short v) { put(v); }
+        void value(int v) { put(v); }
+        void value(unsigned int v) { put(v); }
+        void value(unsigned long long v) { put(v); }
+        void value(float v) { put(v); }
+        void value(double v) { put(v); }
+        void value(const char* data, size_t len);
+
+    private:
+        template <typename T>
+        void put(T v) {
+            const char* p = (const char*)&v;
+            m_column->values.insert(m_column->values.end(), p, p + sizeof(T));
+        }
+
+        ColumnBatch* m_batch;
+        Column* m_column;
+    };
+
+    void start(Batch& batch, const Table& table);
+    void flush(Batch& batch);
+
+    batch_callback_t m_callback;
+    size_t m_max_rows;
+
+    // By the full table name
+    std::map<std::string, Batch> m_batches;
+
+    Appender m_appender;
+};
+
+}// slave
+
+#endif
@@ -0,0 +1,158 @@
+/* Copyright 2011 ZAO "Begun".
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3 of the License, or (at your option)
+ * any later version.
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <exception>
+
+#include "connection_pool.h"
+#include "mutex_lock.h"
+#include "Logging.h"
+
+
+namespace slave
+{
+
+ConnectionPool::ConnectionPool(const nanomysql::Connection::Attributes& attr, size_t max_idle,
+                               unsigned int idle_timeout, unsigned int ping_after) :
+    m_attr(attr), m_max_idle(max_idle), m_idle_timeout(idle_timeout), m_ping_after(ping_after),
+    m_connects(0) {
+
+    ::pthread_mutex_init(&m_mutex, NULL);
+}
+
+ConnectionPool::~ConnectionPool() {
+
+    m_idle.clear();
+    ::pthread_mutex_destroy(&m_mutex);
+}
+
+
+ConnectionPool::Lease::Lease(ConnectionPool& pool) :
+    m_pool(pool), m_conn(pool.acquire()), m_discard(false) {}
+
+ConnectionPool::Lease::~Lease() {
+
+    m_pool.release(m_conn, m_discard || std::uncaught_exception());
+}
+
+
+ConnectionPool::PtrConnection ConnectionPool::acquire() {
+
+    while (true) {
+
+        PtrConnection conn;
+        time_t since = 0;
+        std::vector<PtrConnection> closed;
+
+        {
+            MutexLock lock(m_mutex);
+
+            const time_t now = ::time(NULL);
+            reap_locked(now, closed);
+
+            if (m_idle.empty())
+                break;
+
+            conn = m_idle.back().conn;
+            since = m_idle.back().since;
+            m_idle.pop_back();
+        }
+
+        if (::time(NULL) - since < (time_t)m_ping_after || conn->ping())
+            return conn;
+
+        LOG_WARNING(log, "Lost a metadata connection to " << m_attr.host << ":" << m_attr.port << ", reconnecting.");
+    }
+
+    PtrConnection conn(new nanomysql::Connection(m_attr));
+
+    MutexLock lock(m_mutex);
+    ++m_connects;
+
+    return conn;
+}
+
+
+void ConnectionPool::release(const PtrConnection& conn, bool discard) {
+
+    if (discard)
+        return;
+
+    std::vector<PtrConnection> closed;
+
+    MutexLock lock(m_mutex);
+
+    const time_t now = ::time(NULL);
+
+    Idle idle;
+    idle.conn = conn;
+    idle.since = now;
+
+    m_idle.push_back(idle);
+
+    reap_locked(now, closed);
+
+    while (m_idle.size() > m_max_idle) {
+        closed.push_back(m_idle.front().conn);
+        m_idle.erase(m_idle.begin());
+    }
+}
+
+
+void ConnectionPool::reap_locked(time_t now, std::vector<PtrConnection>& closed) {
+
+    size_t n = 0;
+
+    while (n < m_idle.size() && now - m_idle[n].since >= (time_t)m_idle_timeout) {
+        closed.push_back(m_idle[n].conn);
+        ++n;
+    }
+
+    m_idle.erase(m_idle.begin(), m_idle.begin() + n);
+}
+
+
+void ConnectionPool::reap() {
+
+    std::vector<PtrConnection> closed;
+
+    MutexLock lock(m_mutex);
+    reap_locked(::time(NULL), closed);
+}
+
+void ConnectionPool::clear() {
+
+    std::vector<PtrConnection> closed;
+
+    MutexLock lock(m_mutex);
+
+    for (size_t i = 0; i < m_idle.size(); ++i)
+        closed.push_back(m_idle[i].conn);
+
+    m_idle.clear();
+}
+
+
+size_t ConnectionPool::idle() const {
+
+    MutexLock lock(m_mutex);
+    return m_idle.size();
+}
+
+unsigned long ConnectionPool::connects() const {
+
+    MutexLock lock(m_mutex);
+    return m_connects;
+}
+
+}// slave
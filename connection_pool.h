@@ -0,0 +1,113 @@
+/* Copyright 2011 ZAO "Begun".
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3 of the License, or (at your option)
+ * any later version.
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __SLAVE_CONNECTION_POOL_H_
+#define __SLAVE_CONNECTION_POOL_H_
+
+#include <pthread.h>
+#include <time.h>
+
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include "nanomysql.h"
+
+
+namespace slave
+{
+
+// Connections to master for the metadata queries (versions, SHOW COLUMNS and the like),
+// kept open between them. A connection is opened when none is idle, checked with a ping
+// if it has been idle for a while, and closed when it has been idle for too long.
+class ConnectionPool {
+public:
+
+    // At most 'max_idle' connections are kept; one idle for 'idle_timeout' seconds is closed,
+    // one idle for 'ping_after' seconds is pinged before it is given out.
+    explicit ConnectionPool(const nanomysql::Connection::Attributes& attr, size_t max_idle = 2,
+                            unsigned int idle_timeout = 300, unsigned int ping_after = 10);
+
+    ~ConnectionPool();
+
+    // A connection taken from the pool for the scope. It goes back when the lease ends,
+    // unless an exception is on its way: a query may have been left half read.
+    class Lease {
+    public:
+
+        // Throws std::runtime_error if it can not connect.
+        explicit Lease(ConnectionPool& pool);
+        ~Lease();
+
+        nanomysql::Connection& operator* () const { return *m_conn; }
+        nanomysql::Connection* operator-> () const { return m_conn.get(); }
+
+        // Close the connection instead of giving it back.
+        void discard() { m_discard = true; }
+
+    private:
+
+        Lease(const Lease&);
+        Lease& operator= (const Lease&);
+
+        ConnectionPool& m_pool;
+        boost::shared_ptr<nanomysql::Connection> m_conn;
+        bool m_discard;
+    };
+
+    // Closes the connections idle for longer than idle_timeout. It is done on every
+    // lease anyway; this is for the times there are none for long.
+    void reap();
+
+    // Closes all the idle connections.
+    void clear();
+
+    size_t idle() const;
+
+    // Connections opened so far
+    unsigned long connects() const;
+
+private:
+
+    ConnectionPool(const ConnectionPool&);
+    ConnectionPool& operator= (const ConnectionPool&);
+
+    typedef boost::shared_ptr<nanomysql::Connection> PtrConnection;
+
+    struct Idle {
+        PtrConnection conn;
+        time_t since;
+    };
+
+    PtrConnection acquire();
+    void release(const PtrConnection& conn, bool discard);
+
+    // Moves the connections idle for too long to 'closed', to be closed out of the lock
+    void reap_locked(time_t now, std::vector<PtrConnection>& closed);
+
+    nanomysql::Connection::Attributes m_attr;
+    size_t m_max_idle;
+    unsigned int m_idle_timeout;
+    unsigned int m_ping_after;
+
+    mutable pthread_mutex_t m_mutex;
+
+    // The least recently used first
+    std::vector<Idle> m_idle;
+    unsigned long m_connects;
+};
+
+}// slave
+
+#endif
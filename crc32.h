@@ -0,0 +1,34 @@
+/* Copyright 2011 ZAO "Begun".
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3 of the License, or (at your option)
+ * any later version.
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __SLAVE_CRC32_H
+#define __SLAVE_CRC32_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace slave
+{
+
+// CRC32 as used for binlog event checksums (zlib polynomial, not CRC32C).
+// 'crc' is the value returned by a previous call, or 0 for a fresh checksum.
+// Uses PCLMULQDQ folding when the CPU supports it, slicing-by-8 tables otherwise.
+uint32_t binlog_crc32(uint32_t crc, const unsigned char* buf, size_t len);
+
+// Is the carry-less multiplication path in use on this CPU?
+bool binlog_crc32_is_accelerated();
+
+}// slave
+
+#endif
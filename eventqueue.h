@@ -0,0 +1,230 @@
+/* Copyright 2011 ZAO "Begun".
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3 of the License, or (at your option)
+ * any later version.
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __SLAVE_EVENTQUEUE_H_
+#define __SLAVE_EVENTQUEUE_H_
+
+#include <errno.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+
+namespace slave
+{
+
+// Bounded queue from the binlog thread (the only producer) to one consumer thread.
+// When it is full, push() blocks, and so does the binlog thread: it stops reading
+// the socket, and memory stays bounded while the consumer is slow or stuck.
+//
+//     slave::EventQueue<slave::RecordSet> queue(10000);
+//     slave.setCallback("db", "table", boost::bind(&slave::EventQueue<slave::RecordSet>::push, &queue, _1));
+//
+// try_pop() and try_push() take no lock, for a consumer that polls; the blocking
+// calls sleep on a condition variable, which the other side only touches when
+// someone is actually waiting.
+template <typename T>
+class EventQueue {
+public:
+
+    explicit EventQueue(size_t capacity) :
+        m_ring(capacity), m_head(0), m_tail(0), m_closed(false),
+        m_producer_waiting(false), m_consumer_waiting(false), m_high_water(0) {
+
+        if (capacity == 0)
+            throw std::runtime_error("EventQueue: capacity must be positive");
+
+        ::pthread_mutex_init(&m_mutex, NULL);
+        ::pthread_cond_init(&m_not_empty, NULL);
+        ::pthread_cond_init(&m_not_full, NULL);
+    }
+
+    ~EventQueue() {
+        ::pthread_cond_destroy(&m_not_full);
+        ::pthread_cond_destroy(&m_not_empty);
+        ::pthread_mutex_destroy(&m_mutex);
+    }
+
+    // Producer. False if the queue is full or closed.
+    bool try_push(const T& v) {
+
+        if (m_closed)
+            return false;
+
+        const size_t tail = m_tail;
+
+        if (tail - m_head == m_ring.size())
+            return false;
+
+        m_ring[tail % m_ring.size()] = v;
+
+        __sync_synchronize();
+        m_tail = tail + 1;
+        __sync_synchronize();
+
+        if (tail + 1 - m_head > m_high_water)
+            m_high_water = tail + 1 - m_head;
+
+        if (m_consumer_waiting)
+            signal(m_not_empty);
+
+        return true;
+    }
+
+    // Producer. Waits for room; false if the queue was closed.
+    bool push(const T& v) {
+
+        while (!try_push(v)) {
+
+            if (m_closed)
+                return false;
+
+            wait(m_producer_waiting, m_not_full, &EventQueue::full, 0);
+        }
+
+        return true;
+    }
+
+    // Consumer. False if the queue is empty.
+    bool try_pop(T& out) {
+
+        const size_t head = m_head;
+
+        if (head == m_tail)
+            return false;
+
+        __sync_synchronize();
+
+        T& slot = m_ring[head % m_ring.size()];
+        std::swap(out, slot);
+        slot = T();
+
+        __sync_synchronize();
+        m_head = head + 1;
+        __sync_synchronize();
+
+        if (m_producer_waiting)
+            signal(m_not_full);
+
+        return true;
+    }
+
+    // Consumer. Waits up to timeout_ms (0 -- forever); false on timeout, or if the
+    // queue was closed and is empty.
+    bool pop(T& out, unsigned int timeout_ms = 0) {
+
+        while (!try_pop(out)) {
+
+            if (m_closed)
+                return false;
+
+            if (!wait(m_consumer_waiting, m_not_empty, &EventQueue::empty, timeout_ms))
+                return try_pop(out);
+        }
+
+        return true;
+    }
+
+    // Wakes everyone; push() fails from now on, pop() once the queue is drained.
+    void close() {
+
+        ::pthread_mutex_lock(&m_mutex);
+        m_closed = true;
+        ::pthread_cond_broadcast(&m_not_empty);
+        ::pthread_cond_broadcast(&m_not_full);
+        ::pthread_mutex_unlock(&m_mutex);
+    }
+
+    size_t size() const { return m_tail - m_head; }
+    size_t capacity() const { return m_ring.size(); }
+
+    // The most items that were ever in the queue at once
+    size_t high_water() const { return m_high_water; }
+
+private:
+
+    EventQueue(const EventQueue&);
+    EventQueue& operator= (const EventQueue&);
+
+    bool full() const { return m_tail - m_head == m_ring.size(); }
+    bool empty() const { return m_tail == m_head; }
+
+    void signal(pthread_cond_t& cond) {
+        ::pthread_mutex_lock(&m_mutex);
+        ::pthread_cond_signal(&cond);
+        ::pthread_mutex_unlock(&m_mutex);
+    }
+
+    // Sleeps while 'blocked'. The flag is raised before the check, and the other side
+    // looks at it after its change (both behind a full barrier), so no wakeup is lost.
+    bool wait(volatile bool& waiting, pthread_cond_t& cond, bool (EventQueue::*blocked)() const, unsigned int timeout_ms) {
+
+        struct timespec deadline;
+
+        if (timeout_ms != 0) {
+            struct timeval now;
+            ::gettimeofday(&now, NULL);
+            const unsigned long long ns = (now.tv_usec + (timeout_ms % 1000) * 1000ULL) * 1000;
+            deadline.tv_sec = now.tv_sec + timeout_ms / 1000 + ns / 1000000000;
+            deadline.tv_nsec = ns % 1000000000;
+        }
+
+        bool ret = true;
+
+        ::pthread_mutex_lock(&m_mutex);
+
+        waiting = true;
+        __sync_synchronize();
+
+        while ((this->*blocked)() && !m_closed) {
+
+            if (timeout_ms == 0) {
+                ::pthread_cond_wait(&cond, &m_mutex);
+
+            } else if (::pthread_cond_timedwait(&cond, &m_mutex, &deadline) == ETIMEDOUT) {
+                ret = false;
+                break;
+            }
+        }
+
+        waiting = false;
+
+        ::pthread_mutex_unlock(&m_mutex);
+
+        return ret;
+    }
+
+    std::vector<T> m_ring;
+
+    // Counters of pushed and popped items; each is written by one side only
+    volatile size_t m_head;
+    volatile size_t m_tail;
+
+    volatile bool m_closed;
+    volatile bool m_producer_waiting;
+    volatile bool m_consumer_waiting;
+
+    size_t m_high_water;
+
+    pthread_mutex_t m_mutex;
+    pthread_cond_t m_not_empty;
+    pthread_cond_t m_not_full;
+};
+
+}// slave
+
+#endif
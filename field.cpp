@@ -14,6 +14,8 @@
 
 
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <vector>
 #include <stdexcept>                                                                                                                
 #include <mysql/my_global.h>
@@ -29,9 +31,177 @@
 
 
 
+namespace
+{
+
+inline ulonglong read_be(const char* from, unsigned int bytes) {
+
+    ulonglong ret = 0;
+
+    for (unsigned int i = 0; i < bytes; ++i)
+        ret = (ret << 8) | (unsigned char)from[i];
+
+    return ret;
+}
+
+// Number in parentheses of the column type: 'datetime(6)' -> 6, 'datetime' -> 0.
+unsigned int type_length(const std::string& type) {
+
+    std::string::size_type b = type.find('(', 0);
+
+    if (b == std::string::npos)
+        return 0;
+
+    return ::atoi(type.c_str() + b + 1);
+}
+
+unsigned int fractional_precision(const std::string& type) {
+
+    const unsigned int fsp = type_length(type);
+
+    if (fsp > 6)
+        throw std::runtime_error("Invalid fractional seconds precision in type '" + type + "'");
+
+    return fsp;
+}
+
+// Fractional part of TIMESTAMP2/DATETIME2, in microseconds.
+inline unsigned int read_frac(const char* from, unsigned int fsp) {
+
+    switch (fsp) {
+    case 1:
+    case 2:
+        return (unsigned int)read_be(from, 1) * 10000;
+    case 3:
+    case 4:
+        return (unsigned int)read_be(from, 2) * 100;
+    case 5:
+    case 6:
+        return (unsigned int)read_be(from, 3);
+    }
+
+    return 0;
+}
+
+// Text of an integer column; unsigned values above LLONG_MAX come as they are.
+inline ulonglong str_to_ull(const char* from) {
+
+    return (*from == '-') ? (ulonglong)::strtoll(from, NULL, 10) : ::strtoull(from, NULL, 10);
+}
+
+// Fractional part of "20120101123456.123" in microseconds.
+unsigned int str_frac(const char* from, unsigned long len) {
+
+    const char* p = (const char*)::memchr(from, '.', len);
+
+    if (p == NULL)
+        return 0;
+
+    unsigned int ret = 0;
+    unsigned int digits = 0;
+
+    for (++p; p < from + len && digits < 6 && *p >= '0' && *p <= '9'; ++p, ++digits)
+        ret = ret * 10 + (*p - '0');
+
+    for (; digits < 6; ++digits)
+        ret *= 10;
+
+    return ret;
+}
+
+// Bytes of a DECIMAL group of so many digits
+const unsigned char DECIMAL_GROUP_BYTES[10] = { 0, 1, 1, 2, 2, 3, 3, 4, 4, 4 };
+
+const unsigned int POW10[10] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+// Up to the largest scale of a scaled DECIMAL
+const unsigned long long POW10_64[19] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL,
+    1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+    100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL,
+    1000000000000000000ULL
+};
+
+const char DIGIT_PAIRS[] =
+    "0001020304050607080910111213141516171819202122232425262728293031323334353637383940414243444546474849"
+    "5051525354555657585960616263646566676869707172737475767778798081828384858687888990919293949596979899";
+
+// Exactly 'digits' digits of v, with the leading zeros, two at a time
+inline char* put_digits(char* p, unsigned int v, unsigned int digits) {
+
+    char* const end = p + digits;
+    char* q = end;
+
+    for (; q - p >= 2; v /= 100) {
+        q -= 2;
+        ::memcpy(q, DIGIT_PAIRS + (v % 100) * 2, 2);
+    }
+
+    if (q != p)
+        *--q = (char)('0' + v);
+
+    return end;
+}
+
+// Digits of a DECIMAL group, without the leading zeros
+inline unsigned int group_digits(unsigned int v) {
+
+    if (v < 10000)
+        return v < 100 ? (v < 10 ? 1 : 2) : (v < 1000 ? 3 : 4);
+
+    if (v < 100000000)
+        return v < 1000000 ? (v < 100000 ? 5 : 6) : (v < 10000000 ? 7 : 8);
+
+    return 9;
+}
+
+std::string quote_name(const std::string& name) {
+
+    std::string ret = "`";
+
+    for (std::string::const_iterator i = name.begin(); i != name.end(); ++i) {
+        if (*i == '`')
+            ret += '`';
+        ret += *i;
+    }
+
+    return ret + "`";
+}
+
+}// anonymous-namespace
+
+
 namespace slave
 {
 
+std::string Field::select_expr() const {
+    return quote_name(field_name);
+}
+
+const char* Field::unpack_to(const char* from, Value_sink& sink) {
+
+    from = unpack(from);
+
+    switch (kind()) {
+    case KIND_CHAR:      sink.value(boost::any_cast<char>(field_data)); break;
+    case KIND_USHORT:    sink.value(boost::any_cast<uint16>(field_data)); break;
+    case KIND_INT:       sink.value(boost::any_cast<int>(field_data)); break;
+    case KIND_UINT:      sink.value(boost::any_cast<uint32>(field_data)); break;
+    case KIND_ULONGLONG: sink.value(boost::any_cast<ulonglong>(field_data)); break;
+    case KIND_FLOAT:     sink.value(boost::any_cast<float>(field_data)); break;
+    case KIND_DOUBLE:    sink.value(boost::any_cast<double>(field_data)); break;
+    case KIND_STRING: {
+        const std::string& str = *boost::any_cast<std::string>(&field_data);
+        sink.value(str.data(), str.size());
+        break;
+    }
+    }
+
+    return from;
+}
+
 
 
 Field_num::Field_num(const std::string& field_name_arg, const std::string& type):
@@ -50,6 +220,15 @@ const char* Field_tiny::unpack(const char* from) {
     return from + pack_length();
 }
 
+const char* Field_tiny::unpack_to(const char* from, Value_sink& sink) {
+    sink.value(*from);
+    return from + pack_length();
+}
+
+void Field_tiny::unpack_str(const char* from, unsigned long len) {
+    field_data = (char)::strtol(from, NULL, 10);
+}
+
 
 Field_short::Field_short(const std::string& field_name_arg, const std::string& type):
     Field_num(field_name_arg, type) {}
@@ -64,6 +243,15 @@ const char* Field_short::unpack(const char* from) {
     return from + pack_length();
 }
 
+const char* Field_short::unpack_to(const char* from, Value_sink& sink) {
+    sink.value((uint16)uint2korr(from));
+    return from + pack_length();
+}
+
+void Field_short::unpack_str(const char* from, unsigned long len) {
+    field_data = (uint16)::strtol(from, NULL, 10);
+}
+
 Field_medium::Field_medium(const std::string& field_name_arg, const std::string& type):
     Field_num(field_name_arg, type) {}
 
@@ -77,6 +265,16 @@ const char* Field_medium::unpack(const char* from) {
     return from + pack_length();
 }
 
+const char* Field_medium::unpack_to(const char* from, Value_sink& sink) {
+    sink.value((uint32)uint3korr(from));
+    return from + pack_length();
+}
+
+void Field_medium::unpack_str(const char* from, unsigned long len) {
+    // 3 bytes as they are, the same as uint3korr() gives
+    field_data = (uint32)(::strtol(from, NULL, 10) & 0xFFFFFF);
+}
+
 Field_long::Field_long(const std::string& field_name_arg, const std::string& type):
     Field_num(field_name_arg, type) {}
 
@@ -90,6 +288,15 @@ const char* Field_long::unpack(const char* from) {
     return from + pack_length();
 }
 
+const char* Field_long::unpack_to(const char* from, Value_sink& sink) {
+    sink.value((uint32)uint4korr(from));
+    return from + pack_length();
+}
+
+void Field_long::unpack_str(const char* from, unsigned long len) {
+    field_data = (uint32)::strtoll(from, NULL, 10);
+}
+
 Field_longlong::Field_longlong(const std::string& field_name_arg, const std::string& type):
     Field_num(field_name_arg, type) {}
 
@@ -103,12 +310,224 @@ const char* Field_longlong::unpack(const char* from) {
     return from + pack_length();
 }
 
+const char* Field_longlong::unpack_to(const char* from, Value_sink& sink) {
+    sink.value((ulonglong)uint8korr(from));
+    return from + pack_length();
+}
+
+void Field_longlong::unpack_str(const char* from, unsigned long len) {
+    field_data = str_to_ull(from);
+}
+
 Field_real::Field_real(const std::string& field_name_arg, const std::string& type):
     Field_num(field_name_arg, type) {}
 
 Field_decimal::Field_decimal(const std::string& field_name_arg, const std::string& type):
     Field_real(field_name_arg, type) {}
 
+Field_new_decimal::Field_new_decimal(const std::string& field_name_arg, const std::string& type):
+    Field_num(field_name_arg, type), m_precision(type_length(type)), m_scale(0), m_bytes(0),
+    m_groups(0), m_int_groups(0), m_scaled(false) {
+
+    // 'decimal(10,2) unsigned'; plain 'decimal' is decimal(10,0)
+    const std::string::size_type comma = type.find(',');
+
+    if (comma != std::string::npos)
+        m_scale = ::atoi(type.c_str() + comma + 1);
+
+    if (m_precision == 0)
+        m_precision = 10;
+
+    if (m_precision > 65 || m_scale > 30 || m_scale > m_precision)
+        throw std::runtime_error("Field_new_decimal: Incorrect field DECIMAL");
+
+    const unsigned int intg = m_precision - m_scale;
+
+    // The leftover digits of the integer part go first, the ones of the fraction last
+    if (intg % 9) {
+        m_group_bytes[m_groups] = DECIMAL_GROUP_BYTES[intg % 9];
+        m_group_digits[m_groups++] = intg % 9;
+    }
+
+    for (unsigned int i = 0; i < intg / 9; ++i) {
+        m_group_bytes[m_groups] = 4;
+        m_group_digits[m_groups++] = 9;
+    }
+
+    m_int_groups = m_groups;
+
+    for (unsigned int i = 0; i < m_scale / 9; ++i) {
+        m_group_bytes[m_groups] = 4;
+        m_group_digits[m_groups++] = 9;
+    }
+
+    if (m_scale % 9) {
+        m_group_bytes[m_groups] = DECIMAL_GROUP_BYTES[m_scale % 9];
+        m_group_digits[m_groups++] = m_scale % 9;
+    }
+
+    for (unsigned int i = 0; i < m_groups; ++i)
+        m_bytes += m_group_bytes[i];
+}
+
+bool Field_new_decimal::setScaled(bool scaled) {
+
+    // 18 digits fit in 64 bits, and so does 10^scale (see POW10_64)
+    if (scaled && (m_precision > 18 || m_scale > 18))
+        return false;
+
+    m_scaled = scaled;
+    return true;
+}
+
+bool Field_new_decimal::read_groups(const char* from, unsigned int* groups) const {
+
+    // Positive values have the top bit set, negative ones have all the bits inverted
+    const unsigned char mask = ((unsigned char)from[0] & 0x80) ? 0 : 0xFF;
+
+    for (unsigned int i = 0; i < m_groups; ++i) {
+
+        unsigned int v = 0;
+
+        for (unsigned int b = 0; b < m_group_bytes[i]; ++b)
+            v = (v << 8) | (unsigned char)(*from++ ^ mask);
+
+        groups[i] = v;
+    }
+
+    groups[0] ^= 0x80U << ((m_group_bytes[0] - 1) * 8);
+
+    return mask != 0;
+}
+
+const char* Field_new_decimal::format(const char* from, char* buf, size_t& len) const {
+
+    unsigned int groups[MAX_GROUPS];
+    const bool negative = read_groups(from, groups);
+
+    // Room for the sign before
+    char* const begin = buf + 1;
+    char* p = begin;
+
+    bool zero = true;
+    unsigned int i = 0;
+
+    while (i < m_int_groups && groups[i] == 0)
+        ++i;
+
+    if (i == m_int_groups) {
+        *p++ = '0';
+
+    } else {
+        zero = false;
+        p = put_digits(p, groups[i], group_digits(groups[i]));
+
+        for (++i; i < m_int_groups; ++i)
+            p = put_digits(p, groups[i], m_group_digits[i]);
+    }
+
+    if (m_scale != 0) {
+
+        *p++ = '.';
+
+        for (; i < m_groups; ++i) {
+            zero = zero && groups[i] == 0;
+            p = put_digits(p, groups[i], m_group_digits[i]);
+        }
+    }
+
+    len = p - begin;
+
+    if (!negative || zero)
+        return begin;
+
+    ++len;
+    buf[0] = '-';
+
+    return buf;
+}
+
+long long Field_new_decimal::scaled(const char* from) const {
+
+    unsigned int groups[MAX_GROUPS];
+    const bool negative = read_groups(from, groups);
+
+    // The groups one after another are the digits of the number times 10^scale
+    ulonglong v = 0;
+
+    for (unsigned int i = 0; i < m_groups; ++i)
+        v = v * POW10[m_group_digits[i]] + groups[i];
+
+    return negative ? -(longlong)v : (longlong)v;
+}
+
+const char* Field_new_decimal::unpack(const char* from) {
+
+    if (m_scaled) {
+
+        const long long tmp = scaled(from);
+        field_data = (ulonglong)tmp;
+
+        LOG_TRACE(log, "  decimal: " << tmp << " // " << pack_length());
+
+    } else {
+
+        size_t len = 0;
+        const char* text = format(from, m_text, len);
+        field_data = std::string(text, len);
+
+        LOG_TRACE(log, "  decimal: " << std::string(text, len) << " // " << pack_length());
+    }
+
+    return from + pack_length();
+}
+
+const char* Field_new_decimal::unpack_to(const char* from, Value_sink& sink) {
+
+    if (m_scaled) {
+        sink.value((ulonglong)scaled(from));
+
+    } else {
+        size_t len = 0;
+        const char* text = format(from, m_text, len);
+        sink.value(text, len);
+    }
+
+    return from + pack_length();
+}
+
+void Field_new_decimal::unpack_str(const char* from, unsigned long len) {
+
+    if (!m_scaled) {
+        field_data = std::string(from, len);
+        return;
+    }
+
+    // "-1234.50": the digits without the point are the scaled value
+    const char* const end = from + len;
+    const bool negative = (from < end && *from == '-');
+
+    ulonglong v = 0;
+    unsigned int frac = 0;
+    bool point = false;
+
+    for (const char* p = from + (negative ? 1 : 0); p < end; ++p) {
+
+        if (*p == '.') {
+            point = true;
+
+        } else if (*p >= '0' && *p <= '9') {
+            v = v * 10 + (*p - '0');
+            frac += point ? 1 : 0;
+        }
+    }
+
+    if (frac < m_scale)
+        v *= POW10_64[m_scale - frac];
+
+    field_data = negative ? (ulonglong)-(longlong)v : v;
+}
+
 Field_double::Field_double(const std::string& field_name_arg, const std::string& type):
     Field_real(field_name_arg, type) {}
 
@@ -122,6 +541,15 @@ const char* Field_double::unpack(const char* from) {
     return from + pack_length();
 }
 
+const char* Field_double::unpack_to(const char* from, Value_sink& sink) {
+    sink.value(*((double*)(from)));
+    return from + pack_length();
+}
+
+void Field_double::unpack_str(const char* from, unsigned long len) {
+    field_data = ::strtod(from, NULL);
+}
+
 
 Field_float::Field_float(const std::string& field_name_arg, const std::string& type):
     Field_real(field_name_arg, type) {}
@@ -136,6 +564,20 @@ const char* Field_float::unpack(const char* from) {
     return from + pack_length();
 }
 
+const char* Field_float::unpack_to(const char* from, Value_sink& sink) {
+    sink.value(*((float*)(from)));
+    return from + pack_length();
+}
+
+// FLOAT is printed with 6 digits; as a double it round-trips exactly.
+std::string Field_float::select_expr() const {
+    return quote_name(field_name) + " + 0e0";
+}
+
+void Field_float::unpack_str(const char* from, unsigned long len) {
+    field_data = (float)::strtod(from, NULL);
+}
+
 
 Field_str::Field_str(const std::string& field_name_arg, const std::string& type):
     Field(field_name_arg, type) {}
@@ -153,48 +595,301 @@ const char* Field_timestamp::unpack(const char* from) {
     return from + pack_length();
 }
 
+const char* Field_timestamp::unpack_to(const char* from, Value_sink& sink) {
+    sink.value((uint32)uint4korr(from));
+    return from + pack_length();
+}
+
+std::string Field_timestamp::select_expr() const {
+    return "UNIX_TIMESTAMP(" + quote_name(field_name) + ")";
+}
+
+void Field_timestamp::unpack_str(const char* from, unsigned long len) {
+    field_data = (uint32)::strtoul(from, NULL, 10);
+}
+
 Field_year::Field_year(const std::string& field_name_arg, const std::string& type):
     Field_tiny(field_name_arg, type) {}
 
+// Stored as the offset from 1900, 0 for the zero year.
+std::string Field_year::select_expr() const {
+    const std::string name = quote_name(field_name);
+    return "IF(" + name + ", " + name + " - 1900, 0)";
+}
+
 Field_datetime::Field_datetime(const std::string& field_name_arg, const std::string& type):
-    Field_str(field_name_arg, type) {}
+    Field_temporal(field_name_arg, type) {}
 
 const char* Field_datetime::unpack(const char* from) {
 
     ulonglong tmp = uint8korr(from);
-    field_data = tmp;
+    field_data = m_tz ? epoch(m_tz->datetime(tmp), 0) : tmp;
 
     LOG_TRACE(log, "  datetime: " << tmp << " // " << pack_length());
 
     return from + pack_length();
 }
 
+const char* Field_datetime::unpack_to(const char* from, Value_sink& sink) {
+
+    const ulonglong tmp = uint8korr(from);
+    sink.value(m_tz ? epoch(m_tz->datetime(tmp), 0) : tmp);
+
+    return from + pack_length();
+}
+
+std::string Field_datetime::select_expr() const {
+    return quote_name(field_name) + " + 0";
+}
+
+void Field_datetime::unpack_str(const char* from, unsigned long len) {
+
+    const ulonglong tmp = ::strtoull(from, NULL, 10);
+    field_data = m_tz ? epoch(m_tz->datetime(tmp), 0) : tmp;
+}
+
+Field_timestamp2::Field_timestamp2(const std::string& field_name_arg, const std::string& type):
+    Field_timestamp(field_name_arg, type), fsp(fractional_precision(type)), frac_usec(0) {}
+
+const char* Field_timestamp2::unpack(const char* from) {
+
+    uint32 tmp = (uint32)read_be(from, 4);
+    frac_usec = read_frac(from + 4, fsp);
+
+    field_data = tmp;
+
+    LOG_TRACE(log, "  timestamp2: " << tmp << "." << frac_usec << " // " << pack_length());
+
+    return from + pack_length();
+}
+
+// Not the parent's layout
+const char* Field_timestamp2::unpack_to(const char* from, Value_sink& sink) {
+    return Field::unpack_to(from, sink);
+}
+
+void Field_timestamp2::unpack_str(const char* from, unsigned long len) {
+    field_data = (uint32)::strtoul(from, NULL, 10);
+    frac_usec = str_frac(from, len);
+}
+
+Field_datetime2::Field_datetime2(const std::string& field_name_arg, const std::string& type):
+    Field_datetime(field_name_arg, type), fsp(fractional_precision(type)), frac_usec(0) {}
+
+const char* Field_datetime2::unpack(const char* from) {
+
+    // 1 bit sign (always set), 17 bits year*13+month, 5 bits day,
+    // 5 bits hour, 6 bits minute, 6 bits second.
+    const ulonglong packed = read_be(from, 5) & 0x7FFFFFFFFFULL;
+    frac_usec = read_frac(from + 5, fsp);
+
+    const ulonglong ymd = packed >> 17;
+    const ulonglong ym = ymd >> 5;
+    const ulonglong hms = packed & 0x1FFFF;
+
+    // The same YYYYMMDDhhmmss number as Field_datetime gives
+    ulonglong tmp = ((ym / 13) * 10000 + (ym % 13) * 100 + (ymd & 0x1F)) * 1000000ULL +
+        (hms >> 12) * 10000 + ((hms >> 6) & 0x3F) * 100 + (hms & 0x3F);
+
+    field_data = m_tz ? epoch(m_tz->datetime(tmp), frac_usec) : tmp;
+
+    LOG_TRACE(log, "  datetime2: " << tmp << "." << frac_usec << " // " << pack_length());
+
+    return from + pack_length();
+}
+
+// Not the parent's layout
+const char* Field_datetime2::unpack_to(const char* from, Value_sink& sink) {
+    return Field::unpack_to(from, sink);
+}
+
+void Field_datetime2::unpack_str(const char* from, unsigned long len) {
+
+    const ulonglong tmp = ::strtoull(from, NULL, 10);
+    frac_usec = str_frac(from, len);
+
+    field_data = m_tz ? epoch(m_tz->datetime(tmp), frac_usec) : tmp;
+}
+
+Field_time2::Field_time2(const std::string& field_name_arg, const std::string& type):
+    Field_time(field_name_arg, type), fsp(fractional_precision(type)), frac_usec(0) {}
+
+const char* Field_time2::unpack(const char* from) {
+
+    // Packed as (hms << 24) + microseconds, offset so that the stored value is unsigned.
+    // 1 bit sign, 1 bit unused, 10 bits hour, 6 bits minute, 6 bits second.
+    longlong packed;
+
+    switch (fsp) {
+    case 1:
+    case 2:
+    {
+        longlong intpart = (longlong)read_be(from, 3) - 0x800000LL;
+        longlong frac = (longlong)read_be(from + 3, 1);
+        if (intpart < 0 && frac) {
+            intpart++;
+            frac -= 0x100;
+        }
+        packed = (intpart << 24) + frac * 10000;
+        break;
+    }
+    case 3:
+    case 4:
+    {
+        longlong intpart = (longlong)read_be(from, 3) - 0x800000LL;
+        longlong frac = (longlong)read_be(from + 3, 2);
+        if (intpart < 0 && frac) {
+            intpart++;
+            frac -= 0x10000;
+        }
+        packed = (intpart << 24) + frac * 100;
+        break;
+    }
+    case 5:
+    case 6:
+        packed = (longlong)read_be(from, 6) - 0x800000000000LL;
+        break;
+    default:
+        packed = ((longlong)read_be(from, 3) - 0x800000LL) << 24;
+        break;
+    }
+
+    const bool negative = (packed < 0);
+
+    if (negative)
+        packed = -packed;
+
+    const longlong hms = packed >> 24;
+    frac_usec = (unsigned int)(packed & 0xFFFFFF);
+
+    int value = (int)(((hms >> 12) & 0x3FF) * 10000 + ((hms >> 6) & 0x3F) * 100 + (hms & 0x3F));
+
+    if (negative)
+        value = -value;
+
+    // The same signed HHMMSS number in 3 bytes as Field_time gives
+    const uint32 tmp = (uint32)value & 0xFFFFFF;
+
+    // The sign is of the whole value: -00:00:00.5 too
+    if (m_tz) {
+        const ulonglong v = epoch(time_seconds(negative ? -value : value), frac_usec);
+        field_data = negative ? -v : v;
+    } else {
+        field_data = tmp;
+    }
+
+    LOG_TRACE(log, "  time2: " << value << "." << frac_usec << " // " << pack_length());
+
+    return from + pack_length();
+}
+
+// Not the parent's layout
+const char* Field_time2::unpack_to(const char* from, Value_sink& sink) {
+    return Field::unpack_to(from, sink);
+}
+
+void Field_time2::unpack_str(const char* from, unsigned long len) {
+
+    const long value = ::strtol(from, NULL, 10);
+    frac_usec = str_frac(from, len);
+
+    if (m_tz) {
+        const bool negative = (*from == '-');
+        const ulonglong v = epoch(time_seconds(negative ? -value : value), frac_usec);
+        field_data = negative ? -v : v;
+    } else {
+        field_data = (uint32)value & 0xFFFFFF;
+    }
+}
+
 Field_date::Field_date(const std::string& field_name_arg, const std::string& type):
-    Field_str(field_name_arg, type) {}
+    Field_temporal(field_name_arg, type) {}
 
 const char* Field_date::unpack(const char* from) {
 
     uint32 tmp = uint3korr(from);
-    field_data = tmp;
+
+    if (m_tz)
+        field_data = epoch(m_tz->date(tmp), 0);
+    else
+        field_data = tmp;
 
     LOG_TRACE(log, "  date: " << tmp << " // " << pack_length());
 
     return from + pack_length();
 }
 
+const char* Field_date::unpack_to(const char* from, Value_sink& sink) {
+
+    const uint32 tmp = uint3korr(from);
+
+    if (m_tz)
+        sink.value(epoch(m_tz->date(tmp), 0));
+    else
+        sink.value(tmp);
+
+    return from + pack_length();
+}
+
+std::string Field_date::select_expr() const {
+    return quote_name(field_name) + " + 0";
+}
+
+void Field_date::unpack_str(const char* from, unsigned long len) {
+
+    // YYYYMMDD -> YYYY*512 + MM*32 + DD, as stored
+    const uint32 ymd = (uint32)::strtoul(from, NULL, 10);
+    const uint32 tmp = (ymd / 10000) * 512 + (ymd / 100 % 100) * 32 + ymd % 100;
+
+    if (m_tz)
+        field_data = epoch(m_tz->date(tmp), 0);
+    else
+        field_data = tmp;
+}
+
 Field_time::Field_time(const std::string& field_name_arg, const std::string& type):
-    Field_str(field_name_arg, type) {}
+    Field_temporal(field_name_arg, type) {}
 
 const char* Field_time::unpack(const char* from) {
 
     uint32 tmp = uint3korr(from);
-    field_data = tmp;
+
+    if (m_tz)
+        field_data = epoch(time_seconds(tmp), 0);
+    else
+        field_data = tmp;
 
     LOG_TRACE(log, "  time: " << tmp << " // " << pack_length());
 
     return from + pack_length();
 }
 
+const char* Field_time::unpack_to(const char* from, Value_sink& sink) {
+
+    const uint32 tmp = uint3korr(from);
+
+    if (m_tz)
+        sink.value(epoch(time_seconds(tmp), 0));
+    else
+        sink.value(tmp);
+
+    return from + pack_length();
+}
+
+std::string Field_time::select_expr() const {
+    return quote_name(field_name) + " + 0";
+}
+
+void Field_time::unpack_str(const char* from, unsigned long len) {
+    // Signed HHMMSS in 3 bytes, the same as uint3korr() gives
+    const uint32 tmp = (uint32)(::strtol(from, NULL, 10) & 0xFFFFFF);
+
+    if (m_tz)
+        field_data = epoch(time_seconds(tmp), 0);
+    else
+        field_data = tmp;
+}
+
 Field_enum::Field_enum(const std::string& field_name_arg, const std::string& type):
     Field_str(field_name_arg, type) {
 
@@ -227,6 +922,20 @@ const char* Field_enum::unpack(const char* from) {
     return from + pack_length();
 }
 
+const char* Field_enum::unpack_to(const char* from, Value_sink& sink) {
+    sink.value(pack_length() == 1 ? int(*from) : int(*((short*)(from))));
+    return from + pack_length();
+}
+
+// Index of the value, as stored
+std::string Field_enum::select_expr() const {
+    return quote_name(field_name) + " + 0";
+}
+
+void Field_enum::unpack_str(const char* from, unsigned long len) {
+    field_data = (int)::strtol(from, NULL, 10);
+}
+
 Field_set::Field_set(const std::string& field_name_arg, const std::string& type):
     Field_enum(field_name_arg, type) {
 
@@ -273,8 +982,17 @@ const char* Field_set::unpack(const char* from) {
     return from + pack_length();
 }
 
+// Not the parent's layout
+const char* Field_set::unpack_to(const char* from, Value_sink& sink) {
+    return Field::unpack_to(from, sink);
+}
+
+void Field_set::unpack_str(const char* from, unsigned long len) {
+    field_data = (ulonglong)::strtoull(from, NULL, 10);
+}
+
 Field_longstr::Field_longstr(const std::string& field_name_arg, const std::string& type):
-    Field_str(field_name_arg, type)  {}
+    Field_str(field_name_arg, type), m_transcoder(NULL)  {}
 
 const char* Field_longstr::unpack(const char* from) {
 
@@ -286,7 +1004,10 @@ const char* Field_longstr::unpack(const char* from) {
     	length_row = (unsigned int) (unsigned char) *from++;
     }
 
-    std::string tmp(from, length_row);
+    size_t len = length_row;
+    const char* data = transcode(from, len);
+
+    std::string tmp(data, len);
 
     field_data = tmp;
 
@@ -295,6 +1016,34 @@ const char* Field_longstr::unpack(const char* from) {
     return from + length_row;
 }
 
+const char* Field_longstr::unpack_to(const char* from, Value_sink& sink) {
+
+    const unsigned int len = field_length > 255 ? uint2korr(from) : (unsigned char)*from;
+    from += field_length > 255 ? 2 : 1;
+
+    size_t out_len = len;
+    const char* data = transcode(from, out_len);
+
+    sink.value(data, out_len);
+    return from + len;
+}
+
+const char* Field_longstr::skip(const char* from) const {
+
+    if (field_length > 255)
+        return from + 2 + uint2korr(from);
+
+    return from + 1 + (unsigned char)*from;
+}
+
+void Field_longstr::unpack_str(const char* from, unsigned long len) {
+
+    size_t out_len = len;
+    const char* data = transcode(from, out_len);
+
+    field_data = std::string(data, out_len);
+}
+
 Field_string::Field_string(const std::string& field_name_arg, const std::string& type):
     Field_longstr(field_name_arg, type) {
 
@@ -351,7 +1100,10 @@ const char* Field_varstring::unpack(const char* from) {
     	from++;
     }
 
-    std::string tmp(from, length_row);
+    size_t len = length_row;
+    const char* data = transcode(from, len);
+
+    std::string tmp(data, len);
 
     field_data = tmp;
 
@@ -360,10 +1112,64 @@ const char* Field_varstring::unpack(const char* from) {
     return from + length_row;
 }
 
+const char* Field_varstring::unpack_to(const char* from, Value_sink& sink) {
+
+    const unsigned int len = length_bytes == 1 ? (unsigned char)*from : uint2korr(from);
+    from += length_bytes;
+
+    size_t out_len = len;
+    const char* data = transcode(from, out_len);
+
+    sink.value(data, out_len);
+    return from + len;
+}
+
+const char* Field_varstring::skip(const char* from) const {
+
+    if (length_bytes == 1)
+        return from + 1 + (unsigned char)*from;
+
+    return from + 2 + uint2korr(from);
+}
+
 
 Field_blob::Field_blob(const std::string& field_name_arg, const std::string& type):
     Field_longstr(field_name_arg, type), packlength(2) {}
 
+Field_json::Field_json(const std::string& field_name_arg, const std::string& type):
+    Field_blob(field_name_arg, type) { packlength = 4; }
+
+Field_bit::Field_bit(const std::string& field_name_arg, const std::string& type):
+    Field_num(field_name_arg, type), bits(type_length(type)) {
+
+    if (bits == 0 || bits > 64)
+        throw std::runtime_error("Field_bit: Incorrect field BIT");
+}
+
+const char* Field_bit::unpack(const char* from) {
+
+    // Stored big-endian
+    ulonglong tmp = read_be(from, pack_length());
+    field_data = tmp;
+
+    LOG_TRACE(log, "  bit: " << tmp << " // " << pack_length());
+
+    return from + pack_length();
+}
+
+const char* Field_bit::unpack_to(const char* from, Value_sink& sink) {
+    sink.value(read_be(from, pack_length()));
+    return from + pack_length();
+}
+
+std::string Field_bit::select_expr() const {
+    return quote_name(field_name) + " + 0";
+}
+
+void Field_bit::unpack_str(const char* from, unsigned long len) {
+    field_data = (ulonglong)::strtoull(from, NULL, 10);
+}
+
 Field_tinyblob::Field_tinyblob(const std::string& field_name_arg, const std::string& type):
     Field_blob(field_name_arg, type) { packlength = 1; }
 
@@ -378,7 +1184,10 @@ const char* Field_blob::unpack(const char* from) {
     length_row = get_length(from); 
     from += packlength; 
 
-    std::string tmp(from, length_row);
+    size_t len = length_row;
+    const char* data = transcode(from, len);
+
+    std::string tmp(data, len);
 
     field_data = tmp;
 
@@ -387,8 +1196,24 @@ const char* Field_blob::unpack(const char* from) {
     return from + length_row;
 }
 
+const char* Field_blob::unpack_to(const char* from, Value_sink& sink) {
+
+    const unsigned int len = get_length(from);
+    from += packlength;
+
+    size_t out_len = len;
+    const char* data = transcode(from, out_len);
+
+    sink.value(data, out_len);
+    return from + len;
+}
+
+const char* Field_blob::skip(const char* from) const {
+    return from + packlength + get_length(from);
+}
+
 
-unsigned int Field_blob::get_length(const char *pos) {
+unsigned int Field_blob::get_length(const char *pos) const {
 
     switch (packlength)
     {
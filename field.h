@@ -22,7 +22,9 @@
 
 #include <boost/any.hpp>
 
+#include "charset.h"
 #include "collate.h"
+#include "temporal.h"
 
 #ifdef test
 #undef test
@@ -32,6 +34,25 @@ namespace slave
 {
 
 
+// Receives decoded values, see Field::unpack_to(). A field always gives values of one
+// type, the one its kind() tells and its unpack() puts into field_data.
+class Value_sink {
+public:
+    virtual ~Value_sink() {}
+
+    virtual void value(char v) = 0;
+    virtual void value(unsigned short v) = 0;
+    virtual void value(int v) = 0;
+    virtual void value(unsigned int v) = 0;
+    virtual void value(unsigned long long v) = 0;
+    virtual void value(float v) = 0;
+    virtual void value(double v) = 0;
+
+    // Points into the event, valid during the call only
+    virtual void value(const char* data, size_t len) = 0;
+};
+
+
 class Field {
 
 public:	
@@ -45,6 +66,25 @@ public:
 	
     virtual const char* unpack(const char *from) = 0;
 
+    // For Slave::snapshot(): what to SELECT for this column, and unpacking of the
+    // resulting text into the same field_data unpack() gives from the binlog.
+    virtual std::string select_expr() const;
+    virtual void unpack_str(const char* from, unsigned long len) = 0;
+
+    // Type of the values, as in field_data
+    enum Value_kind { KIND_CHAR, KIND_USHORT, KIND_INT, KIND_UINT, KIND_ULONGLONG, KIND_FLOAT, KIND_DOUBLE, KIND_STRING };
+
+    virtual Value_kind kind() const = 0;
+
+    // Gives the value straight to 'sink', field_data is not touched. By default it goes through
+    // unpack(); the common types decode directly, strings without a copy.
+    virtual const char* unpack_to(const char* from, Value_sink& sink);
+
+    // End of the value, without decoding it
+    virtual const char* skip(const char* from) const {
+        return from + pack_length();
+    }
+
     Field(const std::string& field_name_arg, const std::string& type) :
         field_type(type), 
         field_name(field_name_arg), 
@@ -96,9 +136,24 @@ public:
     Field_longstr(const std::string& field_name_arg, const std::string& type);
 
     const char* unpack(const char* from);
+    void unpack_str(const char* from, unsigned long len);
+    const char* unpack_to(const char* from, Value_sink& sink);
+    const char* skip(const char* from) const;
+    Value_kind kind() const { return KIND_STRING; }
+
+    // Values are given as UTF-8 through it; NULL gives them as they are in the event.
+    void setTranscoder(const Transcoder* transcoder) { m_transcoder = transcoder; }
 
 protected:
     unsigned int length_row;
+
+    // The value to give out: the bytes at 'from', or what the transcoder made of them
+    const char* transcode(const char* from, size_t& len) {
+        return m_transcoder ? m_transcoder->convert(from, len, m_transcoded) : from;
+    }
+
+    const Transcoder* m_transcoder;
+    std::string m_transcoded;
 };
 
 
@@ -112,7 +167,56 @@ public:
     Field_decimal(const std::string& field_name_arg, const std::string& type);	
 };
 
+/*
+ * DECIMAL as MySQL 5.0+ stores it: the digits in groups of 9 per 4 bytes, big-endian, the
+ * leftover digits of the integer and the fractional part in as few bytes as they need,
+ * the sign in the top bit and all the bits inverted for negative values.
+ * Values are given as the text MySQL prints, "-1234.50", or after setScaled(), as the
+ * number times 10^scale: a signed number in unsigned long long, never through a double.
+ */
 class Field_new_decimal: public Field_num {
+    unsigned int pack_length() const { return m_bytes; }
+public:
+    Field_new_decimal(const std::string& field_name_arg, const std::string& type);
+
+    const char* unpack(const char* from);
+    void unpack_str(const char* from, unsigned long len);
+    const char* unpack_to(const char* from, Value_sink& sink);
+    Value_kind kind() const { return m_scaled ? KIND_ULONGLONG : KIND_STRING; }
+
+    // Only up to 18 digits fit into 64 bits: false, and still text, for the wider columns
+    bool setScaled(bool scaled);
+
+    bool isScaled() const { return m_scaled; }
+
+    unsigned int precision() const { return m_precision; }
+    unsigned int scale() const { return m_scale; }
+
+    // Enough for 65 digits, the sign and the point
+    static const size_t MAX_TEXT = 68;
+
+private:
+    static const unsigned int MAX_GROUPS = 16;
+
+    // The digit groups of the value at 'from', most significant first. True if it is negative.
+    bool read_groups(const char* from, unsigned int* groups) const;
+
+    // Into buf[MAX_TEXT]; returns where the text starts, with its length in 'len'
+    const char* format(const char* from, char* buf, size_t& len) const;
+    long long scaled(const char* from) const;
+
+    unsigned int m_precision;
+    unsigned int m_scale;
+    unsigned int m_bytes;
+
+    // Bytes and digits of each group; the first m_int_groups are of the integer part
+    unsigned int m_groups;
+    unsigned int m_int_groups;
+    unsigned char m_group_bytes[MAX_GROUPS];
+    unsigned char m_group_digits[MAX_GROUPS];
+
+    bool m_scaled;
+    char m_text[MAX_TEXT];
 };
 
 class Field_tiny: public Field_num {
@@ -120,6 +224,9 @@ class Field_tiny: public Field_num {
 public:
     Field_tiny(const std::string& field_name_arg, const std::string& type);
     const char* unpack(const char* from);
+    void unpack_str(const char* from, unsigned long len);
+    const char* unpack_to(const char* from, Value_sink& sink);
+    Value_kind kind() const { return KIND_CHAR; }
 };
 
 class Field_short: public Field_num {
@@ -128,6 +235,9 @@ public:
     Field_short(const std::string& field_name_arg, const std::string& type);
 
     const char* unpack(const char* from);
+    void unpack_str(const char* from, unsigned long len);
+    const char* unpack_to(const char* from, Value_sink& sink);
+    Value_kind kind() const { return KIND_USHORT; }
 };
 
 class Field_medium: public Field_num {
@@ -136,6 +246,9 @@ public:
     Field_medium(const std::string& field_name_arg, const std::string& type);
 	
     const char* unpack(const char* from);
+    void unpack_str(const char* from, unsigned long len);
+    const char* unpack_to(const char* from, Value_sink& sink);
+    Value_kind kind() const { return KIND_UINT; }
 };
 
 class Field_long: public Field_num {
@@ -144,6 +257,9 @@ public:
     Field_long(const std::string& field_name_arg, const std::string& type);
 	
     const char* unpack(const char* from);
+    void unpack_str(const char* from, unsigned long len);
+    const char* unpack_to(const char* from, Value_sink& sink);
+    Value_kind kind() const { return KIND_UINT; }
 };
 
 class Field_longlong: public Field_num {
@@ -152,6 +268,9 @@ public:
     Field_longlong(const std::string& field_name_arg, const std::string& type);
 	
     const char* unpack(const char* from);
+    void unpack_str(const char* from, unsigned long len);
+    const char* unpack_to(const char* from, Value_sink& sink);
+    Value_kind kind() const { return KIND_ULONGLONG; }
 };
 
 class Field_float: public Field_real {
@@ -160,6 +279,10 @@ public:
     Field_float(const std::string& field_name_arg, const std::string& type);
 	
     const char* unpack(const char* from);
+    void unpack_str(const char* from, unsigned long len);
+    const char* unpack_to(const char* from, Value_sink& sink);
+    Value_kind kind() const { return KIND_FLOAT; }
+    std::string select_expr() const;
 };
 
 class Field_double: public Field_real {
@@ -168,52 +291,153 @@ public:
     Field_double(const std::string& field_name_arg, const std::string& type);
 	
     const char* unpack(const char* from);
+    void unpack_str(const char* from, unsigned long len);
+    const char* unpack_to(const char* from, Value_sink& sink);
+    Value_kind kind() const { return KIND_DOUBLE; }
 };
 
 class Field_null: public Field_str {
     unsigned int pack_length() const { return 0; }
 };
 
+/*
+ * DATE, TIME and DATETIME give their packed MySQL values, or, after setEpoch(), seconds
+ * (microseconds) since the epoch in the time zone; for TIME, its length. The latter are
+ * signed numbers in unsigned long long, 0 for the zero date. TIMESTAMP is always seconds
+ * since the epoch. Packed TIME is signed HHMMSS in the low 24 bits, as the old storage has it,
+ * whichever storage the column has.
+ */
+class Field_temporal: public Field_str {
+public:
+    Field_temporal(const std::string& field_name_arg, const std::string& type) :
+        Field_str(field_name_arg, type), m_tz(NULL), m_usec(false) {}
+
+    // NULL gives the packed values again
+    void setEpoch(const TimeZone* tz, bool usec) { m_tz = tz; m_usec = usec; }
+
+    bool isEpoch() const { return m_tz != NULL; }
+
+    // The same epoch settings as 'other' has, for a field made anew for the same column
+    void copyEpoch(const Field_temporal& other) { m_tz = other.m_tz; m_usec = other.m_usec; }
+
+protected:
+    unsigned long long epoch(long long seconds, unsigned int usec) const {
+
+        if (!m_usec)
+            return (unsigned long long)seconds;
+
+        // The fraction is after the second, before the epoch too
+        return (unsigned long long)(seconds * 1000000 + usec);
+    }
+
+    const TimeZone* m_tz;
+    bool m_usec;
+};
+
 class Field_timestamp: public Field_str {
     unsigned int pack_length() const { return 4; }
 public:
     Field_timestamp(const std::string& field_name_arg, const std::string& type);
 	
     const char* unpack(const char* from);
+    void unpack_str(const char* from, unsigned long len);
+    const char* unpack_to(const char* from, Value_sink& sink);
+    Value_kind kind() const { return KIND_UINT; }
+    std::string select_expr() const;
 };
 
 class Field_year: public Field_tiny {
 public:
     Field_year(const std::string& field_name_arg, const std::string& type);	
+
+    std::string select_expr() const;
 };
 
-class Field_date: public Field_str {
+class Field_date: public Field_temporal {
     unsigned int pack_length() const { return 3; }
 public:
     Field_date(const std::string& field_name_arg, const std::string& type);	
 	
     const char* unpack(const char* from);
+    void unpack_str(const char* from, unsigned long len);
+    const char* unpack_to(const char* from, Value_sink& sink);
+    Value_kind kind() const { return m_tz ? KIND_ULONGLONG : KIND_UINT; }
+    std::string select_expr() const;
 };
 
 class Field_newdate: public Field_str {
     unsigned int pack_length() const { return 3; } 	
 };
 
-class Field_time: public Field_str {
+class Field_time: public Field_temporal {
     unsigned int pack_length() const { return 3; }
 public:
 	
     Field_time(const std::string& field_name_arg, const std::string& type);	
 	
     const char* unpack(const char* from);
+    void unpack_str(const char* from, unsigned long len);
+    const char* unpack_to(const char* from, Value_sink& sink);
+    Value_kind kind() const { return m_tz ? KIND_ULONGLONG : KIND_UINT; }
+    std::string select_expr() const;
 };
 
-class Field_datetime: public Field_str {
+class Field_datetime: public Field_temporal {
     unsigned int pack_length() const { return 8; }
 public:
     Field_datetime(const std::string& field_name_arg, const std::string& type);	
 
     const char* unpack(const char* from);
+    void unpack_str(const char* from, unsigned long len);
+    const char* unpack_to(const char* from, Value_sink& sink);
+    Value_kind kind() const { return KIND_ULONGLONG; }
+    std::string select_expr() const;
+};
+
+/*
+ * MySQL 5.6.4+ storage of the temporal types, with optional fractional seconds.
+ * They give the same values as the old ones (so that the callbacks need not care
+ * which storage the master uses); the fraction is kept in frac_usec.
+ */
+
+class Field_timestamp2: public Field_timestamp {
+    unsigned int pack_length() const { return 4 + (fsp + 1) / 2; }
+public:
+    Field_timestamp2(const std::string& field_name_arg, const std::string& type);
+
+    const char* unpack(const char* from);
+    void unpack_str(const char* from, unsigned long len);
+    const char* unpack_to(const char* from, Value_sink& sink);
+
+    // Number of fractional digits, 0..6
+    unsigned int fsp;
+    unsigned int frac_usec;
+};
+
+class Field_datetime2: public Field_datetime {
+    unsigned int pack_length() const { return 5 + (fsp + 1) / 2; }
+public:
+    Field_datetime2(const std::string& field_name_arg, const std::string& type);
+
+    const char* unpack(const char* from);
+    void unpack_str(const char* from, unsigned long len);
+    const char* unpack_to(const char* from, Value_sink& sink);
+
+    unsigned int fsp;
+    unsigned int frac_usec;
+};
+
+class Field_time2: public Field_time {
+    unsigned int pack_length() const { return 3 + (fsp + 1) / 2; }
+public:
+    Field_time2(const std::string& field_name_arg, const std::string& type);
+
+    const char* unpack(const char* from);
+    void unpack_str(const char* from, unsigned long len);
+    const char* unpack_to(const char* from, Value_sink& sink);
+
+    unsigned int fsp;
+    unsigned int frac_usec;
 };
 
 class Field_string: public Field_longstr {
@@ -233,14 +457,18 @@ public:
                     const collate_info& collate);
 	
     const char* unpack(const char* from);
+    const char* unpack_to(const char* from, Value_sink& sink);
+    const char* skip(const char* from) const;
 };
 
 class Field_blob: public Field_longstr {
-    unsigned int get_length(const char *ptr);
+    unsigned int get_length(const char *ptr) const;
 public:	
     Field_blob(const std::string& field_name_arg, const std::string& type);
 
     const char* unpack(const char* from);
+    const char* unpack_to(const char* from, Value_sink& sink);
+    const char* skip(const char* from) const;
 
 protected:
     // Number of bytes for holding the data length
@@ -264,6 +492,27 @@ public:
 
 class Field_geom: public Field_blob { };
 
+// MySQL 5.7 JSON. The value is the binary JSON representation, as stored by the server.
+class Field_json: public Field_blob {
+public:
+    Field_json(const std::string& field_name_arg, const std::string& type);
+};
+
+class Field_bit: public Field_num {
+    unsigned int pack_length() const { return (bits + 7) / 8; }
+public:
+    Field_bit(const std::string& field_name_arg, const std::string& type);
+
+    const char* unpack(const char* from);
+    void unpack_str(const char* from, unsigned long len);
+    const char* unpack_to(const char* from, Value_sink& sink);
+    Value_kind kind() const { return KIND_ULONGLONG; }
+    std::string select_expr() const;
+
+protected:
+    unsigned int bits;
+};
+
 class Field_enum: public Field_str {
 
     unsigned int pack_length() const {
@@ -275,6 +524,10 @@ public:
 
 	
     const char* unpack(const char* from);
+    void unpack_str(const char* from, unsigned long len);
+    const char* unpack_to(const char* from, Value_sink& sink);
+    Value_kind kind() const { return KIND_INT; }
+    std::string select_expr() const;
 
 protected:
     unsigned int packlength;
@@ -295,6 +548,9 @@ public:
     Field_set(const std::string& field_name_arg, const std::string& type);
 
     const char* unpack(const char* from);
+    void unpack_str(const char* from, unsigned long len);
+    const char* unpack_to(const char* from, Value_sink& sink);
+    Value_kind kind() const { return KIND_ULONGLONG; }
 };
 
 }
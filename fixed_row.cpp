@@ -0,0 +1,184 @@
+/* Copyright 2011 ZAO "Begun".
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3 of the License, or (at your option)
+ * any later version.
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+
+#include "fixed_row.h"
+
+
+namespace slave
+{
+
+boost::shared_ptr<FixedLayout> FixedLayout::make(const std::vector<boost::shared_ptr<Field> >& fields) {
+
+    boost::shared_ptr<FixedLayout> layout(new FixedLayout);
+
+    layout->m_width = 0;
+    layout->m_null_bytes = (fields.size() + 7) / 8;
+
+    for (std::vector<boost::shared_ptr<Field> >::const_iterator i = fields.begin(); i != fields.end(); ++i) {
+
+        const Field* field = i->get();
+
+        Column column;
+        column.offset = layout->m_width;
+        column.width = field->pack_length();
+        column.bytes = column.width;
+        column.big_endian = false;
+        column.is_signed = field->field_type.find("unsigned") == std::string::npos;
+
+        // Seconds, then the fraction
+        if (dynamic_cast<const Field_timestamp2*>(field)) {
+            column.bytes = 4;
+            column.big_endian = true;
+            column.is_signed = false;
+
+        } else if (dynamic_cast<const Field_timestamp*>(field) || dynamic_cast<const Field_year*>(field)) {
+            column.is_signed = false;
+
+        } else if (!dynamic_cast<const Field_tiny*>(field) && !dynamic_cast<const Field_short*>(field) &&
+                   !dynamic_cast<const Field_medium*>(field) && !dynamic_cast<const Field_long*>(field) &&
+                   !dynamic_cast<const Field_longlong*>(field)) {
+
+            return boost::shared_ptr<FixedLayout>();
+        }
+
+        layout->m_columns.push_back(column);
+        layout->m_width += column.width;
+    }
+
+    return layout;
+}
+
+
+bool FixedLayout::isFull(const std::vector<unsigned char>& cols) const {
+
+    const size_t count = m_columns.size();
+
+    if (cols.size() < (count + 7) / 8)
+        return false;
+
+    for (size_t i = 0; i < count / 8; ++i) {
+        if (cols[i] != 0xff)
+            return false;
+    }
+
+    const unsigned char last = (1 << (count & 7)) - 1;
+
+    return last == 0 || (cols[count / 8] & last) == last;
+}
+
+
+inline long long FixedLayout::read(const unsigned char* p, const Column& column) {
+
+    unsigned long long v = 0;
+
+    if (column.big_endian) {
+        for (unsigned int i = 0; i < column.bytes; ++i)
+            v = (v << 8) | p[i];
+
+    } else {
+        for (unsigned int i = column.bytes; i > 0; --i)
+            v = (v << 8) | p[i - 1];
+    }
+
+    if (column.is_signed && column.bytes < 8) {
+        const unsigned int shift = 64 - column.bytes * 8;
+        return (long long)(v << shift) >> shift;
+    }
+
+    return (long long)v;
+}
+
+
+const unsigned char* FixedLayout::decode(const unsigned char* row, const unsigned char* end,
+                                         const std::vector<unsigned char>& cols, bool full,
+                                         long long* values, unsigned char* nulls, bool& has_nulls) const {
+
+    const size_t count = m_columns.size();
+
+    if (full) {
+
+        const unsigned char* data = row + m_null_bytes;
+
+        if (data > end)
+            return NULL;
+
+        bool no_nulls = true;
+
+        for (unsigned int i = 0; i < m_null_bytes; ++i) {
+            if (row[i] != 0)
+                no_nulls = false;
+        }
+
+        if (no_nulls) {
+
+            if ((size_t)(end - data) < m_width)
+                return NULL;
+
+            for (size_t i = 0; i < count; ++i)
+                values[i] = read(data + m_columns[i].offset, m_columns[i]);
+
+            has_nulls = false;
+            return data + m_width;
+        }
+    }
+
+    // Some columns are missing or NULL: the offsets move
+    ::memset(nulls, 0, (count + 7) / 8);
+    has_nulls = false;
+
+    size_t present = 0;
+
+    for (size_t i = 0; i < count; ++i) {
+        if (cols[i / 8] & (1 << (i & 7)))
+            ++present;
+    }
+
+    const unsigned char* null_ptr = row;
+    const unsigned char* ptr = row + (present + 7) / 8;
+
+    if (ptr > end)
+        return NULL;
+
+    unsigned int null_bit = 0;
+
+    for (size_t i = 0; i < count; ++i) {
+
+        values[i] = 0;
+
+        bool is_null = !(cols[i / 8] & (1 << (i & 7)));
+
+        if (!is_null) {
+            is_null = null_ptr[null_bit / 8] & (1 << (null_bit & 7));
+            ++null_bit;
+        }
+
+        if (is_null) {
+            nulls[i / 8] |= (1 << (i & 7));
+            has_nulls = true;
+            continue;
+        }
+
+        if ((size_t)(end - ptr) < m_columns[i].width)
+            return NULL;
+
+        values[i] = read(ptr, m_columns[i]);
+        ptr += m_columns[i].width;
+    }
+
+    return ptr;
+}
+
+}// slave
@@ -0,0 +1,111 @@
+/* Copyright 2011 ZAO "Begun".
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3 of the License, or (at your option)
+ * any later version.
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __SLAVE_FIXED_ROW_H_
+#define __SLAVE_FIXED_ROW_H_
+
+#include <time.h>
+
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "field.h"
+#include "recordset.h"
+
+
+namespace slave
+{
+
+// A row of a table whose columns are all integers and timestamps, see Slave::setFixedCallback().
+// Values are in the column order, sign extended for signed columns; a struct of long long
+// members in the same order can be laid over them.
+struct FixedRow {
+
+    RecordSet::TypeEvent type_event;
+    time_t when;
+    unsigned int master_id;
+
+    size_t count;
+
+    // Write: the new row, Delete: the deleted one, Update: the row after it
+    const long long* values;
+
+    // The row before an update; NULL for the others
+    const long long* old_values;
+
+    // A bit per column: NULL, or not in the row image. NULL pointer if there are none.
+    const unsigned char* nulls;
+    const unsigned char* old_nulls;
+
+    bool isNull(size_t i) const {
+        return nulls && (nulls[i / 8] & (1 << (i & 7)));
+    }
+
+    bool isOldNull(size_t i) const {
+        return old_nulls && (old_nulls[i / 8] & (1 << (i & 7)));
+    }
+};
+
+typedef boost::function<void (const FixedRow&)> fixed_callback;
+
+
+// Where every value of a fixed-width row image is. A row with all the columns and
+// no NULLs is decoded with a single bounds check.
+class FixedLayout {
+public:
+
+    // NULL if some of the fields are not fixed-width integers or timestamps
+    static boost::shared_ptr<FixedLayout> make(const std::vector<boost::shared_ptr<Field> >& fields);
+
+    size_t count() const { return m_columns.size(); }
+
+    // Does the image have all the columns?
+    bool isFull(const std::vector<unsigned char>& cols) const;
+
+    // Decodes the image at 'row' into values[count()], and the NULL bits into nulls[(count() + 7) / 8].
+    // Returns the end of the image, NULL if it goes past 'end'. 'has_nulls' is false if nulls is all 0.
+    const unsigned char* decode(const unsigned char* row, const unsigned char* end,
+                                const std::vector<unsigned char>& cols, bool full,
+                                long long* values, unsigned char* nulls, bool& has_nulls) const;
+
+private:
+
+    struct Column {
+
+        // Of the value in a full image without NULLs
+        unsigned int offset;
+
+        // Bytes in the image, and of them the integer value
+        unsigned char width;
+        unsigned char bytes;
+
+        bool big_endian;
+        bool is_signed;
+    };
+
+    static long long read(const unsigned char* p, const Column& column);
+
+    std::vector<Column> m_columns;
+
+    // Of a full image without NULLs, after the null bitmap
+    unsigned int m_width;
+    unsigned int m_null_bytes;
+};
+
+}// slave
+
+#endif
@@ -0,0 +1,243 @@
+/* Copyright 2011 ZAO "Begun".
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3 of the License, or (at your option)
+ * any later version.
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <algorithm>
+#include <stdexcept>
+
+#include "gtid.h"
+
+
+namespace
+{
+
+const size_t SID_LEN = 16;
+
+int hex_value(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+void put_int8(std::string& out, unsigned long long v)
+{
+    for (int i = 0; i < 8; ++i) {
+        out += (char)(v & 0xFF);
+        v >>= 8;
+    }
+}
+
+std::string trim(const std::string& s)
+{
+    const char* ws = " \t\r\n";
+    const std::string::size_type b = s.find_first_not_of(ws);
+    if (b == std::string::npos)
+        return std::string();
+    return s.substr(b, s.find_last_not_of(ws) - b + 1);
+}
+
+long long parse_gno(const std::string& s, const std::string& text)
+{
+    char* end = NULL;
+    const long long n = ::strtoll(s.c_str(), &end, 10);
+    if (s.empty() || *end != '\0' || n <= 0)
+        throw std::runtime_error("GtidSet: bad transaction number in '" + text + "'");
+    return n;
+}
+
+}// anonymous-namespace
+
+
+namespace slave
+{
+
+GtidSet::GtidSet(const std::string& text)
+{
+    std::string::size_type pos = 0;
+
+    while (pos <= text.size()) {
+
+        std::string::size_type comma = text.find(',', pos);
+        if (comma == std::string::npos)
+            comma = text.size();
+
+        const std::string item = trim(text.substr(pos, comma - pos));
+        pos = comma + 1;
+
+        if (item.empty())
+            continue;
+
+        std::string::size_type colon = item.find(':');
+        if (colon == std::string::npos)
+            throw std::runtime_error("GtidSet: no intervals in '" + text + "'");
+
+        const std::string sid = parseUuid(item.substr(0, colon));
+
+        while (colon != std::string::npos) {
+
+            const std::string::size_type next = item.find(':', colon + 1);
+            const std::string range = item.substr(colon + 1, next == std::string::npos ? std::string::npos : next - colon - 1);
+            colon = next;
+
+            const std::string::size_type dash = range.find('-');
+            const long long first = parse_gno(range.substr(0, dash), text);
+            const long long last = dash == std::string::npos ? first : parse_gno(range.substr(dash + 1), text);
+
+            if (last < first)
+                throw std::runtime_error("GtidSet: bad interval in '" + text + "'");
+
+            addInterval(sid, first, last);
+        }
+    }
+}
+
+void GtidSet::add(const std::string& sid, long long gno)
+{
+    intervals_t& iv = m_sets[sid];
+
+    // Transactions mostly come in order: just extend the last interval.
+    if (!iv.empty() && iv.back().second + 1 == gno) {
+        iv.back().second = gno;
+        return;
+    }
+
+    addInterval(sid, gno, gno);
+}
+
+void GtidSet::addInterval(const std::string& sid, long long first, long long last)
+{
+    intervals_t& iv = m_sets[sid];
+
+    intervals_t::iterator i = std::lower_bound(iv.begin(), iv.end(), interval_t(first, last));
+    i = iv.insert(i, interval_t(first, last));
+
+    // Merge with the previous interval, then swallow the following ones.
+    if (i != iv.begin() && (i - 1)->second + 1 >= i->first) {
+        (i - 1)->second = std::max((i - 1)->second, i->second);
+        i = iv.erase(i) - 1;
+    }
+
+    intervals_t::iterator j = i + 1;
+    while (j != iv.end() && i->second + 1 >= j->first) {
+        i->second = std::max(i->second, j->second);
+        ++j;
+    }
+    iv.erase(i + 1, j);
+}
+
+bool GtidSet::contains(const std::string& sid, long long gno) const
+{
+    sets_t::const_iterator s = m_sets.find(sid);
+    if (s == m_sets.end())
+        return false;
+
+    // The first interval starting after gno; the one before it is the only candidate.
+    const intervals_t& iv = s->second;
+    intervals_t::const_iterator i = std::upper_bound(iv.begin(), iv.end(), interval_t(gno, LLONG_MAX));
+    if (i == iv.begin())
+        return false;
+    --i;
+    return gno <= i->second;
+}
+
+std::string GtidSet::str() const
+{
+    std::string ret;
+
+    for (sets_t::const_iterator s = m_sets.begin(); s != m_sets.end(); ++s) {
+
+        if (!ret.empty())
+            ret += ',';
+
+        ret += formatUuid(s->first);
+
+        for (intervals_t::const_iterator i = s->second.begin(); i != s->second.end(); ++i) {
+            char buf[64];
+            if (i->first == i->second)
+                ::snprintf(buf, sizeof(buf), ":%lld", i->first);
+            else
+                ::snprintf(buf, sizeof(buf), ":%lld-%lld", i->first, i->second);
+            ret += buf;
+        }
+    }
+
+    return ret;
+}
+
+std::string GtidSet::encode() const
+{
+    std::string ret;
+
+    put_int8(ret, m_sets.size());
+
+    for (sets_t::const_iterator s = m_sets.begin(); s != m_sets.end(); ++s) {
+
+        ret += s->first;
+        put_int8(ret, s->second.size());
+
+        // On the wire the interval end is exclusive.
+        for (intervals_t::const_iterator i = s->second.begin(); i != s->second.end(); ++i) {
+            put_int8(ret, i->first);
+            put_int8(ret, i->second + 1);
+        }
+    }
+
+    return ret;
+}
+
+std::string GtidSet::parseUuid(const std::string& uuid)
+{
+    std::string ret;
+
+    for (std::string::size_type i = 0; i < uuid.size(); ++i) {
+
+        if (uuid[i] == '-')
+            continue;
+
+        const int hi = hex_value(uuid[i]);
+        const int lo = i + 1 < uuid.size() ? hex_value(uuid[i + 1]) : -1;
+        if (hi < 0 || lo < 0)
+            throw std::runtime_error("GtidSet: bad uuid '" + uuid + "'");
+
+        ret += (char)((hi << 4) | lo);
+        ++i;
+    }
+
+    if (ret.size() != SID_LEN)
+        throw std::runtime_error("GtidSet: bad uuid '" + uuid + "'");
+
+    return ret;
+}
+
+std::string GtidSet::formatUuid(const std::string& sid)
+{
+    static const char digits[] = "0123456789abcdef";
+
+    std::string ret;
+
+    for (std::string::size_type i = 0; i < sid.size(); ++i) {
+        if (i == 4 || i == 6 || i == 8 || i == 10)
+            ret += '-';
+        ret += digits[((unsigned char)sid[i]) >> 4];
+        ret += digits[((unsigned char)sid[i]) & 0x0F];
+    }
+
+    return ret;
+}
+
+}// slave
@@ -0,0 +1,76 @@
+/* Copyright 2011 ZAO "Begun".
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3 of the License, or (at your option)
+ * any later version.
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __SLAVE_GTID_H_
+#define __SLAVE_GTID_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace slave
+{
+
+// Set of GTIDs, like @@gtid_executed: for every source server uuid, a sorted list
+// of disjoint intervals of transaction numbers.
+class GtidSet
+{
+public:
+
+    // [first, last], both inclusive, as in the text form "uuid:first-last"
+    typedef std::pair<long long, long long> interval_t;
+    typedef std::vector<interval_t> intervals_t;
+
+    // Key is the binary (16 bytes) server uuid
+    typedef std::map<std::string, intervals_t> sets_t;
+
+    GtidSet() {}
+
+    // Parses the text form, "3e11fa47-71ca-11e1-9e33-c80aa9429562:1-5:7,...".
+    // Throws std::runtime_error on malformed input.
+    explicit GtidSet(const std::string& text);
+
+    // sid is the binary uuid, 16 bytes
+    void add(const std::string& sid, long long gno);
+
+    bool contains(const std::string& sid, long long gno) const;
+
+    bool empty() const { return m_sets.empty(); }
+
+    void clear() { m_sets.clear(); }
+
+    const sets_t& sets() const { return m_sets; }
+
+    // Text form, as the server prints it (without the newlines)
+    std::string str() const;
+
+    // Binary form, as COM_BINLOG_DUMP_GTID wants it
+    std::string encode() const;
+
+    bool operator== (const GtidSet& other) const { return m_sets == other.m_sets; }
+    bool operator!= (const GtidSet& other) const { return m_sets != other.m_sets; }
+
+    static std::string parseUuid(const std::string& uuid);
+    static std::string formatUuid(const std::string& sid);
+
+private:
+
+    void addInterval(const std::string& sid, long long first, long long last);
+
+    sets_t m_sets;
+};
+
+}// slave
+
+#endif
@@ -0,0 +1,216 @@
+/* Copyright 2011 ZAO "Begun".
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3 of the License, or (at your option)
+ * any later version.
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __SLAVE_LAGSTATS_H_
+#define __SLAVE_LAGSTATS_H_
+
+#include <pthread.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "mutex_lock.h"
+
+
+namespace slave
+{
+
+// Stages of replication lag of a transaction, see ExtStateIface::addLagSample().
+enum LagStage {
+
+    // Commit on master -> its last packet is here
+    LAG_NETWORK,
+
+    // Time spent on it here: decoding and the callbacks
+    LAG_APPLY,
+
+    // Commit on master -> the last callback is done
+    LAG_TOTAL,
+
+    LAG_STAGES
+};
+
+inline unsigned long long now_usec() {
+
+    struct timeval tv;
+    ::gettimeofday(&tv, NULL);
+
+    return (unsigned long long)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+
+// Histogram of durations in microseconds. A power of two is split into 8 buckets,
+// so a percentile is within 12.5% of the real value.
+class LagHistogram {
+public:
+
+    LagHistogram() { reset(); }
+
+    void add(unsigned long long usec) {
+
+        ++m_buckets[bucket(usec)];
+        ++m_count;
+        m_sum += usec;
+
+        if (usec > m_max)
+            m_max = usec;
+    }
+
+    void reset() {
+        ::memset(m_buckets, 0, sizeof(m_buckets));
+        m_count = m_sum = m_max = 0;
+    }
+
+    unsigned long long count() const { return m_count; }
+    unsigned long long max() const { return m_max; }
+    unsigned long long mean() const { return m_count ? m_sum / m_count : 0; }
+
+    // 'p' is from 0 to 100; the upper bound of the bucket it falls into
+    unsigned long long percentile(double p) const {
+
+        if (m_count == 0)
+            return 0;
+
+        unsigned long long rank = (unsigned long long)(p / 100 * m_count);
+        if (rank >= m_count)
+            rank = m_count - 1;
+
+        unsigned long long seen = 0;
+
+        for (unsigned int b = 0; b < BUCKETS; ++b) {
+
+            seen += m_buckets[b];
+
+            if (seen > rank) {
+                const unsigned long long upper = lower_bound(b + 1) - 1;
+                return upper < m_max ? upper : m_max;
+            }
+        }
+
+        return m_max;
+    }
+
+private:
+
+    // 0..7 as they are, then 8 buckets per power of two up to 2^64
+    enum { BUCKETS = 62 * 8 };
+
+    static unsigned int bucket(unsigned long long v) {
+
+        if (v < 8)
+            return v;
+
+        unsigned int e = 3;
+        while (e < 63 && (v >> (e + 1)) != 0)
+            ++e;
+
+        return (e - 2) * 8 + ((v >> (e - 3)) & 7);
+    }
+
+    static unsigned long long lower_bound(unsigned int b) {
+
+        if (b < 8)
+            return b;
+
+        if (b >= BUCKETS)
+            return ~0ULL;
+
+        return (8ULL + b % 8) << (b / 8 - 1);
+    }
+
+    unsigned long long m_buckets[BUCKETS];
+    unsigned long long m_count;
+    unsigned long long m_sum;
+    unsigned long long m_max;
+};
+
+
+// What Slave::getLagPercentiles() gives for a stage, in microseconds
+struct LagPercentiles {
+
+    unsigned long long count;
+    unsigned long long mean;
+    unsigned long long p50;
+    unsigned long long p90;
+    unsigned long long p99;
+    unsigned long long max;
+
+    LagPercentiles() : count(0), mean(0), p50(0), p90(0), p99(0), max(0) {}
+};
+
+
+// A histogram per stage. Not synchronized, see SharedLagStats.
+struct LagStats {
+
+    LagHistogram stages[LAG_STAGES];
+
+    LagPercentiles percentiles(LagStage stage) const {
+
+        const LagHistogram& h = stages[stage];
+        LagPercentiles ret;
+
+        ret.count = h.count();
+        ret.mean = h.mean();
+        ret.p50 = h.percentile(50);
+        ret.p90 = h.percentile(90);
+        ret.p99 = h.percentile(99);
+        ret.max = h.max();
+
+        return ret;
+    }
+
+    void add(LagStage stage, unsigned long long usec) {
+        stages[stage].add(usec);
+    }
+
+    void reset() {
+        for (int i = 0; i < LAG_STAGES; ++i)
+            stages[i].reset();
+    }
+};
+
+
+// LagStats behind a mutex: Slave fills it in the binlog thread, it is read from any other.
+class SharedLagStats {
+public:
+
+    SharedLagStats() { ::pthread_mutex_init(&m_mutex, NULL); }
+    ~SharedLagStats() { ::pthread_mutex_destroy(&m_mutex); }
+
+    void add(LagStage stage, unsigned long long usec) {
+        MutexLock lock(m_mutex);
+        m_stats.add(stage, usec);
+    }
+
+    LagPercentiles percentiles(LagStage stage) const {
+        MutexLock lock(m_mutex);
+        return m_stats.percentiles(stage);
+    }
+
+    void reset() {
+        MutexLock lock(m_mutex);
+        m_stats.reset();
+    }
+
+private:
+
+    SharedLagStats(const SharedLagStats&);
+    SharedLagStats& operator= (const SharedLagStats&);
+
+    LagStats m_stats;
+    mutable pthread_mutex_t m_mutex;
+};
+
+}// slave
+
+#endif
@@ -0,0 +1,38 @@
+/* Copyright 2011 ZAO "Begun".
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3 of the License, or (at your option)
+ * any later version.
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __SLAVE_MUTEX_LOCK_H_
+#define __SLAVE_MUTEX_LOCK_H_
+
+#include <pthread.h>
+
+
+namespace slave
+{
+
+// Holds a mutex for the scope.
+class MutexLock {
+public:
+    explicit MutexLock(pthread_mutex_t& mutex) : m_mutex(mutex) { ::pthread_mutex_lock(&m_mutex); }
+    ~MutexLock() { ::pthread_mutex_unlock(&m_mutex); }
+private:
+    MutexLock(const MutexLock&);
+    MutexLock& operator= (const MutexLock&);
+
+    pthread_mutex_t& m_mutex;
+};
+
+}// slave
+
+#endif
@@ -19,10 +19,108 @@
 #include "nanofield.h"
 #include <stdexcept>
 #include <stdio.h>
+#include <stdlib.h>
 #include <vector>
 
 namespace nanomysql {
 
+// A whole result set in one buffer: the column names once, then the values one after
+// another, each followed by '\0'. Look the columns up by name once, outside the loop:
+//
+//     const size_t name = res.column("Name");
+//     for (size_t i = 0; i < res.rows(); ++i)
+//         use(res.str(i, name));
+class Result {
+
+    friend class Connection;
+
+    std::vector<std::string> m_names;
+    std::vector<size_t> m_types;
+
+    std::string m_data;
+
+    // Of every value, by row, and the end
+    std::vector<size_t> m_offsets;
+    std::vector<bool> m_nulls;
+
+    size_t at(size_t row, size_t col) const { return row * m_names.size() + col; }
+
+public:
+
+    size_t rows() const { return m_names.empty() ? 0 : m_nulls.size() / m_names.size(); }
+    size_t columns() const { return m_names.size(); }
+
+    const std::string& name(size_t col) const { return m_names[col]; }
+
+    // MYSQL_TYPE_*
+    size_t type(size_t col) const { return m_types[col]; }
+
+    bool has(const std::string& name) const
+    {
+        for (size_t i = 0; i < m_names.size(); ++i) {
+            if (m_names[i] == name)
+                return true;
+        }
+
+        return false;
+    }
+
+    // Throws std::runtime_error if there is no such column
+    size_t column(const std::string& name) const
+    {
+        for (size_t i = 0; i < m_names.size(); ++i) {
+            if (m_names[i] == name)
+                return i;
+        }
+
+        throw std::runtime_error("nanomysql::Result: no column '" + name + "'");
+    }
+
+    bool isNull(size_t row, size_t col) const { return m_nulls[at(row, col)]; }
+
+    // '\0'-terminated; empty for NULL
+    const char* data(size_t row, size_t col) const { return m_data.data() + m_offsets[at(row, col)]; }
+    size_t length(size_t row, size_t col) const { return m_offsets[at(row, col) + 1] - m_offsets[at(row, col)] - 1; }
+
+    std::string str(size_t row, size_t col) const { return std::string(data(row, col), length(row, col)); }
+
+    // The leading number, as istream >> would take it; 0 if there is none
+    long long toInt(size_t row, size_t col) const
+    {
+        const char* p = data(row, col);
+        const bool negative = (*p == '-');
+
+        if (*p == '-' || *p == '+')
+            ++p;
+
+        unsigned long long v = 0;
+
+        for (; *p >= '0' && *p <= '9'; ++p)
+            v = v * 10 + (*p - '0');
+
+        return negative ? -(long long)v : (long long)v;
+    }
+
+    unsigned long long toUInt(size_t row, size_t col) const
+    {
+        return (unsigned long long)toInt(row, col);
+    }
+
+    double toDouble(size_t row, size_t col) const
+    {
+        return ::strtod(data(row, col), NULL);
+    }
+
+    void clear()
+    {
+        m_names.clear();
+        m_types.clear();
+        m_data.clear();
+        m_offsets.clear();
+        m_nulls.clear();
+    }
+};
+
 class Connection {
 
     MYSQL* m_conn;
@@ -99,6 +197,12 @@ public:
         ::mysql_close(m_conn);
     }
 
+    // False if the connection is gone.
+    bool ping()
+    {
+        return ::mysql_ping(m_conn) == 0;
+    }
+
     void query(const std::string& q)
     {
         if (::mysql_real_query(m_conn, q.data(), q.size()) != 0)
@@ -151,6 +255,51 @@ public:
             out.push_back(fields);
         }
     }
+
+    void store(Result& out)
+    {
+        out.clear();
+
+        _mysql_res_wrap re(::mysql_use_result(m_conn));
+
+        if (re.s == NULL) {
+            throw_error("mysql_use_result() failed");
+        }
+
+        const size_t num_fields = ::mysql_num_fields(re.s);
+
+        for (size_t z = 0; z != num_fields; ++z) {
+            MYSQL_FIELD* ff = ::mysql_fetch_field(re.s);
+            out.m_names.push_back(ff->name);
+            out.m_types.push_back(ff->type);
+        }
+
+        out.m_offsets.push_back(0);
+
+        while (1) {
+            MYSQL_ROW row = ::mysql_fetch_row(re.s);
+
+            if (row == NULL) {
+                if (::mysql_errno(m_conn) != 0) {
+                    throw_error("mysql_fetch_row() failed");
+                }
+
+                break;
+            }
+
+            const unsigned long* lens = ::mysql_fetch_lengths(re.s);
+
+            for (size_t z = 0; z != num_fields; ++z) {
+
+                if (row[z] != NULL)
+                    out.m_data.append(row[z], lens[z]);
+
+                out.m_data += '\0';
+                out.m_offsets.push_back(out.m_data.size());
+                out.m_nulls.push_back(row[z] == NULL);
+            }
+        }
+    }
 };
 
 }
@@ -0,0 +1,363 @@
+/* Copyright 2011 ZAO "Begun".
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3 of the License, or (at your option)
+ * any later version.
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include "recorder.h"
+#include "Logging.h"
+
+
+namespace
+{
+
+const char SEGMENT_HEADER[] = "libslave-record 1\n";
+const size_t SEGMENT_HEADER_LEN = sizeof(SEGMENT_HEADER) - 1;
+
+const size_t EVENT_HEADER_LEN = 4 + 8 + 1;
+
+
+std::string segment_path(const std::string& dir, unsigned int segment, const char* ext) {
+
+    char name[32];
+    ::snprintf(name, sizeof(name), "/%06u.%s", segment, ext);
+
+    return dir + name;
+}
+
+// Numbers of the segments in 'dir', in order
+std::vector<unsigned int> list_segments(const std::string& dir) {
+
+    std::vector<unsigned int> segments;
+
+    DIR* d = ::opendir(dir.c_str());
+
+    if (d == NULL)
+        return segments;
+
+    while (struct dirent* entry = ::readdir(d)) {
+
+        char* end = NULL;
+        const unsigned long n = ::strtoul(entry->d_name, &end, 10);
+
+        if (end != entry->d_name && ::strcmp(end, ".events") == 0)
+            segments.push_back(n);
+    }
+
+    ::closedir(d);
+
+    std::sort(segments.begin(), segments.end());
+
+    return segments;
+}
+
+void put_le(std::string& out, unsigned long long v, unsigned int bytes) {
+
+    for (unsigned int i = 0; i < bytes; ++i) {
+        out += (char)(v & 0xff);
+        v >>= 8;
+    }
+}
+
+unsigned long long get_le(const unsigned char* p, unsigned int bytes) {
+
+    unsigned long long v = 0;
+
+    for (unsigned int i = bytes; i > 0; --i)
+        v = (v << 8) | p[i - 1];
+
+    return v;
+}
+
+}// anonymous-namespace
+
+
+namespace slave
+{
+
+BinlogRecorder::BinlogRecorder(const std::string& dir, size_t segment_size, unsigned int keep_segments,
+                               Sync sync, size_t batch_size) :
+    m_dir(dir), m_segment_size(segment_size), m_keep_segments(keep_segments), m_sync(sync),
+    m_batch_size(batch_size), m_failed(false), m_fd(-1), m_index_fd(-1), m_segment(0),
+    m_segment_bytes(0), m_batch_usec(0) {
+
+    const std::vector<unsigned int> segments = list_segments(m_dir);
+
+    if (!segments.empty())
+        m_segment = segments.back();
+
+    m_batch.reserve(m_batch_size + 64 * 1024);
+
+    open_segment();
+}
+
+BinlogRecorder::~BinlogRecorder() {
+
+    flush();
+    close_segment();
+}
+
+
+void BinlogRecorder::record(const char* buf, size_t len, unsigned long long usec, unsigned char checksum_alg,
+                            const std::string& log_name, unsigned long log_pos) {
+
+    if (m_failed)
+        return;
+
+    if (m_batch.empty()) {
+
+        std::ostringstream line;
+        line << m_segment_bytes << ' ' << log_name << ' ' << log_pos << '\n';
+
+        m_index_line = line.str();
+        m_batch_usec = usec;
+    }
+
+    put_le(m_batch, len, 4);
+    put_le(m_batch, usec, 8);
+    m_batch += (char)checksum_alg;
+    m_batch.append(buf, len);
+
+    if (m_batch.size() >= m_batch_size || usec - m_batch_usec >= 1000000)
+        flush();
+}
+
+
+void BinlogRecorder::flush() {
+
+    if (m_failed || m_batch.empty())
+        return;
+
+    try {
+
+        write(m_fd, m_batch);
+        write(m_index_fd, m_index_line);
+
+        if (m_sync == SYNC_BATCH && ::fdatasync(m_fd) != 0)
+            throw std::runtime_error("fdatasync() failed: " + std::string(::strerror(errno)));
+
+        m_segment_bytes += m_batch.size();
+        m_batch.clear();
+
+        if (m_segment_bytes >= m_segment_size) {
+            close_segment();
+            open_segment();
+        }
+
+    } catch (const std::exception& e) {
+
+        LOG_ERROR(log, "Binlog recording in " << m_dir << " stopped: " << e.what());
+
+        m_failed = true;
+        m_batch.clear();
+        close_segment();
+    }
+}
+
+
+void BinlogRecorder::write(int fd, const std::string& data) {
+
+    const char* p = data.data();
+    size_t left = data.size();
+
+    while (left != 0) {
+
+        const ssize_t n = ::write(fd, p, left);
+
+        if (n < 0 && errno == EINTR)
+            continue;
+
+        if (n < 0)
+            throw std::runtime_error("write() failed: " + std::string(::strerror(errno)));
+
+        p += n;
+        left -= n;
+    }
+}
+
+
+void BinlogRecorder::open_segment() {
+
+    ++m_segment;
+
+    const std::string path = segment_path(m_dir, m_segment, "events");
+
+    m_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    m_index_fd = ::open(segment_path(m_dir, m_segment, "index").c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    if (m_fd < 0 || m_index_fd < 0) {
+        const int error = errno;
+        close_segment();
+        throw std::runtime_error("BinlogRecorder: could not create " + path + ": " + ::strerror(error));
+    }
+
+    write(m_fd, std::string(SEGMENT_HEADER, SEGMENT_HEADER_LEN));
+    m_segment_bytes = SEGMENT_HEADER_LEN;
+
+    if (m_keep_segments == 0)
+        return;
+
+    for (unsigned int old = m_segment - std::min(m_segment, m_keep_segments); old > 0; --old) {
+
+        if (::unlink(segment_path(m_dir, old, "events").c_str()) != 0)
+            break;
+
+        ::unlink(segment_path(m_dir, old, "index").c_str());
+    }
+}
+
+void BinlogRecorder::close_segment() {
+
+    if (m_fd >= 0) {
+
+        if (m_sync != SYNC_NONE && ::fdatasync(m_fd) != 0)
+            LOG_ERROR(log, "fdatasync() of a binlog recording segment failed: " << ::strerror(errno));
+
+        ::close(m_fd);
+        m_fd = -1;
+    }
+
+    if (m_index_fd >= 0) {
+        ::close(m_index_fd);
+        m_index_fd = -1;
+    }
+}
+
+
+BinlogReplayer::BinlogReplayer(const std::string& dir) :
+    m_dir(dir), m_segments(list_segments(dir)), m_current(0), m_file(NULL) {
+
+    if (m_segments.empty())
+        throw std::runtime_error("BinlogReplayer: no recording in " + dir);
+
+    if (!open(0, SEGMENT_HEADER_LEN))
+        throw std::runtime_error("BinlogReplayer: could not open the first segment in " + dir);
+}
+
+BinlogReplayer::~BinlogReplayer() {
+
+    if (m_file)
+        ::fclose(m_file);
+}
+
+
+bool BinlogReplayer::open(size_t segment, long offset) {
+
+    if (m_file) {
+        ::fclose(m_file);
+        m_file = NULL;
+    }
+
+    const std::string path = segment_path(m_dir, m_segments[segment], "events");
+
+    m_file = ::fopen(path.c_str(), "rb");
+
+    if (m_file == NULL)
+        return false;
+
+    ::setvbuf(m_file, NULL, _IOFBF, 1024 * 1024);
+
+    char header[SEGMENT_HEADER_LEN];
+
+    if (::fread(header, 1, SEGMENT_HEADER_LEN, m_file) != SEGMENT_HEADER_LEN ||
+        ::memcmp(header, SEGMENT_HEADER, SEGMENT_HEADER_LEN) != 0)
+        throw std::runtime_error("BinlogReplayer: " + path + " is not a binlog recording");
+
+    if (::fseek(m_file, offset, SEEK_SET) != 0)
+        throw std::runtime_error("BinlogReplayer: could not seek in " + path);
+
+    m_current = segment;
+
+    return true;
+}
+
+
+bool BinlogReplayer::seek(const std::string& log_name, unsigned long log_pos) {
+
+    bool found = false;
+    size_t found_segment = 0;
+    long found_offset = 0;
+
+    for (size_t i = 0; i < m_segments.size(); ++i) {
+
+        std::ifstream index(segment_path(m_dir, m_segments[i], "index").c_str());
+
+        long offset;
+        std::string name;
+        unsigned long pos;
+
+        while (index >> offset >> name >> pos) {
+
+            if (name < log_name || (name == log_name && pos <= log_pos)) {
+                found = true;
+                found_segment = i;
+                found_offset = offset;
+            }
+        }
+    }
+
+    return found && open(found_segment, found_offset);
+}
+
+
+bool BinlogReplayer::next(Event& event) {
+
+    unsigned char header[EVENT_HEADER_LEN];
+
+    size_t n = ::fread(header, 1, EVENT_HEADER_LEN, m_file);
+
+    while (n == 0 && m_current + 1 < m_segments.size()) {
+
+        if (!open(m_current + 1, SEGMENT_HEADER_LEN))
+            return false;
+
+        n = ::fread(header, 1, EVENT_HEADER_LEN, m_file);
+    }
+
+    if (n == 0)
+        return false;
+
+    if (n != EVENT_HEADER_LEN) {
+        LOG_WARNING(log, "Binlog recording segment " << m_segments[m_current] << " is cut short");
+        return false;
+    }
+
+    const size_t len = get_le(header, 4);
+
+    m_data.resize(len + 1);
+
+    if (len != 0 && ::fread(&m_data[0], 1, len, m_file) != len) {
+        LOG_WARNING(log, "Binlog recording segment " << m_segments[m_current] << " is cut short");
+        return false;
+    }
+
+    event.data = &m_data[0];
+    event.len = len;
+    event.usec = get_le(header + 4, 8);
+    event.checksum_alg = header[12];
+
+    return true;
+}
+
+}// slave
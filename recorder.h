@@ -0,0 +1,138 @@
+/* Copyright 2011 ZAO "Begun".
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3 of the License, or (at your option)
+ * any later version.
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __SLAVE_RECORDER_H_
+#define __SLAVE_RECORDER_H_
+
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+
+/*
+ * Recording of the raw binlog stream, to run it through the callbacks again later
+ * (see Slave::setRecorder() and Slave::replay()).
+ *
+ * A recording is a directory of numbered segments. A segment "000001.events" is
+ * a header line, then the events as they came from master:
+ *
+ *   uint32 LE    length of the event
+ *   uint64 LE    when it came, microseconds since the epoch
+ *   byte         binlog checksum algorithm of the stream at that moment
+ *   bytes        the event
+ *
+ * and "000001.index" has a line "<offset> <log_name> <log_pos>" for every batch
+ * written to the segment: where the binlog position of its first event is.
+ */
+
+namespace slave
+{
+
+class BinlogRecorder {
+public:
+
+    enum Sync {
+        SYNC_NONE,      // leave it to the OS
+        SYNC_SEGMENT,   // fdatasync() every full segment
+        SYNC_BATCH      // fdatasync() every batch
+    };
+
+    // Starts a new segment after the ones already in 'dir'. With keep_segments, the
+    // older segments are deleted, so that no more than that many are left.
+    BinlogRecorder(const std::string& dir, size_t segment_size = 256 * 1024 * 1024,
+                   unsigned int keep_segments = 0, Sync sync = SYNC_SEGMENT,
+                   size_t batch_size = 1024 * 1024);
+
+    ~BinlogRecorder();
+
+    // Events are written in batches, at least once a second. An error is logged
+    // and stops the recording; it never gets to the binlog reading.
+    void record(const char* buf, size_t len, unsigned long long usec, unsigned char checksum_alg,
+                const std::string& log_name, unsigned long log_pos);
+
+    void flush();
+
+private:
+
+    BinlogRecorder(const BinlogRecorder&);
+    BinlogRecorder& operator= (const BinlogRecorder&);
+
+    void open_segment();
+    void close_segment();
+    void write(int fd, const std::string& data);
+
+    std::string m_dir;
+    size_t m_segment_size;
+    unsigned int m_keep_segments;
+    Sync m_sync;
+    size_t m_batch_size;
+
+    bool m_failed;
+
+    int m_fd;
+    int m_index_fd;
+    unsigned int m_segment;
+    size_t m_segment_bytes;
+
+    // Not written yet, and where it starts
+    std::string m_batch;
+    unsigned long long m_batch_usec;
+    std::string m_index_line;
+};
+
+
+class BinlogReplayer {
+public:
+
+    struct Event {
+
+        // Valid till the next call of next()
+        const char* data;
+        size_t len;
+
+        unsigned long long usec;
+        unsigned char checksum_alg;
+    };
+
+    // Throws std::runtime_error if there are no segments in 'dir'.
+    explicit BinlogReplayer(const std::string& dir);
+
+    ~BinlogReplayer();
+
+    // Goes to the batch with the binlog position, by the index: the events from it on
+    // may start a bit before the position. False if the recording does not have it.
+    bool seek(const std::string& log_name, unsigned long log_pos);
+
+    // False after the last event. Throws std::runtime_error on a broken segment.
+    bool next(Event& event);
+
+private:
+
+    BinlogReplayer(const BinlogReplayer&);
+    BinlogReplayer& operator= (const BinlogReplayer&);
+
+    bool open(size_t segment, long offset);
+
+    std::string m_dir;
+    std::vector<unsigned int> m_segments;
+    size_t m_current;
+
+    FILE* m_file;
+    std::vector<char> m_data;
+};
+
+}// slave
+
+#endif
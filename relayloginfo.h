@@ -45,6 +45,12 @@ public:
         m_table_map.clear();
     }
 
+    // The table ids stay: they come from the binlog, and the rows events after
+    // the TABLE_MAP events already read still need them.
+    void clearTables() {
+        m_table_map.clear();
+    }
+
 
     void setTableName(unsigned long table_id, const std::string& table_name, const std::string& db_name) {
 	m_map_table_name[table_id] = std::make_pair(db_name, table_name);
@@ -0,0 +1,171 @@
+/* Copyright 2011 ZAO "Begun".
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3 of the License, or (at your option)
+ * any later version.
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+
+#include <fstream>
+#include <stdexcept>
+
+#include "schema_cache.h"
+
+
+/*
+ * File format: a header line, then strings as "<length>:<bytes>" and numbers,
+ * separated by whitespace, so that any names are fine.
+ *
+ *   libslave-schema-cache 2
+ *   <master> <log_name> <log_pos>
+ *   <table count>
+ *   <db> <table> <column count>
+ *   <name> <type> <collation> <charset> <maxlen> <primary>
+ *   ...
+ */
+
+namespace
+{
+
+const char* const CACHE_HEADER = "libslave-schema-cache 2";
+
+
+void write_str(std::ostream& out, const std::string& s) {
+    out << s.size() << ':' << s << ' ';
+}
+
+bool read_str(std::istream& in, std::string& s) {
+
+    size_t len = 0;
+    char colon = 0;
+
+    if (!(in >> len) || !in.get(colon) || colon != ':')
+        return false;
+
+    s.resize(len);
+
+    if (len != 0 && !in.read(&s[0], len))
+        return false;
+
+    return true;
+}
+
+}// anonymous-namespace
+
+
+namespace slave
+{
+
+bool SchemaCache::load(const std::string& path) {
+
+    std::ifstream in(path.c_str(), std::ios::in | std::ios::binary);
+
+    if (!in)
+        return false;
+
+    std::string header;
+
+    if (!std::getline(in, header) || header != CACHE_HEADER)
+        return false;
+
+    size_t ntables = 0;
+
+    if (!read_str(in, master) || !read_str(in, log_name) || !(in >> log_pos) || !(in >> ntables))
+        return false;
+
+    tables.clear();
+
+    for (size_t t = 0; t < ntables; ++t) {
+
+        std::string db_name, tbl_name;
+        size_t ncolumns = 0;
+
+        if (!read_str(in, db_name) || !read_str(in, tbl_name) || !(in >> ncolumns))
+            return false;
+
+        std::vector<ColumnInfo>& columns = tables[std::make_pair(db_name, tbl_name)];
+        columns.resize(ncolumns);
+
+        for (size_t c = 0; c < ncolumns; ++c) {
+
+            ColumnInfo& ci = columns[c];
+
+            if (!read_str(in, ci.name) || !read_str(in, ci.type) ||
+                !read_str(in, ci.collate.name) || !read_str(in, ci.collate.charset) ||
+                !(in >> ci.collate.maxlen) || !(in >> ci.primary))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+void SchemaCache::save(const std::string& path) const {
+
+    const std::string tmp = path + ".tmp";
+
+    {
+        std::ofstream out(tmp.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+
+        if (!out)
+            throw std::runtime_error("SchemaCache::save(): cannot open " + tmp);
+
+        out << CACHE_HEADER << '\n';
+
+        write_str(out, master);
+        write_str(out, log_name);
+        out << log_pos << '\n' << tables.size() << '\n';
+
+        for (tables_t::const_iterator t = tables.begin(); t != tables.end(); ++t) {
+
+            write_str(out, t->first.first);
+            write_str(out, t->first.second);
+            out << t->second.size() << '\n';
+
+            for (std::vector<ColumnInfo>::const_iterator c = t->second.begin(); c != t->second.end(); ++c) {
+
+                write_str(out, c->name);
+                write_str(out, c->type);
+                write_str(out, c->collate.name);
+                write_str(out, c->collate.charset);
+                out << c->collate.maxlen << ' ' << c->primary << '\n';
+            }
+        }
+
+        out.flush();
+
+        if (!out)
+            throw std::runtime_error("SchemaCache::save(): cannot write " + tmp);
+    }
+
+    if (::rename(tmp.c_str(), path.c_str()) != 0)
+        throw std::runtime_error("SchemaCache::save(): cannot rename " + tmp + " to " + path);
+}
+
+bool SchemaCache::validAt(const std::string& _master, const std::string& _log_name, unsigned long _log_pos) const {
+
+    if (_master != master || _log_name.empty() || log_name.empty())
+        return false;
+
+    // "mysql-bin.000012": the same base name, and the number is zero-padded
+    const std::string::size_type dot = log_name.rfind('.');
+    const std::string::size_type _dot = _log_name.rfind('.');
+
+    if (log_name.compare(0, dot, _log_name, 0, _dot) != 0 || log_name.size() != _log_name.size())
+        return false;
+
+    if (_log_name != log_name)
+        return _log_name > log_name;
+
+    return _log_pos >= log_pos;
+}
+
+}// slave
@@ -0,0 +1,57 @@
+/* Copyright 2011 ZAO "Begun".
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3 of the License, or (at your option)
+ * any later version.
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __SLAVE_SCHEMA_CACHE_H_
+#define __SLAVE_SCHEMA_CACHE_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "table.h"
+
+
+namespace slave
+{
+
+// On-disk copy of the watched tables' structure, so that a restart does not have to
+// query the master for it. It describes the tables as of the binlog position it was
+// taken at, so it is only used when reading resumes at or after that position; the
+// tables are checked against the TABLE_MAP events anyway.
+struct SchemaCache {
+
+    // "host:port"
+    std::string master;
+
+    std::string log_name;
+    unsigned long log_pos;
+
+    typedef std::map<std::pair<std::string, std::string>, std::vector<ColumnInfo> > tables_t;
+    tables_t tables;
+
+    SchemaCache() : log_pos(0) {}
+
+    // False if there is no such file, or it is broken.
+    bool load(const std::string& path);
+
+    // Writes a temporary file and renames it to 'path'. Throws std::runtime_error.
+    void save(const std::string& path) const;
+
+    // Can the cache be used when reading the binlog of 'master' from '_log_name':'_log_pos'?
+    bool validAt(const std::string& _master, const std::string& _log_name, unsigned long _log_pos) const;
+};
+
+}// slave
+
+#endif
@@ -12,6 +12,9 @@
  * along with this library.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <string.h>
+
+#include <algorithm>
 #include <string>
 #include <vector>
 #include <map>
@@ -28,6 +31,8 @@
 
 #include "SlaveStats.h"
 #include "Logging.h"
+#include "crc32.h"
+#include "coalesce.h"
 
 
 
@@ -104,12 +109,133 @@ Table_map_event_info::Table_map_event_info(const char* buf, unsigned int event_l
     size_t tblen = *(p_tblen);
 
     m_tblnam.assign((const char*)(p_tblen + 1), tblen);
+
+    unsigned char* p_colcnt = p_tblen + tblen + 2;
+    const unsigned char* end = (const unsigned char*)buf + event_len;
+
+    if (p_colcnt >= end) {
+        LOG_ERROR(log, "Sanity check failed: TABLE_MAP event for " << m_dbnam << "." << m_tblnam << " has no columns");
+        ::abort();
+    }
+
+    const unsigned long colcnt = net_field_length(&p_colcnt);
+
+    if (p_colcnt + colcnt > end) {
+        LOG_ERROR(log, "Sanity check failed: TABLE_MAP event column count " << colcnt << ", event length " << event_len);
+        ::abort();
+    }
+
+    m_column_types.assign(p_colcnt, p_colcnt + colcnt);
+
+    unsigned char* p_meta = p_colcnt + colcnt;
+
+    if (p_meta >= end)
+        return;
+
+    const unsigned long metalen = net_field_length(&p_meta);
+
+    if (p_meta + metalen > end) {
+        LOG_WARNING(log, "TABLE_MAP event for " << m_dbnam << "." << m_tblnam << " has its metadata cut short");
+        return;
+    }
+
+    std::vector<unsigned int> meta(colcnt, 0);
+    const unsigned char* const meta_end = p_meta + metalen;
+
+    for (unsigned long i = 0; i < colcnt; ++i) {
+
+        unsigned int bytes = 0;
+
+        // Older MySQL headers do not have all of the types: enum_field_types by number
+        switch (m_column_types[i]) {
+        case 4:                         // FLOAT
+        case 5:                         // DOUBLE
+        case 17:                        // TIMESTAMP2
+        case 18:                        // DATETIME2
+        case 19:                        // TIME2
+        case 245:                       // JSON
+        case 249:                       // TINY_BLOB
+        case 250:                       // MEDIUM_BLOB
+        case 251:                       // LONG_BLOB
+        case 252:                       // BLOB
+        case 255:                       // GEOMETRY
+            bytes = 1;
+            break;
+        case 15:                        // VARCHAR
+        case 16:                        // BIT
+        case 246:                       // NEWDECIMAL
+        case 247:                       // ENUM
+        case 248:                       // SET
+        case 253:                       // VAR_STRING
+        case 254:                       // STRING
+            bytes = 2;
+            break;
+        default:
+            break;
+        }
+
+        if (p_meta + bytes > meta_end) {
+            LOG_WARNING(log, "TABLE_MAP event for " << m_dbnam << "." << m_tblnam << " has its metadata cut short");
+            return;
+        }
+
+        // VARCHAR has its length little-endian, the others their two bytes in order
+        if (bytes == 1)
+            meta[i] = p_meta[0];
+        else if (bytes == 2 && (m_column_types[i] == 15 || m_column_types[i] == 253))
+            meta[i] = p_meta[0] | (p_meta[1] << 8);
+        else if (bytes == 2)
+            meta[i] = (p_meta[0] << 8) | p_meta[1];
+
+        p_meta += bytes;
+    }
+
+    m_column_meta.swap(meta);
+}
+
+Gtid_event_info::Gtid_event_info(const char* buf, unsigned int event_len) {
+
+    if (event_len < LOG_EVENT_HEADER_LEN + GTID_HEADER_LEN) {
+        LOG_ERROR(log, "Sanity check failed: " << event_len << " " << LOG_EVENT_HEADER_LEN + GTID_HEADER_LEN);
+        ::abort();
+    }
+
+    const char* p = buf + LOG_EVENT_HEADER_LEN;
+
+    commit_flag = (p[0] != 0);
+    ::memcpy(sid, p + 1, GTID_ENCODED_SID_LENGTH);
+    gno = (long long)uint8korr(p + 1 + GTID_ENCODED_SID_LENGTH);
+
+    // 8.0: logical clock (type, last_committed, sequence_number), then the immediate
+    // commit timestamp in 7 bytes; its top bit says the original one follows.
+    const unsigned int ts_offset = GTID_HEADER_LEN + 1 + 8 + 8;
+
+    commit_ts = 0;
+
+    if (event_len >= LOG_EVENT_HEADER_LEN + ts_offset + 7) {
+
+        const unsigned char* ts = (const unsigned char*)p + ts_offset;
+
+        for (int i = 6; i >= 0; --i)
+            commit_ts = (commit_ts << 8) | ts[i];
+
+        if ((commit_ts & (1ULL << 55)) && event_len >= LOG_EVENT_HEADER_LEN + ts_offset + 14) {
+
+            commit_ts = 0;
+            for (int i = 13; i >= 7; --i)
+                commit_ts = (commit_ts << 8) | ts[i];
+        }
+
+        commit_ts &= ~(1ULL << 55);
+    }
 }
 
-Row_event_info::Row_event_info(const char* buf, unsigned int event_len, bool do_update) {
+Row_event_info::Row_event_info(const char* buf, unsigned int event_len, bool do_update, bool v2) {
+
+    const unsigned int header_len = (v2 ? ROWS_HEADER_LEN_V2 : ROWS_HEADER_LEN);
 
-    if (event_len < LOG_EVENT_HEADER_LEN + ROWS_HEADER_LEN + 2) {
-        LOG_ERROR(log, "Sanity check failed: " << event_len << " " << LOG_EVENT_HEADER_LEN + ROWS_HEADER_LEN + 2);
+    if (event_len < LOG_EVENT_HEADER_LEN + header_len + 2) {
+        LOG_ERROR(log, "Sanity check failed: " << event_len << " " << LOG_EVENT_HEADER_LEN + header_len + 2);
         ::abort();
     }
 
@@ -117,7 +243,19 @@ Row_event_info::Row_event_info(const char* buf, unsigned int event_len, bool do_
 
     m_table_id = uint6korr(buf + LOG_EVENT_HEADER_LEN + RW_MAPID_OFFSET);
     
-    unsigned char* start = (unsigned char*)(buf + LOG_EVENT_HEADER_LEN + ROWS_HEADER_LEN);
+    unsigned char* start = (unsigned char*)(buf + LOG_EVENT_HEADER_LEN + header_len);
+
+    if (v2) {
+        // Length of the extra row info block, including the length itself.
+        const unsigned int extra_len = uint2korr(buf + LOG_EVENT_HEADER_LEN + RW_V_EXTRAINFO_OFFSET);
+
+        if (extra_len < 2 || event_len < LOG_EVENT_HEADER_LEN + header_len + extra_len) {
+            LOG_ERROR(log, "Sanity check failed: rows event extra info length " << extra_len << ", event length " << event_len);
+            ::abort();
+        }
+
+        start += extra_len - 2;
+    }
 
     m_width = net_field_length(&start);
 
@@ -150,7 +288,52 @@ inline void check_format_description_postlen(unsigned char* b, slave::Log_event_
 }
 
 
-inline void check_format_description(const char* buf, unsigned int event_len) {
+// Servers starting from 5.6.1 append the checksum algorithm and a checksum to the
+// Format_description event, whatever @@binlog_checksum is.
+inline bool is_checksum_aware_version(const char* buf) {
+
+    const std::string version(buf, ::strnlen(buf, ST_SERVER_VER_LEN));
+
+    unsigned long v[3] = { 0, 0, 0 };
+    const char* p = version.c_str();
+
+    for (int i = 0; i < 3; ++i) {
+
+        char* e;
+        v[i] = ::strtoul(p, &e, 10);
+
+        if (e == p || *e != '.')
+            break;
+
+        p = e + 1;
+    }
+
+    return (v[0] * 10000 + v[1] * 100 + v[2]) >= 50601;
+}
+
+
+// Returns the checksum algorithm of the binlog this event heads.
+inline unsigned char check_format_description(const char* buf, unsigned int event_len) {
+
+    unsigned char checksum_alg = BINLOG_CHECKSUM_ALG_UNDEF;
+
+    if (event_len < LOG_EVENT_MINIMAL_HEADER_LEN + ST_COMMON_HEADER_LEN_OFFSET + 1) {
+        LOG_ERROR(log, "Sanity check failed: " << event_len << " "
+                  << LOG_EVENT_MINIMAL_HEADER_LEN + ST_COMMON_HEADER_LEN_OFFSET + 1);
+        ::abort();
+    }
+
+    if (is_checksum_aware_version(buf + LOG_EVENT_MINIMAL_HEADER_LEN + ST_SERVER_VER_OFFSET)) {
+
+        if (event_len < LOG_EVENT_MINIMAL_HEADER_LEN + ST_COMMON_HEADER_LEN_OFFSET + 1 +
+                        BINLOG_CHECKSUM_ALG_DESC_LEN + BINLOG_CHECKSUM_LEN) {
+            LOG_ERROR(log, "Invalid Format_description event: no room for checksum: " << event_len);
+            ::abort();
+        }
+
+        checksum_alg = (unsigned char)buf[event_len - BINLOG_CHECKSUM_LEN - BINLOG_CHECKSUM_ALG_DESC_LEN];
+        event_len -= BINLOG_CHECKSUM_LEN + BINLOG_CHECKSUM_ALG_DESC_LEN;
+    }
 
     buf += LOG_EVENT_MINIMAL_HEADER_LEN;
 
@@ -166,30 +349,42 @@ inline void check_format_description(const char* buf, unsigned int event_len) {
     size_t number_of_event_types =
         event_len - (LOG_EVENT_MINIMAL_HEADER_LEN + ST_COMMON_HEADER_LEN_OFFSET + 1);
 
-    if (number_of_event_types != LOG_EVENT_TYPES) {
+    // Every server we support knows at least the 5.1 event types; only the post-header
+    // lengths of the events we parse have to match.
+    if (number_of_event_types < INCIDENT_EVENT) {
 
         LOG_ERROR(log, "Invalid Format_description event: number_of_event_types " << number_of_event_types
-                  << " != " << LOG_EVENT_TYPES);
+                  << " < " << INCIDENT_EVENT);
         ::abort();
     }
 
     unsigned char event_lens[LOG_EVENT_TYPES] = { 0, };
 
-    ::memcpy(&event_lens[0], (unsigned char*)(buf + ST_COMMON_HEADER_LEN_OFFSET + 1), LOG_EVENT_TYPES);
+    ::memcpy(&event_lens[0], (unsigned char*)(buf + ST_COMMON_HEADER_LEN_OFFSET + 1),
+             std::min(number_of_event_types, (size_t)LOG_EVENT_TYPES));
 
     check_format_description_postlen(event_lens, XID_EVENT, 0);
     check_format_description_postlen(event_lens, QUERY_EVENT, QUERY_HEADER_LEN);
     check_format_description_postlen(event_lens, ROTATE_EVENT, ROTATE_HEADER_LEN);
-    check_format_description_postlen(event_lens, FORMAT_DESCRIPTION_EVENT, FORMAT_DESCRIPTION_HEADER_LEN);
+    check_format_description_postlen(event_lens, FORMAT_DESCRIPTION_EVENT,
+                                     START_V3_HEADER_LEN + 1 + number_of_event_types);
     check_format_description_postlen(event_lens, TABLE_MAP_EVENT, TABLE_MAP_HEADER_LEN);
     check_format_description_postlen(event_lens, WRITE_ROWS_EVENT, ROWS_HEADER_LEN);
     check_format_description_postlen(event_lens, UPDATE_ROWS_EVENT, ROWS_HEADER_LEN);
     check_format_description_postlen(event_lens, DELETE_ROWS_EVENT, ROWS_HEADER_LEN);
 
+    if (number_of_event_types >= DELETE_ROWS_EVENT_V2) {
+        check_format_description_postlen(event_lens, WRITE_ROWS_EVENT_V2, ROWS_HEADER_LEN_V2);
+        check_format_description_postlen(event_lens, UPDATE_ROWS_EVENT_V2, ROWS_HEADER_LEN_V2);
+        check_format_description_postlen(event_lens, DELETE_ROWS_EVENT_V2, ROWS_HEADER_LEN_V2);
+    }
+
+    return checksum_alg;
 }
 
 
-bool read_log_event(const char* buf, uint event_len, Basic_event_info& bei)
+bool read_log_event(const char* buf, uint event_len, Basic_event_info& bei,
+                    unsigned char& checksum_alg, bool verify_checksum)
 
 {
 
@@ -199,19 +394,46 @@ bool read_log_event(const char* buf, uint event_len, Basic_event_info& bei)
     /* Check the integrity */
 
     if (event_len < EVENT_LEN_OFFSET ||
-        bei.type >= ENUM_END_EVENT ||
         (uint) event_len != uint4korr(buf+EVENT_LEN_OFFSET))
     {
         LOG_ERROR(log, "Sanity check failed: " << event_len);
         ::abort();
     }
 
-    switch (bei.type) {
+    if (bei.type == FORMAT_DESCRIPTION_EVENT) {
 
-    case FORMAT_DESCRIPTION_EVENT:
+        checksum_alg = check_format_description(buf, event_len);
+    }
 
-        check_format_description(buf, event_len);
+    if (checksum_alg != BINLOG_CHECKSUM_ALG_OFF &&
+        checksum_alg != BINLOG_CHECKSUM_ALG_UNDEF) {
+
+        if (checksum_alg != BINLOG_CHECKSUM_ALG_CRC32 ||
+            event_len < LOG_EVENT_HEADER_LEN + BINLOG_CHECKSUM_LEN) {
+            LOG_ERROR(log, "Sanity check failed: checksum alg " << (int)checksum_alg << ", event length " << event_len);
+            ::abort();
+        }
 
+        const unsigned int data_len = event_len - BINLOG_CHECKSUM_LEN;
+
+        if (verify_checksum) {
+
+            const uint32 expected = uint4korr(buf + data_len);
+            const uint32 computed = binlog_crc32(0, (const unsigned char*)buf, data_len);
+
+            if (expected != computed) {
+                LOG_ERROR(log, "Binlog event checksum mismatch: event type " << (int)bei.type
+                          << ", log_pos " << bei.log_pos << ": " << expected << " != " << computed);
+                ::abort();
+            }
+        }
+
+        bei.event_len = data_len;
+    }
+
+    switch (bei.type) {
+
+    case FORMAT_DESCRIPTION_EVENT:
         return true;
         break;
 
@@ -221,7 +443,11 @@ bool read_log_event(const char* buf, uint event_len, Basic_event_info& bei)
     case WRITE_ROWS_EVENT:
     case UPDATE_ROWS_EVENT:
     case DELETE_ROWS_EVENT:
+    case WRITE_ROWS_EVENT_V2:
+    case UPDATE_ROWS_EVENT_V2:
+    case DELETE_ROWS_EVENT_V2:
     case TABLE_MAP_EVENT:
+    case GTID_LOG_EVENT:
         return true;
         break;
 
@@ -243,6 +469,21 @@ bool read_log_event(const char* buf, uint event_len, Basic_event_info& bei)
     case BEGIN_LOAD_QUERY_EVENT:
     case EXECUTE_LOAD_QUERY_EVENT:
     case INCIDENT_EVENT:
+    case HEARTBEAT_LOG_EVENT:
+    case IGNORABLE_LOG_EVENT:
+    case ROWS_QUERY_LOG_EVENT:
+    case ANONYMOUS_GTID_LOG_EVENT:
+    case PREVIOUS_GTIDS_LOG_EVENT:
+    case TRANSACTION_CONTEXT_EVENT:
+    case VIEW_CHANGE_EVENT:
+    case XA_PREPARE_LOG_EVENT:
+        return false;
+        break;
+
+    case PARTIAL_UPDATE_ROWS_EVENT:
+    case TRANSACTION_PAYLOAD_EVENT:
+        LOG_ERROR(log, "Unsupported event code: " << (int) bei.type
+                  << ", set binlog_row_value_options='' and binlog_transaction_compression=OFF on master");
         return false;
         break;
 
@@ -251,15 +492,6 @@ bool read_log_event(const char* buf, uint event_len, Basic_event_info& bei)
         return false;
         break;
     }
-
-    //
-    //
-
-    if ( event_len > 1024*1024*3 ) { // >3 Mb
-        LOG_ERROR(log, "Warning: event size > 3MB! Maybe a corrupted event!");
-    }
-
-    return true;
 }
 
 
@@ -365,6 +597,144 @@ unsigned char* unpack_row(boost::shared_ptr<slave::Table> table,
 }
 
 
+// The primary key of a row image as raw bytes; empty if the table has no known key,
+// or the image has not all of it. Returns the end of the image.
+const unsigned char* image_key(const slave::Table& table, const unsigned char* row,
+                               const std::vector<unsigned char>& cols, std::string& key)
+{
+    const unsigned int field_count = table.fields.size();
+
+    const unsigned char* null_ptr = row;
+    const char* ptr = (const char*)row + (n_set_bits(cols, field_count) + 7) / 8;
+    unsigned int null_bit = 0;
+
+    bool complete = true;
+    key.clear();
+
+    for (unsigned int i = 0; i < field_count; ++i) {
+
+        const bool primary = table.isPrimary(i);
+
+        if (!(cols[i / 8] & (1 << (i & 7)))) {
+            complete = complete && !primary;
+            continue;
+        }
+
+        const bool is_null = null_ptr[null_bit / 8] & (1 << (null_bit & 7));
+        ++null_bit;
+
+        if (is_null)
+            continue;
+
+        const char* begin = ptr;
+        ptr = table.fields[i]->skip(ptr);
+
+        // The values delimit themselves, they can be just concatenated
+        if (primary)
+            key.append(begin, ptr - begin);
+    }
+
+    if (!complete)
+        key.clear();
+
+    return (const unsigned char*)ptr;
+}
+
+
+// A value in a row image
+struct Raw_value {
+    const char* begin;
+    const char* end;
+    bool present;
+    bool is_null;
+};
+
+// Both images of an update: only the changed columns and the primary key are unpacked,
+// the others are compared as raw bytes and skipped.
+unsigned char* unpack_update_diff(boost::shared_ptr<slave::Table> table,
+                                  slave::RecordSet& _record_set,
+                                  const Row_event_info& roi,
+                                  unsigned char* row)
+{
+    const unsigned int field_count = table->fields.size();
+
+    if (roi.m_width != field_count) {
+        LOG_ERROR(log, "Field count mismatch in unpacking row for "
+                  << table->full_name << ": " << roi.m_width << " != " << field_count);
+        return NULL;
+    }
+
+    const std::vector<unsigned char>& cols_ai = roi.m_cols_ai.empty() ? roi.m_cols : roi.m_cols_ai;
+
+    // Before image: where its values are. The after image starts after it.
+    std::vector<Raw_value> before(field_count);
+
+    const unsigned char* null_ptr = row;
+    const char* ptr = (const char*)row + (n_set_bits(roi.m_cols, field_count) + 7) / 8;
+    unsigned int null_bit = 0;
+
+    for (unsigned int i = 0; i < field_count; ++i) {
+
+        Raw_value& v = before[i];
+
+        v.present = roi.m_cols[i / 8] & (1 << (i & 7));
+
+        if (!v.present)
+            continue;
+
+        v.is_null = null_ptr[null_bit / 8] & (1 << (null_bit & 7));
+        ++null_bit;
+
+        v.begin = ptr;
+        if (!v.is_null)
+            ptr = table->fields[i]->skip(ptr);
+        v.end = ptr;
+    }
+
+    null_ptr = (const unsigned char*)ptr;
+    ptr += (n_set_bits(cols_ai, field_count) + 7) / 8;
+    null_bit = 0;
+
+    for (unsigned int i = 0; i < field_count; ++i) {
+
+        slave::PtrField field = table->fields[i];
+        const Raw_value& old = before[i];
+        const bool key = table->isPrimary(i);
+
+        bool changed = false;
+
+        if (cols_ai[i / 8] & (1 << (i & 7))) {
+
+            const bool is_null = null_ptr[null_bit / 8] & (1 << (null_bit & 7));
+            ++null_bit;
+
+            const char* begin = ptr;
+            if (!is_null)
+                ptr = field->skip(ptr);
+
+            // As in unpack_row(), a bad field is skipped but not given
+            if (field->is_bad)
+                continue;
+
+            changed = !old.present || old.is_null != is_null ||
+                old.end - old.begin != ptr - begin || ::memcmp(old.begin, begin, ptr - begin) != 0;
+
+            if ((changed || key) && !is_null) {
+                field->unpack(begin);
+                _record_set.m_row[field->getFieldName()] = std::make_pair(field->field_type, field->field_data);
+            }
+        }
+
+        if ((changed || key) && old.present && !old.is_null && !field->is_bad) {
+            field->unpack(old.begin);
+            _record_set.m_old_row[field->getFieldName()] = std::make_pair(field->field_type, field->field_data);
+        }
+    }
+
+    return (unsigned char*)ptr;
+}
+
+
 unsigned char* do_writedelete_row(boost::shared_ptr<slave::Table> table, 
                                   const Basic_event_info& bei,
                                   const Row_event_info& roi, 
@@ -383,9 +753,18 @@ unsigned char* do_writedelete_row(boost::shared_ptr<slave::Table> table,
     _record_set.when = bei.when;
     _record_set.tbl_name = table->table_name;
     _record_set.db_name = table->database_name;
-    _record_set.type_event = (bei.type == WRITE_ROWS_EVENT ? slave::RecordSet::Write : slave::RecordSet::Delete);
+    _record_set.type_event = (is_write_rows_event(bei.type) ? slave::RecordSet::Write : slave::RecordSet::Delete);
     _record_set.master_id = bei.server_id;
 
+    if (table->m_coalescer) {
+
+        std::string key;
+        image_key(*table, row_start, roi.m_cols, key);
+
+        table->m_coalescer->add(table, _record_set, key, key);
+        return t;
+    }
+
     table->call_callback(_record_set, ext_state);
 
     return t;
@@ -399,13 +778,22 @@ unsigned char* do_update_row(boost::shared_ptr<slave::Table> table,
 
     slave::RecordSet _record_set;
 
-    unsigned char* t = unpack_row(table, _record_set.m_old_row, roi.m_width, row_start, roi.m_cols, roi.m_cols_ai);
+    unsigned char* t;
 
-    if (t == NULL) {
-        return NULL;
-    }
+    if (table->m_update_diff) {
+
+        t = unpack_update_diff(table, _record_set, roi, row_start);
+
+    } else {
 
-    t = unpack_row(table, _record_set.m_row, roi.m_width, t, roi.m_cols, roi.m_cols_ai);
+        t = unpack_row(table, _record_set.m_old_row, roi.m_width, row_start, roi.m_cols, roi.m_cols_ai);
+
+        if (t == NULL) {
+            return NULL;
+        }
+
+        t = unpack_row(table, _record_set.m_row, roi.m_width, t, roi.m_cols, roi.m_cols_ai);
+    }
 
     if (t == NULL) {
         return NULL;
@@ -417,12 +805,144 @@ unsigned char* do_update_row(boost::shared_ptr<slave::Table> table,
     _record_set.type_event = slave::RecordSet::Update;
     _record_set.master_id = bei.server_id;
 
+    if (table->m_coalescer) {
+
+        std::string key, key_after;
+        const unsigned char* after = image_key(*table, row_start, roi.m_cols, key);
+        image_key(*table, after, roi.m_cols_ai.empty() ? roi.m_cols : roi.m_cols_ai, key_after);
+
+        table->m_coalescer->add(table, _record_set, key, key_after);
+        return t;
+    }
+
     table->call_callback(_record_set, ext_state);
 
     return t;
 }
 
 
+// Rows of the tables with a RowHandler
+void handle_rows(slave::Table& table, const Basic_event_info& bei, const Row_event_info& roi, ExtStateIface &ext_state) {
+
+    if (roi.m_width != table.fields.size()) {
+        LOG_ERROR(log, "Field count mismatch in unpacking row for "
+                  << table.full_name << ": " << roi.m_width << " != " << table.fields.size());
+        return;
+    }
+
+    slave::RowHandler& handler = *table.m_row_handler;
+    slave::TableCounters* stats = table.m_stats.get();
+
+    const unsigned char* row_start = roi.m_rows_buf;
+
+    while (row_start < roi.m_rows_end && row_start != NULL) {
+
+        ext_state.incTableCount(table.full_name);
+        ext_state.setLastFilteredUpdateTime();
+
+        // The handler decodes the row itself: all of it is callback time
+        const unsigned long long start = stats ? slave::now_nsec() : 0;
+
+        if (is_update_rows_event(bei.type)) {
+
+            row_start = handler.onRow(table, slave::RowHandler::UpdateBefore, row_start, roi.m_cols, bei.when, bei.server_id);
+
+            if (row_start != NULL)
+                row_start = handler.onRow(table, slave::RowHandler::UpdateAfter, row_start, roi.m_cols_ai, bei.when, bei.server_id);
+
+        } else {
+
+            const slave::RowHandler::Image image = is_write_rows_event(bei.type) ? slave::RowHandler::Write : slave::RowHandler::Delete;
+
+            row_start = handler.onRow(table, image, row_start, roi.m_cols, bei.when, bei.server_id);
+        }
+
+        if (stats)
+            stats->row(slave::now_nsec() - start);
+    }
+}
+
+
+// Rows of a table with Slave::setFixedCallback(): no fields, no RecordSet.
+void handle_fixed_rows(slave::Table& table, const Basic_event_info& bei, const Row_event_info& roi, ExtStateIface &ext_state) {
+
+    if (!table.m_fixed_layout) {
+        LOG_ERROR(log, "Table " << table.full_name << " is not fixed-width any more, skipping its rows");
+        return;
+    }
+
+    const slave::FixedLayout& layout = *table.m_fixed_layout;
+    const size_t count = layout.count();
+
+    if (roi.m_width != count) {
+        LOG_ERROR(log, "Field count mismatch in unpacking row for "
+                  << table.full_name << ": " << roi.m_width << " != " << count);
+        return;
+    }
+
+    const bool update = is_update_rows_event(bei.type);
+    const bool full = layout.isFull(roi.m_cols);
+    const bool full_ai = update && layout.isFull(roi.m_cols_ai);
+
+    std::vector<long long> values(count * 2 + 1);
+    std::vector<unsigned char> nulls(((count + 7) / 8) * 2 + 1);
+
+    slave::FixedRow row;
+    row.type_event = update ? slave::RecordSet::Update :
+                     is_write_rows_event(bei.type) ? slave::RecordSet::Write : slave::RecordSet::Delete;
+    row.when = bei.when;
+    row.master_id = bei.server_id;
+    row.count = count;
+    row.old_values = NULL;
+    row.old_nulls = NULL;
+
+    long long* const new_values = &values[0];
+    long long* const old_values = &values[count];
+    unsigned char* const new_nulls = &nulls[0];
+    unsigned char* const old_nulls = &nulls[(count + 7) / 8];
+
+    const unsigned char* row_start = roi.m_rows_buf;
+
+    while (row_start < roi.m_rows_end) {
+
+        bool has_nulls = false;
+
+        if (update) {
+
+            row_start = layout.decode(row_start, roi.m_rows_end, roi.m_cols, full, old_values, old_nulls, has_nulls);
+            row.old_values = old_values;
+            row.old_nulls = has_nulls ? old_nulls : NULL;
+
+            if (row_start != NULL)
+                row_start = layout.decode(row_start, roi.m_rows_end, roi.m_cols_ai, full_ai, new_values, new_nulls, has_nulls);
+
+        } else {
+            row_start = layout.decode(row_start, roi.m_rows_end, roi.m_cols, full, new_values, new_nulls, has_nulls);
+        }
+
+        if (row_start == NULL) {
+            LOG_ERROR(log, "Row image goes past the end of the event for " << table.full_name);
+            return;
+        }
+
+        row.values = new_values;
+        row.nulls = has_nulls ? new_nulls : NULL;
+
+        ext_state.incTableCount(table.full_name);
+        ext_state.setLastFilteredUpdateTime();
+
+        if (!table.m_stats) {
+            table.m_fixed_callback(row);
+            continue;
+        }
+
+        const unsigned long long start = slave::now_nsec();
+        table.m_fixed_callback(row);
+        table.m_stats->row(slave::now_nsec() - start);
+    }
+}
+
+
 void apply_row_event(slave::RelayLogInfo& rli, const Basic_event_info& bei, const Row_event_info& roi, ExtStateIface &ext_state) {
 
 
@@ -436,24 +956,159 @@ void apply_row_event(slave::RelayLogInfo& rli, const Basic_event_info& bei, cons
 
         LOG_DEBUG(log, "Table " << table->database_name << "." << table->table_name << " has callback.");
 
+        ext_state.addTableBytes(table->full_name, bei.event_len);
+
+        const unsigned long long start = table->m_stats ? slave::now_nsec() : 0;
+
+        if (table->m_fixed_callback) {
+            handle_fixed_rows(*table, bei, roi, ext_state);
+
+        } else if (table->m_row_handler) {
+            handle_rows(*table, bei, roi, ext_state);
 
-        unsigned char* row_start = roi.m_rows_buf;
+        } else {
+
+            unsigned char* row_start = roi.m_rows_buf;
 
-        while (row_start < roi.m_rows_end && 
-               row_start != NULL) {
+            while (row_start < roi.m_rows_end && 
+                   row_start != NULL) {
 
-            if (bei.type == UPDATE_ROWS_EVENT) {
+                if (is_update_rows_event(bei.type)) {
 
-                row_start = do_update_row(table, bei, roi, row_start, ext_state);
+                    row_start = do_update_row(table, bei, roi, row_start, ext_state);
 
-            } else {
-                row_start = do_writedelete_row(table, bei, roi, row_start, ext_state);
+                } else {
+                    row_start = do_writedelete_row(table, bei, roi, row_start, ext_state);
+                }
             }
         }
+
+        // Decoding is what the callbacks did not take
+        if (table->m_stats)
+            table->m_stats->event(bei.event_len, slave::now_nsec() - start);
     }
 }
 
 
+const unsigned char* unpack_row_to(const Table& table, const unsigned char* row,
+                                   const std::vector<unsigned char>& cols, Row_sink& sink) {
+
+    const unsigned int field_count = table.fields.size();
+
+    if (cols.size() < (field_count + 7) / 8) {
+        LOG_ERROR(log, "Column bitmap is too short for " << table.full_name);
+        return NULL;
+    }
+
+    const unsigned char* null_ptr = row;
+    const unsigned char* ptr = row + (n_set_bits(cols, field_count) + 7) / 8;
+
+    unsigned int null_bit = 0;
+
+    for (unsigned int i = 0; i < field_count; ++i) {
+
+        if (!(cols[i / 8] & (1 << (i & 7)))) {
+            sink.column(i, false, false);
+            continue;
+        }
+
+        // Only the present columns have a null bit
+        const bool is_null = null_ptr[null_bit / 8] & (1 << (null_bit & 7));
+        ++null_bit;
+
+        sink.column(i, true, is_null);
+
+        if (!is_null)
+            ptr = (const unsigned char*)table.fields[i]->unpack_to((const char*)ptr, sink);
+    }
+
+    return ptr;
+}
+
+
+namespace
+{
+
+// A field for the column of 'field' in the given storage; NULL if 'field' already has it
+template <typename Old, typename New>
+PtrField fit_storage(const Field* field, bool fractional, unsigned int fsp) {
+
+    const New* current = dynamic_cast<const New*>(field);
+
+    if (!fractional) {
+        return current ? PtrField(new Old(field->field_name, field->field_type)) : PtrField();
+    }
+
+    if (current && current->fsp == fsp)
+        return PtrField();
+
+    New* fitted = new New(field->field_name, field->field_type);
+    fitted->fsp = fsp;
+
+    return PtrField(fitted);
+}
+
+}// anonymous-namespace
+
+
+bool fit_temporal_storage(Table& table, const Table_map_event_info& tmi) {
+
+    bool changed = false;
+
+    for (size_t i = 0; i < table.fields.size() && i < tmi.m_column_types.size(); ++i) {
+
+        const Field* field = table.fields[i].get();
+        const unsigned char type = tmi.m_column_types[i];
+        const unsigned int meta = i < tmi.m_column_meta.size() ? tmi.m_column_meta[i] : 0;
+        const unsigned int fsp = meta <= 6 ? meta : 0;
+
+        PtrField fitted;
+
+        switch (type) {
+        case 7:     // TIMESTAMP
+        case 17:    // TIMESTAMP2
+            if (dynamic_cast<const Field_timestamp*>(field))
+                fitted = fit_storage<Field_timestamp, Field_timestamp2>(field, type == 17, fsp);
+            break;
+        case 12:    // DATETIME
+        case 18:    // DATETIME2
+            if (dynamic_cast<const Field_datetime*>(field))
+                fitted = fit_storage<Field_datetime, Field_datetime2>(field, type == 18, fsp);
+            break;
+        case 11:    // TIME
+        case 19:    // TIME2
+            if (dynamic_cast<const Field_time*>(field))
+                fitted = fit_storage<Field_time, Field_time2>(field, type == 19, fsp);
+            break;
+        default:
+            break;
+        }
+
+        if (!fitted)
+            continue;
+
+        LOG_INFO(log, "Column " << table.full_name << "." << field->field_name << " is stored as binlog type "
+                 << (unsigned int)type << ", not as guessed from the master version");
+
+        const Field_temporal* temporal = dynamic_cast<const Field_temporal*>(field);
+
+        if (temporal)
+            static_cast<Field_temporal&>(*fitted).copyEpoch(*temporal);
+
+        table.fields[i] = fitted;
+
+        if (i < table.column_types.size())
+            table.column_types[i] = type;
+
+        changed = true;
+    }
+
+    if (changed)
+        table.m_fixed_layout = FixedLayout::make(table.fields);
+
+    return changed;
+}
+
 
 } // namespace
 
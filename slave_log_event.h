@@ -63,6 +63,29 @@ enum Log_event_type
 
   INCIDENT_EVENT = 26,
 
+  HEARTBEAT_LOG_EVENT = 27,
+
+  IGNORABLE_LOG_EVENT = 28,
+  ROWS_QUERY_LOG_EVENT = 29,
+
+  // MySQL 5.6+ row events, with the extra-data block in the post-header
+  WRITE_ROWS_EVENT_V2 = 30,
+  UPDATE_ROWS_EVENT_V2 = 31,
+  DELETE_ROWS_EVENT_V2 = 32,
+
+  GTID_LOG_EVENT = 33,
+  ANONYMOUS_GTID_LOG_EVENT = 34,
+  PREVIOUS_GTIDS_LOG_EVENT = 35,
+
+  // MySQL 5.7+
+  TRANSACTION_CONTEXT_EVENT = 36,
+  VIEW_CHANGE_EVENT = 37,
+  XA_PREPARE_LOG_EVENT = 38,
+
+  // MySQL 8.0+
+  PARTIAL_UPDATE_ROWS_EVENT = 39,
+  TRANSACTION_PAYLOAD_EVENT = 40,
+
   ENUM_END_EVENT
 };
 
@@ -91,6 +114,12 @@ enum Log_event_type
 #define RW_MAPID_OFFSET    0
 #define ROWS_HEADER_LEN        8
 
+#define ROWS_HEADER_LEN_V2     10
+#define RW_V_EXTRAINFO_OFFSET  8
+
+#define GTID_ENCODED_SID_LENGTH 16
+#define GTID_HEADER_LEN        (1 + GTID_ENCODED_SID_LENGTH + 8)
+
 #define LOG_EVENT_MINIMAL_HEADER_LEN 19
 
 #define ST_SERVER_VER_LEN 50
@@ -101,6 +130,17 @@ enum Log_event_type
 #define START_V3_HEADER_LEN     (2 + ST_SERVER_VER_LEN + 4)
 #define FORMAT_DESCRIPTION_HEADER_LEN (START_V3_HEADER_LEN + 1 + LOG_EVENT_TYPES)
 
+#define BINLOG_CHECKSUM_LEN           4
+#define BINLOG_CHECKSUM_ALG_DESC_LEN  1
+
+// Values of @@binlog_checksum as they are stored in the Format_description event.
+enum Binlog_checksum_alg
+{
+  BINLOG_CHECKSUM_ALG_OFF = 0,
+  BINLOG_CHECKSUM_ALG_CRC32 = 1,
+  BINLOG_CHECKSUM_ALG_UNDEF = 255
+};
+
 
 
 
@@ -147,9 +187,44 @@ struct Table_map_event_info {
     std::string m_tblnam;
     std::string m_dbnam;
 
+    // enum_field_types of the columns
+    std::vector<unsigned char> m_column_types;
+
+    // Metadata of each column, 0 for the types without it: fsp of TIMESTAMP2, DATETIME2 and
+    // TIME2, precision << 8 | scale of NEWDECIMAL... Empty if the event has none.
+    std::vector<unsigned int> m_column_meta;
+
     Table_map_event_info(const char* buf, unsigned int event_len);
 };
 
+struct Gtid_event_info {
+
+    bool commit_flag;
+    unsigned char sid[GTID_ENCODED_SID_LENGTH];
+    long long gno;
+
+    // MySQL 8.0: commit time on the originating master, microseconds; 0 if not known
+    unsigned long long commit_ts;
+
+    Gtid_event_info(const char* buf, unsigned int event_len);
+};
+
+inline bool is_write_rows_event(Log_event_type type) {
+    return type == WRITE_ROWS_EVENT || type == WRITE_ROWS_EVENT_V2;
+}
+
+inline bool is_update_rows_event(Log_event_type type) {
+    return type == UPDATE_ROWS_EVENT || type == UPDATE_ROWS_EVENT_V2;
+}
+
+inline bool is_delete_rows_event(Log_event_type type) {
+    return type == DELETE_ROWS_EVENT || type == DELETE_ROWS_EVENT_V2;
+}
+
+inline bool is_rows_event_v2(Log_event_type type) {
+    return type == WRITE_ROWS_EVENT_V2 || type == UPDATE_ROWS_EVENT_V2 || type == DELETE_ROWS_EVENT_V2;
+}
+
 struct Row_event_info {
 
     unsigned long m_width;
@@ -163,15 +238,40 @@ struct Row_event_info {
 
     bool has_after_image;
 
-    Row_event_info(const char* buf, unsigned int event_len, bool do_update);
+    Row_event_info(const char* buf, unsigned int event_len, bool do_update, bool v2 = false);
 };
 
 
-bool read_log_event(const char* buf, unsigned int event_len, Basic_event_info& info);
+// checksum_alg -- algorithm of the events in the stream. Initially it is what was negotiated
+// through @master_binlog_checksum, then every Format_description event updates it.
+// The checksum trailer is stripped from info.event_len; it is verified if verify_checksum is set.
+bool read_log_event(const char* buf, unsigned int event_len, Basic_event_info& info,
+                    unsigned char& checksum_alg, bool verify_checksum);
 
 void apply_row_event(slave::RelayLogInfo& rli, const Basic_event_info& bei, const Row_event_info& roi, ExtStateIface &ext_state);
 
 
+// Gets the columns of a row image one by one, see unpack_row_to().
+class Row_sink: public Value_sink {
+public:
+    // Comes for every column of the table, in order. The value follows
+    // if the column is in the image and is not NULL.
+    virtual void column(unsigned int i, bool present, bool is_null) = 0;
+};
+
+// Decodes a row image of 'table', with the columns set in 'cols', into 'sink'.
+// Returns the end of the image, or NULL if the image does not fit the table.
+const unsigned char* unpack_row_to(const Table& table, const unsigned char* row,
+                                   const std::vector<unsigned char>& cols, Row_sink& sink);
+
+// Makes the TIMESTAMP, DATETIME and TIME fields of 'table' anew where the storage the event has
+// for them (old, or 5.6.4+ with fractional seconds) is not the one guessed from the master version:
+// tables made before an upgrade and those of avoid_temporal_upgrade keep the old one. The fsp comes
+// from the event too, and so does the column type checked by Slave::checkTable().
+// Returns true if some field was replaced.
+bool fit_temporal_storage(Table& table, const Table_map_event_info& tmi);
+
+
 //------------------------------------------------------------------------------------------
 
 
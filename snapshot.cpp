@@ -0,0 +1,677 @@
+/* Copyright 2011 ZAO "Begun".
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3 of the License, or (at your option)
+ * any later version.
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * Initial load of the watched tables, consistent with a binlog position.
+ *
+ * Under FLUSH TABLES WITH READ LOCK every worker connection opens a consistent
+ * snapshot transaction and the binlog position is read; then the lock is released
+ * and the workers read the tables in primary key order, chunk by chunk. Tables
+ * with an integer primary key are also split into key ranges, one per worker.
+ */
+
+#include <pthread.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <deque>
+#include <sstream>
+
+#include "Slave.h"
+#include "mutex_lock.h"
+#include "Logging.h"
+
+
+namespace
+{
+
+using slave::PtrTable;
+using slave::PtrField;
+using slave::MutexLock;
+
+
+std::string quote_name(const std::string& name) {
+
+    std::string ret = "`";
+
+    for (std::string::const_iterator i = name.begin(); i != name.end(); ++i) {
+        if (*i == '`')
+            ret += '`';
+        ret += *i;
+    }
+
+    return ret + "`";
+}
+
+
+class SnapshotConnection {
+
+    MYSQL* m_conn;
+
+    void throw_error(const std::string& what) {
+        throw std::runtime_error("Slave::snapshot(): " + what + ": " + ::mysql_error(m_conn));
+    }
+
+public:
+
+    SnapshotConnection(const slave::MasterInfo& mi) : m_conn(::mysql_init(NULL)) {
+
+        if (m_conn == NULL)
+            throw std::runtime_error("Slave::snapshot(): mysql_init() failed");
+
+        if (::mysql_real_connect(m_conn, mi.host.c_str(), mi.user.c_str(), mi.password.c_str(),
+                                 NULL, mi.port, NULL, 0) == NULL) {
+            const std::string err = ::mysql_error(m_conn);
+            ::mysql_close(m_conn);
+            throw std::runtime_error("Slave::snapshot(): mysql_real_connect() failed: " + err);
+        }
+    }
+
+    ~SnapshotConnection() {
+        ::mysql_close(m_conn);
+    }
+
+    void query(const std::string& q) {
+
+        if (::mysql_real_query(m_conn, q.data(), q.size()) != 0)
+            throw_error(q);
+    }
+
+    // Caller frees the result
+    MYSQL_RES* use_result() {
+
+        MYSQL_RES* res = ::mysql_use_result(m_conn);
+
+        if (res == NULL)
+            throw_error("mysql_use_result() failed");
+
+        return res;
+    }
+
+    void check_fetch() {
+
+        if (::mysql_errno(m_conn) != 0)
+            throw_error("mysql_fetch_row() failed");
+    }
+
+    std::string escape(const char* from, unsigned long len) {
+
+        std::string ret(len * 2 + 1, '\0');
+        ret.resize(::mysql_real_escape_string(m_conn, &ret[0], from, len));
+        return ret;
+    }
+
+    // First column of the first row, or false if there is none or it is NULL.
+    bool query_value(const std::string& q, std::string& value) {
+
+        query(q);
+
+        MYSQL_RES* res = use_result();
+
+        MYSQL_ROW row = ::mysql_fetch_row(res);
+        const bool ret = (row != NULL && row[0] != NULL);
+
+        if (ret)
+            value.assign(row[0], ::mysql_fetch_lengths(res)[0]);
+
+        // Drain the rest
+        while (row != NULL)
+            row = ::mysql_fetch_row(res);
+
+        ::mysql_free_result(res);
+
+        return ret;
+    }
+
+    MYSQL* get() { return m_conn; }
+};
+
+
+struct ResultHolder {
+    MYSQL_RES* res;
+    ResultHolder(MYSQL_RES* _res) : res(_res) {}
+    ~ResultHolder() { ::mysql_free_result(res); }
+};
+
+
+// A primary key column, and how to write its values in a condition
+struct KeyColumn {
+
+    std::string name;
+
+    // Numbers go unquoted, not compared as strings
+    bool numeric;
+
+    // Strings are compared under the column's collation; empty for binary ones
+    slave::collate_info collate;
+
+    KeyColumn() : numeric(false) {}
+};
+
+
+// A table, or a key range of it
+struct SnapshotItem {
+
+    PtrTable table;
+
+    // Primary key columns, in the index order; empty if the table has none
+    std::vector<KeyColumn> pk;
+
+    // Extra condition for a key range
+    std::string range;
+};
+
+
+struct SnapshotContext {
+
+    slave::ExtStateIface& ext_state;
+    unsigned int chunk_rows;
+    time_t when;
+
+    // Masters before 5.7.3 do not use an index for (a, b) > (x, y)
+    bool row_constructor;
+
+    // Guards all below, and calls of the callbacks.
+    pthread_mutex_t lock;
+
+    std::deque<SnapshotItem> items;
+
+    // Items left for each table, to know when to send PostInit.
+    std::map<slave::Table*, unsigned int> pending;
+
+    std::string error;
+
+    SnapshotContext(slave::ExtStateIface& _ext_state, unsigned int _chunk_rows) :
+        ext_state(_ext_state), chunk_rows(_chunk_rows), when(::time(NULL)), row_constructor(true) {
+        ::pthread_mutex_init(&lock, NULL);
+    }
+
+    ~SnapshotContext() {
+        ::pthread_mutex_destroy(&lock);
+    }
+};
+
+
+void call_callback(SnapshotContext& ctx, slave::Table& table, slave::RecordSet& rs) {
+
+    rs.when = ctx.when;
+    rs.tbl_name = table.table_name;
+    rs.db_name = table.database_name;
+
+    table.call_callback(rs, ctx.ext_state);
+}
+
+
+// A key value as it was read, for a condition. The connection is SET NAMES binary,
+// so a string literal needs the column's charset and collation not to compare as bytes.
+std::string key_literal(SnapshotConnection& conn, const KeyColumn& column, const std::string& value) {
+
+    if (column.numeric)
+        return value;
+
+    const std::string literal = "'" + conn.escape(value.data(), value.size()) + "'";
+
+    if (column.collate.name.empty())
+        return literal;
+
+    return "_" + column.collate.charset + literal + " COLLATE " + column.collate.name;
+}
+
+
+// The rows after 'values' in the key order. Without the row constructor it is
+// a >= x AND (a > x OR a = x AND b > y), the first part for the range optimizer.
+std::string after_key(SnapshotConnection& conn, const std::vector<KeyColumn>& pk,
+                      const std::vector<std::string>& values, bool row_constructor) {
+
+    std::vector<std::string> names, literals;
+
+    for (size_t i = 0; i < pk.size(); ++i) {
+        names.push_back(quote_name(pk[i].name));
+        literals.push_back(key_literal(conn, pk[i], values[i]));
+    }
+
+    if (pk.size() == 1)
+        return names[0] + " > " + literals[0];
+
+    if (row_constructor) {
+
+        std::string left, right;
+
+        for (size_t i = 0; i < pk.size(); ++i) {
+            if (i != 0) {
+                left += ", ";
+                right += ", ";
+            }
+            left += names[i];
+            right += literals[i];
+        }
+
+        return "(" + left + ") > (" + right + ")";
+    }
+
+    std::string ret = names[0] + " >= " + literals[0] + " AND (";
+
+    for (size_t i = 0; i < pk.size(); ++i) {
+
+        if (i != 0)
+            ret += " OR ";
+
+        ret += "(";
+
+        for (size_t k = 0; k < i; ++k)
+            ret += names[k] + " = " + literals[k] + " AND ";
+
+        ret += names[i] + " > " + literals[i] + ")";
+    }
+
+    return ret + ")";
+}
+
+
+void read_item(SnapshotContext& ctx, SnapshotConnection& conn, const SnapshotItem& item) {
+
+    slave::Table& table = *item.table;
+
+    std::string select = "SELECT ";
+
+    for (std::vector<PtrField>::const_iterator i = table.fields.begin(); i != table.fields.end(); ++i)
+        select += (*i)->select_expr() + ", ";
+
+    // The key as it is, for the next chunk's condition
+    std::string order;
+
+    for (std::vector<KeyColumn>::const_iterator i = item.pk.begin(); i != item.pk.end(); ++i) {
+        if (!order.empty())
+            order += ", ";
+        order += quote_name(i->name);
+    }
+
+    select += order.empty() ? std::string("1") : order;
+    select += " FROM " + quote_name(table.database_name) + "." + quote_name(table.table_name);
+
+    const size_t nfields = table.fields.size();
+    std::vector<std::string> last_key(item.pk.size());
+    bool have_last_key = false;
+
+    while (true) {
+
+        std::string q = select;
+        std::string where = item.range;
+
+        if (have_last_key) {
+
+            if (!where.empty())
+                where += " AND ";
+
+            where += after_key(conn, item.pk, last_key, ctx.row_constructor);
+        }
+
+        if (!where.empty())
+            q += " WHERE " + where;
+
+        if (!item.pk.empty()) {
+            std::ostringstream limit;
+            limit << " ORDER BY " << order << " LIMIT " << ctx.chunk_rows;
+            q += limit.str();
+        }
+
+        LOG_TRACE(log, "Snapshot query: " << q);
+
+        conn.query(q);
+        ResultHolder res(conn.use_result());
+
+        unsigned int rows = 0;
+
+        while (MYSQL_ROW row = ::mysql_fetch_row(res.res)) {
+
+            const unsigned long* lens = ::mysql_fetch_lengths(res.res);
+
+            for (size_t i = 0; i < last_key.size(); ++i)
+                last_key[i].assign(row[nfields + i], lens[nfields + i]);
+
+            ++rows;
+
+            slave::RecordSet rs;
+            rs.type_event = slave::RecordSet::PreInit;
+
+            // Field objects and the callbacks are shared with the other workers
+            MutexLock guard(ctx.lock);
+
+            for (size_t i = 0; i < nfields; ++i) {
+
+                if (row[i] == NULL)
+                    continue;
+
+                PtrField field = table.fields[i];
+
+                field->unpack_str(row[i], lens[i]);
+
+                if (!field->is_bad)
+                    rs.m_row[field->getFieldName()] = std::make_pair(field->field_type, field->field_data);
+            }
+
+            call_callback(ctx, table, rs);
+        }
+
+        conn.check_fetch();
+
+        if (item.pk.empty() || rows < ctx.chunk_rows)
+            break;
+
+        have_last_key = true;
+    }
+}
+
+
+void* snapshot_worker(SnapshotContext& ctx, SnapshotConnection& conn) {
+
+    while (true) {
+
+        SnapshotItem item;
+
+        {
+            MutexLock guard(ctx.lock);
+
+            if (ctx.items.empty() || !ctx.error.empty())
+                return NULL;
+
+            item = ctx.items.front();
+            ctx.items.pop_front();
+        }
+
+        try {
+
+            read_item(ctx, conn, item);
+
+        } catch (const std::exception& e) {
+
+            MutexLock guard(ctx.lock);
+
+            if (ctx.error.empty())
+                ctx.error = e.what();
+
+            return NULL;
+        }
+
+        MutexLock guard(ctx.lock);
+
+        if (--ctx.pending[item.table.get()] == 0) {
+
+            LOG_INFO(log, "Snapshot of " << item.table->full_name << " done.");
+
+            slave::RecordSet rs;
+            rs.type_event = slave::RecordSet::PostInit;
+
+            call_callback(ctx, *item.table, rs);
+        }
+    }
+}
+
+
+struct WorkerArgs {
+    SnapshotContext* ctx;
+    SnapshotConnection* conn;
+};
+
+extern "C" void* snapshot_thread(void* arg) {
+
+    WorkerArgs* args = (WorkerArgs*)arg;
+    return snapshot_worker(*args->ctx, *args->conn);
+}
+
+
+bool is_integer_field(const PtrField& field) {
+
+    return dynamic_cast<slave::Field_tiny*>(field.get()) ||
+        dynamic_cast<slave::Field_short*>(field.get()) ||
+        dynamic_cast<slave::Field_medium*>(field.get()) ||
+        dynamic_cast<slave::Field_long*>(field.get()) ||
+        dynamic_cast<slave::Field_longlong*>(field.get());
+}
+
+
+// Splits a table with an integer primary key into 'parts' key ranges.
+void add_items(SnapshotContext& ctx, SnapshotConnection& conn, const SnapshotItem& table_item, unsigned int parts) {
+
+    std::vector<SnapshotItem> items(1, table_item);
+
+    const std::vector<PtrField>& fields = table_item.table->fields;
+    PtrField pk_field;
+
+    if (table_item.pk.size() == 1) {
+        for (std::vector<PtrField>::const_iterator i = fields.begin(); i != fields.end(); ++i) {
+            if ((*i)->field_name == table_item.pk[0].name)
+                pk_field = *i;
+        }
+    }
+
+    std::string min_str, max_str;
+
+    if (parts > 1 && pk_field && is_integer_field(pk_field)) {
+
+        const std::string pk = quote_name(table_item.pk[0].name);
+        const std::string from = quote_name(table_item.table->database_name) + "." +
+            quote_name(table_item.table->table_name);
+
+        if (conn.query_value("SELECT MIN(" + pk + ") FROM " + from, min_str) &&
+            conn.query_value("SELECT MAX(" + pk + ") FROM " + from, max_str)) {
+
+            errno = 0;
+            const long long min = ::strtoll(min_str.c_str(), NULL, 10);
+            const long long max = ::strtoll(max_str.c_str(), NULL, 10);
+
+            const unsigned long long span = (unsigned long long)max - (unsigned long long)min;
+
+            // Not worth splitting small tables, and beyond LLONG_MAX things get complicated
+            if (errno == 0 && max >= min && span / parts >= ctx.chunk_rows) {
+
+                const unsigned long long step = span / parts + 1;
+
+                items.clear();
+
+                for (unsigned int k = 0; k < parts; ++k) {
+
+                    SnapshotItem item = table_item;
+                    std::ostringstream range;
+
+                    if (k != 0)
+                        range << pk << " >= " << (long long)(min + k * step);
+
+                    if (k != 0 && k + 1 != parts)
+                        range << " AND ";
+
+                    if (k + 1 != parts)
+                        range << pk << " < " << (long long)(min + (k + 1) * step);
+
+                    item.range = range.str();
+                    items.push_back(item);
+                }
+            }
+        }
+    }
+
+    ctx.pending[table_item.table.get()] = items.size();
+    ctx.items.insert(ctx.items.end(), items.begin(), items.end());
+}
+
+
+std::vector<KeyColumn> primary_key(SnapshotConnection& conn, const slave::Table& table) {
+
+    conn.query("SHOW INDEX FROM " + quote_name(table.table_name) + " IN " + quote_name(table.database_name));
+
+    ResultHolder res(conn.use_result());
+
+    // Columns: Table, Non_unique, Key_name, Seq_in_index, Column_name, ...
+    std::map<unsigned int, std::string> columns;
+
+    while (MYSQL_ROW row = ::mysql_fetch_row(res.res)) {
+        if (row[2] && std::string(row[2]) == "PRIMARY" && row[3] && row[4])
+            columns[::atoi(row[3])] = row[4];
+    }
+
+    conn.check_fetch();
+
+    std::vector<KeyColumn> ret;
+
+    for (std::map<unsigned int, std::string>::const_iterator i = columns.begin(); i != columns.end(); ++i) {
+
+        KeyColumn column;
+        column.name = i->second;
+
+        for (std::vector<PtrField>::const_iterator f = table.fields.begin(); f != table.fields.end(); ++f) {
+            if ((*f)->field_name == column.name)
+                column.numeric = (dynamic_cast<slave::Field_num*>(f->get()) != NULL);
+        }
+
+        for (std::vector<slave::ColumnInfo>::const_iterator c = table.columns.begin(); c != table.columns.end(); ++c) {
+            if (c->name == column.name)
+                column.collate = c->collate;
+        }
+
+        ret.push_back(column);
+    }
+
+    return ret;
+}
+
+}// anonymous-namespace
+
+
+namespace slave
+{
+
+void Slave::snapshot(unsigned int threads, unsigned int chunk_rows) {
+
+    if (threads == 0)
+        threads = 1;
+
+    if (chunk_rows == 0)
+        chunk_rows = 1;
+
+    // The rows are read as text and go to RecordSets: a row handler or a fixed callback,
+    // which take binary row images, can not have them.
+    for (RelayLogInfo::name_to_table_t::const_iterator i = m_rli.m_table_map.begin(); i != m_rli.m_table_map.end(); ++i) {
+
+        const Table& table = *i->second;
+
+        if (table.m_row_handler || table.m_fixed_callback || !table.m_callback)
+            throw std::runtime_error("Slave::snapshot(): " + table.full_name + " has no callback; "
+                                     "tables with a row handler or a fixed callback can not be snapshotted");
+    }
+
+    LOG_INFO(log, "Starting snapshot of " << m_rli.m_table_map.size() << " tables, " << threads << " threads.");
+
+    SnapshotContext ctx(ext_state, chunk_rows);
+    ctx.row_constructor = (m_master_version >= 50703);
+
+    std::vector<boost::shared_ptr<SnapshotConnection> > conns;
+
+    for (unsigned int i = 0; i < threads; ++i)
+        conns.push_back(boost::shared_ptr<SnapshotConnection>(new SnapshotConnection(m_master_info)));
+
+    std::string log_name;
+    unsigned long log_pos = 0;
+    std::string gtid_executed;
+
+    {
+        SnapshotConnection lock_conn(m_master_info);
+
+        lock_conn.query("FLUSH TABLES WITH READ LOCK");
+
+        for (unsigned int i = 0; i < threads; ++i) {
+            // The same bytes as in the binlog, without charset conversion
+            conns[i]->query("SET NAMES binary");
+            conns[i]->query("SET SESSION TRANSACTION ISOLATION LEVEL REPEATABLE READ");
+            conns[i]->query("START TRANSACTION WITH CONSISTENT SNAPSHOT");
+        }
+
+        lock_conn.query("SHOW MASTER STATUS");
+
+        {
+            ResultHolder res(lock_conn.use_result());
+
+            // Columns: File, Position, Binlog_Do_DB, Binlog_Ignore_DB[, Executed_Gtid_Set]
+            const unsigned int ncols = ::mysql_num_fields(res.res);
+            MYSQL_ROW row = ::mysql_fetch_row(res.res);
+
+            if (row == NULL || row[0] == NULL || row[1] == NULL)
+                throw std::runtime_error("Slave::snapshot(): SHOW MASTER STATUS is empty, is binary log enabled?");
+
+            log_name = row[0];
+            log_pos = ::strtoul(row[1], NULL, 10);
+
+            if (ncols >= 5 && row[4] != NULL)
+                gtid_executed = row[4];
+
+            while (row != NULL)
+                row = ::mysql_fetch_row(res.res);
+        }
+
+        lock_conn.query("UNLOCK TABLES");
+    }
+
+    LOG_INFO(log, "Snapshot position: " << log_name << ":" << log_pos);
+
+    for (RelayLogInfo::name_to_table_t::const_iterator i = m_rli.m_table_map.begin(); i != m_rli.m_table_map.end(); ++i) {
+
+        SnapshotItem item;
+        item.table = i->second;
+        item.pk = primary_key(*conns[0], *item.table);
+
+        if (item.pk.empty())
+            LOG_WARNING(log, "Slave::snapshot(): " << item.table->full_name << " has no primary key, reading it in one go.");
+
+        add_items(ctx, *conns[0], item, threads);
+    }
+
+    std::vector<WorkerArgs> args(threads);
+    std::vector<pthread_t> tids(threads);
+
+    unsigned int started = 0;
+
+    for (; started < threads; ++started) {
+
+        args[started].ctx = &ctx;
+        args[started].conn = conns[started].get();
+
+        if (::pthread_create(&tids[started], NULL, snapshot_thread, &args[started]) != 0) {
+            MutexLock guard(ctx.lock);
+            ctx.error = "pthread_create() failed";
+            break;
+        }
+    }
+
+    for (unsigned int i = 0; i < started; ++i)
+        ::pthread_join(tids[i], NULL);
+
+    if (!ctx.error.empty())
+        throw std::runtime_error("Slave::snapshot(): " + ctx.error);
+
+    // Streaming continues right from the snapshot.
+    m_master_info.master_log_name = log_name;
+    m_master_info.master_log_pos = log_pos;
+    ext_state.setMasterLogNamePos(log_name, log_pos);
+
+    if (!gtid_executed.empty()) {
+        m_gtid_executed = GtidSet(gtid_executed);
+        ext_state.setMasterGtidSet(m_gtid_executed);
+    }
+
+    ext_state.saveMasterInfo();
+
+    LOG_INFO(log, "Snapshot done.");
+}
+
+}// slave
@@ -0,0 +1,361 @@
+/* Copyright 2011 ZAO "Begun".
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3 of the License, or (at your option)
+ * any later version.
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __SLAVE_STRUCT_BINDING_H_
+#define __SLAVE_STRUCT_BINDING_H_
+
+#include <time.h>
+
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "recordset.h"
+#include "slave_log_event.h"
+
+
+/*
+ * Rows of a table decoded straight into a struct of the user's:
+ *
+ *     struct User { unsigned int id; std::string name; long long balance; };
+ *
+ *     boost::shared_ptr<slave::StructBinding<User> > users(new slave::StructBinding<User>(&onUser));
+ *     users->bind("id", &User::id).bind("name", &User::name).bind("balance", &User::balance);
+ *     slave.setRowHandler("db", "users", users);
+ *
+ * The members are checked against the columns when the table structure is read:
+ * createDatabaseStructure() throws if a column is missing, or its values do not fit
+ * the member (a string into an int, a BIGINT into an int, a signed INT into an
+ * unsigned one). Integers come sign extended, as the column is declared.
+ * NULL and the columns not in the row image leave the member as S() has it.
+ */
+
+namespace slave
+{
+
+// What a member can hold. Types with no Bound_type do not compile in bind().
+enum Bound_category { BOUND_INT, BOUND_FLOAT, BOUND_DOUBLE, BOUND_STRING };
+
+template <typename M>
+struct Bound_type;
+
+template <typename M, bool is_signed_ = ((M)-1 < 0)>
+struct Bound_int_type {
+    static const Bound_category category = BOUND_INT;
+    static const unsigned int bits = sizeof(M) * 8;
+    static const bool is_signed = is_signed_;
+};
+
+template <> struct Bound_type<char> : Bound_int_type<char> {};
+template <> struct Bound_type<signed char> : Bound_int_type<signed char> {};
+template <> struct Bound_type<unsigned char> : Bound_int_type<unsigned char> {};
+template <> struct Bound_type<short> : Bound_int_type<short> {};
+template <> struct Bound_type<unsigned short> : Bound_int_type<unsigned short> {};
+template <> struct Bound_type<int> : Bound_int_type<int> {};
+template <> struct Bound_type<unsigned int> : Bound_int_type<unsigned int> {};
+template <> struct Bound_type<long> : Bound_int_type<long> {};
+template <> struct Bound_type<unsigned long> : Bound_int_type<unsigned long> {};
+template <> struct Bound_type<long long> : Bound_int_type<long long> {};
+template <> struct Bound_type<unsigned long long> : Bound_int_type<unsigned long long> {};
+
+template <> struct Bound_type<float> {
+    static const Bound_category category = BOUND_FLOAT;
+    static const unsigned int bits = 0;
+    static const bool is_signed = true;
+};
+
+template <> struct Bound_type<double> {
+    static const Bound_category category = BOUND_DOUBLE;
+    static const unsigned int bits = 0;
+    static const bool is_signed = true;
+};
+
+template <> struct Bound_type<std::string> {
+    static const Bound_category category = BOUND_STRING;
+    static const unsigned int bits = 0;
+    static const bool is_signed = false;
+};
+
+// Only the ones the check in StructBinding::onTable() lets through are ever called
+template <typename M> inline void bound_set(M& m, long long v) { m = (M)v; }
+template <typename M> inline void bound_set(M& m, double v) { m = (M)v; }
+template <typename M> inline void bound_set(M&, const char*, size_t) {}
+
+inline void bound_set(std::string&, long long) {}
+inline void bound_set(std::string&, double) {}
+inline void bound_set(std::string& m, const char* data, size_t len) { m.assign(data, len); }
+
+
+// Do the values of the field fit into a member of this type? An empty string if so, else
+// why not. 'sign_bits' is the width of the raw value to sign extend, 0 if it is unsigned.
+inline std::string bound_check(const Field& field, Bound_category to, unsigned int to_bits, bool to_signed,
+                               unsigned int& sign_bits) {
+
+    sign_bits = 0;
+
+    switch (field.kind()) {
+
+    case Field::KIND_STRING:
+        return to == BOUND_STRING ? "" : "a string column needs a std::string member";
+
+    case Field::KIND_FLOAT:
+        return (to == BOUND_FLOAT || to == BOUND_DOUBLE) ? "" : "a FLOAT column needs a float or double member";
+
+    case Field::KIND_DOUBLE:
+        return to == BOUND_DOUBLE ? "" : "a DOUBLE column needs a double member";
+
+    default:
+        break;
+    }
+
+    if (to != BOUND_INT)
+        return "an integer column needs an integer member";
+
+    // Signed integer columns come as the raw bits of their width
+    unsigned int bits = 0;
+    bool is_signed = false;
+
+    if (!dynamic_cast<const Field_year*>(&field) &&
+        (dynamic_cast<const Field_tiny*>(&field) || dynamic_cast<const Field_short*>(&field) ||
+         dynamic_cast<const Field_medium*>(&field) || dynamic_cast<const Field_long*>(&field) ||
+         dynamic_cast<const Field_longlong*>(&field))) {
+
+        bits = field.pack_length() * 8;
+        is_signed = field.field_type.find("unsigned") == std::string::npos;
+
+        if (is_signed)
+            sign_bits = bits;
+
+    } else if ((dynamic_cast<const Field_temporal*>(&field) &&
+                static_cast<const Field_temporal&>(field).isEpoch()) ||
+               dynamic_cast<const Field_new_decimal*>(&field)) {
+
+        // Epoch values and scaled decimals: signed, in unsigned long long
+
+        bits = 64;
+        is_signed = true;
+
+    } else {
+
+        switch (field.kind()) {
+        case Field::KIND_CHAR:      bits = 8; break;
+        case Field::KIND_USHORT:    bits = 16; break;
+        case Field::KIND_INT:       bits = 32; is_signed = true; break;
+        case Field::KIND_UINT:      bits = 32; break;
+        default:                    bits = 64; break;
+        }
+    }
+
+    if (is_signed && !to_signed)
+        return "a signed column needs a signed member";
+
+    if (to_bits < bits + (!is_signed && to_signed ? 1 : 0))
+        return "the member is too narrow for the column";
+
+    return "";
+}
+
+
+template <typename S>
+struct BoundRow {
+
+    RecordSet::TypeEvent type_event;
+    time_t when;
+    unsigned int master_id;
+
+    // Write: the new row, Delete: the deleted one, Update: the row after it
+    const S* row;
+
+    // The row before an update; NULL for the others
+    const S* old_row;
+};
+
+
+template <typename S>
+class StructBinding: public RowHandler, private Row_sink {
+public:
+
+    typedef boost::function<void (const BoundRow<S>&)> callback_t;
+
+    explicit StructBinding(const callback_t& callback) :
+        m_callback(callback), m_table(NULL), m_slots(NULL), m_slot(NULL), m_target(NULL) {}
+
+    template <typename M>
+    StructBinding& bind(const std::string& column, M S::* member) {
+        m_members.push_back(boost::shared_ptr<Member_base>(new Member<M>(column, member)));
+        return *this;
+    }
+
+    void onTable(const Table& table) {
+
+        std::vector<Slot> slots(table.fields.size());
+
+        for (typename std::vector<boost::shared_ptr<Member_base> >::const_iterator i = m_members.begin();
+             i != m_members.end(); ++i) {
+
+            const Member_base& member = **i;
+
+            size_t n = 0;
+            while (n < table.fields.size() && table.fields[n]->field_name != member.column)
+                ++n;
+
+            if (n == table.fields.size())
+                throw std::runtime_error("StructBinding: " + table.full_name + " has no column '" + member.column + "'");
+
+            const std::string error = bound_check(*table.fields[n], member.category, member.bits, member.is_signed,
+                                                  slots[n].sign_bits);
+            if (!error.empty())
+                throw std::runtime_error("StructBinding: " + table.full_name + "." + member.column + ": " + error);
+
+            slots[n].member = &member;
+        }
+
+        m_tables[table.full_name].swap(slots);
+        m_table = NULL;
+    }
+
+    const unsigned char* onRow(Table& table, Image image, const unsigned char* row,
+                               const std::vector<unsigned char>& cols,
+                               time_t when, unsigned int server_id) {
+
+        if (&table != m_table) {
+
+            typename std::map<std::string, std::vector<Slot> >::iterator i = m_tables.find(table.full_name);
+
+            if (i == m_tables.end())
+                throw std::runtime_error("StructBinding: " + table.full_name + " was not checked by onTable()");
+
+            m_table = &table;
+            m_slots = &i->second;
+        }
+
+        S& target = (image == UpdateBefore ? m_old_row : m_row);
+        target = S();
+        m_target = &target;
+
+        const unsigned char* end = unpack_row_to(table, row, cols, *this);
+
+        if (end == NULL || image == UpdateBefore)
+            return end;
+
+        BoundRow<S> bound;
+        bound.type_event = image == Write ? RecordSet::Write : image == Delete ? RecordSet::Delete : RecordSet::Update;
+        bound.when = when;
+        bound.master_id = server_id;
+        bound.row = &m_row;
+        bound.old_row = image == UpdateAfter ? &m_old_row : NULL;
+
+        m_callback(bound);
+
+        return end;
+    }
+
+private:
+
+    struct Member_base {
+
+        std::string column;
+        Bound_category category;
+        unsigned int bits;
+        bool is_signed;
+
+        Member_base(const std::string& column_, Bound_category category_, unsigned int bits_, bool is_signed_) :
+            column(column_), category(category_), bits(bits_), is_signed(is_signed_) {}
+
+        virtual ~Member_base() {}
+
+        virtual void set(S& s, long long v) const = 0;
+        virtual void set(S& s, double v) const = 0;
+        virtual void set(S& s, const char* data, size_t len) const = 0;
+    };
+
+    template <typename M>
+    struct Member: public Member_base {
+
+        M S::* member;
+
+        Member(const std::string& column_, M S::* member_) :
+            Member_base(column_, Bound_type<M>::category, Bound_type<M>::bits, Bound_type<M>::is_signed),
+            member(member_) {}
+
+        void set(S& s, long long v) const { bound_set(s.*member, v); }
+        void set(S& s, double v) const { bound_set(s.*member, v); }
+        void set(S& s, const char* data, size_t len) const { bound_set(s.*member, data, len); }
+    };
+
+    // Per column; NULL member if it is not bound
+    struct Slot {
+
+        const Member_base* member;
+
+        // Bits of the raw value if it is signed, 0 if not
+        unsigned int sign_bits;
+
+        Slot() : member(NULL), sign_bits(0) {}
+    };
+
+    void column(unsigned int i, bool present, bool is_null) {
+
+        const Slot& slot = (*m_slots)[i];
+        m_slot = (present && !is_null && slot.member) ? &slot : NULL;
+    }
+
+    void integer(unsigned long long raw) {
+
+        if (!m_slot)
+            return;
+
+        if (m_slot->sign_bits != 0 && m_slot->sign_bits < 64) {
+            const unsigned int shift = 64 - m_slot->sign_bits;
+            m_slot->member->set(*m_target, (long long)(raw << shift) >> shift);
+        } else {
+            m_slot->member->set(*m_target, (long long)raw);
+        }
+    }
+
+    void value(char v) { integer((unsigned char)v); }
+    void value(unsigned short v) { integer(v); }
+    void value(int v) { if (m_slot) m_slot->member->set(*m_target, (long long)v); }
+    void value(unsigned int v) { integer(v); }
+    void value(unsigned long long v) { integer(v); }
+    void value(float v) { if (m_slot) m_slot->member->set(*m_target, (double)v); }
+    void value(double v) { if (m_slot) m_slot->member->set(*m_target, v); }
+    void value(const char* data, size_t len) { if (m_slot) m_slot->member->set(*m_target, data, len); }
+
+    callback_t m_callback;
+
+    std::vector<boost::shared_ptr<Member_base> > m_members;
+
+    // Table name -> a slot per column, made by onTable()
+    std::map<std::string, std::vector<Slot> > m_tables;
+
+    // The table of the last row, and its slots
+    const Table* m_table;
+    std::vector<Slot>* m_slots;
+
+    // The column being decoded, NULL if it is not bound
+    const Slot* m_slot;
+
+    S* m_target;
+    S m_row;
+    S m_old_row;
+};
+
+}// slave
+
+#endif
@@ -24,8 +24,10 @@
 #include <boost/function.hpp>
 
 #include "field.h"
+#include "fixed_row.h"
 #include "recordset.h"
 #include "SlaveStats.h"
+#include "table_stats.h"
 
 
 namespace slave
@@ -35,6 +37,52 @@ typedef boost::shared_ptr<Field> PtrField;
 typedef boost::function<void (RecordSet&)> callback;
 
 
+// A column as the master describes it; what a Field is made of.
+struct ColumnInfo {
+
+    std::string name;
+
+    // As in SHOW FULL COLUMNS: "int(10) unsigned"
+    std::string type;
+
+    // For char and varchar only
+    collate_info collate;
+
+    // Part of the primary key
+    bool primary;
+
+    ColumnInfo() : primary(false) {}
+};
+
+
+class Table;
+class RowCoalescer;
+
+// Instead of the callback, gets the row images of a table as they are in the event,
+// and decodes them itself with unpack_row_to() (see slave_log_event.h).
+class RowHandler {
+public:
+
+    enum Image { Write, Delete, UpdateBefore, UpdateAfter };
+
+    virtual ~RowHandler() {}
+
+    // 'row' is the null bitmap and the values of the columns set in 'cols'.
+    // Returns the end of the image, NULL if it cannot be decoded.
+    virtual const unsigned char* onRow(Table& table, Image image, const unsigned char* row,
+                                       const std::vector<unsigned char>& cols,
+                                       time_t when, unsigned int server_id) = 0;
+
+    // The transaction is over: XID, COMMIT or a DDL statement.
+    virtual void onCommit() {}
+
+    // The structure of a table of this handler was read; it may throw if it does not fit.
+    virtual void onTable(const Table&) {}
+};
+
+typedef boost::shared_ptr<RowHandler> PtrRowHandler;
+
+
 class Table {
 
 public:
@@ -43,13 +91,35 @@ public:
 
     callback m_callback;
 
+    // If set, it gets the rows and m_callback is not called
+    PtrRowHandler m_row_handler;
+
+    // If set, the rows go to m_callback through it, at the end of the transaction
+    boost::shared_ptr<RowCoalescer> m_coalescer;
+
+    // If set, it gets the rows decoded with m_fixed_layout, see Slave::setFixedCallback()
+    fixed_callback m_fixed_callback;
+
+    // NULL unless all the columns are fixed-width integers, see Slave::createTable()
+    boost::shared_ptr<FixedLayout> m_fixed_layout;
+
+    // What the table costs, see Slave::setTableStats(); NULL if it is not counted
+    boost::shared_ptr<TableCounters> m_stats;
+
     void call_callback(slave::RecordSet& _rs, ExtStateIface &ext_state) {
 
         // Some stats
         ext_state.incTableCount(full_name);
         ext_state.setLastFilteredUpdateTime();
 
+        if (!m_stats) {
+            m_callback(_rs);
+            return;
+        }
+
+        const unsigned long long start = now_nsec();
         m_callback(_rs);
+        m_stats->row(now_nsec() - start);
     }
 
 
@@ -58,12 +128,28 @@ public:
 
     std::string full_name;
 
+    // What fields were made of, and the binlog type of each (see Slave::createTable()).
+    std::vector<ColumnInfo> columns;
+    std::vector<unsigned char> column_types;
+
+    // Checked against the first TABLE_MAP event
+    bool validated;
+
+    // Updates give only the changed columns and the primary key, see Slave::setUpdateDiff()
+    bool m_update_diff;
+
+    // Is field i a part of the primary key? False if the columns are not known.
+    bool isPrimary(size_t i) const {
+        return i < columns.size() && columns[i].primary;
+    }
+
     Table(const std::string& db_name, const std::string& tbl_name) : 
         table_name(tbl_name), database_name(db_name), 
-        full_name(database_name + "." + table_name)
+        full_name(database_name + "." + table_name),
+        validated(false), m_update_diff(false)
         {}
 
-    Table() {}
+    Table() : validated(false), m_update_diff(false) {}
 
 };
 
@@ -0,0 +1,108 @@
+/* Copyright 2011 ZAO "Begun".
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3 of the License, or (at your option)
+ * any later version.
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+
+#include <stdexcept>
+
+#include "table_pattern.h"
+
+
+namespace
+{
+
+std::string glob_to_regex(const std::string& glob) {
+
+    std::string re;
+
+    for (std::string::const_iterator i = glob.begin(); i != glob.end(); ++i) {
+
+        switch (*i) {
+        case '*':
+            re += ".*";
+            break;
+        case '?':
+            re += '.';
+            break;
+        default:
+            if (::strchr(".[]{}()\\+^$|", *i))
+                re += '\\';
+            re += *i;
+        }
+    }
+
+    return re;
+}
+
+void free_regex(regex_t* re) {
+
+    ::regfree(re);
+    delete re;
+}
+
+}// anonymous-namespace
+
+
+namespace slave
+{
+
+boost::shared_ptr<regex_t> TablePattern::compile(const std::string& expression) {
+
+    regex_t* re = new regex_t;
+
+    const int error = ::regcomp(re, ("^(" + expression + ")$").c_str(), REG_EXTENDED | REG_NOSUB);
+
+    if (error != 0) {
+
+        char message[256];
+        ::regerror(error, re, message, sizeof(message));
+        delete re;
+
+        throw std::runtime_error("TablePattern: bad expression '" + expression + "': " + message);
+    }
+
+    return boost::shared_ptr<regex_t>(re, free_regex);
+}
+
+
+TablePattern TablePattern::glob(const std::string& db, const std::string& table) {
+
+    TablePattern pattern;
+
+    pattern.m_db = compile(glob_to_regex(db));
+    pattern.m_table = compile(glob_to_regex(table));
+    pattern.m_text = db + "." + table;
+
+    return pattern;
+}
+
+TablePattern TablePattern::regex(const std::string& db, const std::string& table) {
+
+    TablePattern pattern;
+
+    pattern.m_db = compile(db);
+    pattern.m_table = compile(table);
+    pattern.m_text = db + "." + table;
+
+    return pattern;
+}
+
+
+bool TablePattern::matches(const std::string& db, const std::string& table) const {
+
+    return ::regexec(m_db.get(), db.c_str(), 0, NULL, 0) == 0 &&
+           ::regexec(m_table.get(), table.c_str(), 0, NULL, 0) == 0;
+}
+
+}// slave
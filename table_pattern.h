@@ -0,0 +1,59 @@
+/* Copyright 2011 ZAO "Begun".
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3 of the License, or (at your option)
+ * any later version.
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __SLAVE_TABLE_PATTERN_H_
+#define __SLAVE_TABLE_PATTERN_H_
+
+#include <regex.h>
+
+#include <string>
+
+#include <boost/shared_ptr.hpp>
+
+
+namespace slave
+{
+
+// Which tables a subscription takes, see Slave::setCallback(const TablePattern&, callback).
+// Both parts are compiled once, and matched against the whole name.
+class TablePattern {
+public:
+
+    // '*' is any run of characters, '?' any one character: TablePattern::glob("db_*", "orders_*")
+    static TablePattern glob(const std::string& db, const std::string& table);
+
+    // POSIX extended regular expressions: TablePattern::regex("db_[0-9]+", "orders_[0-9]{4}")
+    static TablePattern regex(const std::string& db, const std::string& table);
+
+    bool matches(const std::string& db, const std::string& table) const;
+
+    // As it was given, "db.table"
+    const std::string& text() const { return m_text; }
+
+private:
+
+    TablePattern() {}
+
+    // Throws std::runtime_error if it is not a valid expression
+    static boost::shared_ptr<regex_t> compile(const std::string& expression);
+
+    boost::shared_ptr<regex_t> m_db;
+    boost::shared_ptr<regex_t> m_table;
+
+    std::string m_text;
+};
+
+}// slave
+
+#endif
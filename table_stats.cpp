@@ -0,0 +1,100 @@
+/* Copyright 2011 ZAO "Begun".
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3 of the License, or (at your option)
+ * any later version.
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+
+#include "table_stats.h"
+#include "mutex_lock.h"
+
+
+namespace
+{
+
+inline unsigned long long atomic_read(const unsigned long long& v) {
+    return __sync_fetch_and_add(const_cast<unsigned long long*>(&v), 0);
+}
+
+bool costlier(const slave::TableStats& a, const slave::TableStats& b) {
+    return a.nsec() != b.nsec() ? a.nsec() > b.nsec() : a.name < b.name;
+}
+
+}// anonymous-namespace
+
+
+namespace slave
+{
+
+TableStats TableCounters::read() const {
+
+    TableStats stats;
+
+    stats.events = atomic_read(m_events);
+    stats.bytes = atomic_read(m_bytes);
+    stats.rows = atomic_read(m_rows);
+    stats.decode_nsec = atomic_read(m_decode_nsec);
+    stats.callback_nsec = atomic_read(m_callback_nsec);
+
+    return stats;
+}
+
+
+TableStatsRegistry::TableStatsRegistry() {
+    ::pthread_mutex_init(&m_mutex, NULL);
+}
+
+TableStatsRegistry::~TableStatsRegistry() {
+    ::pthread_mutex_destroy(&m_mutex);
+}
+
+
+boost::shared_ptr<TableCounters> TableStatsRegistry::get(const std::string& full_name) {
+
+    MutexLock lock(m_mutex);
+
+    boost::shared_ptr<TableCounters>& counters = m_tables[full_name];
+
+    if (!counters)
+        counters.reset(new TableCounters);
+
+    return counters;
+}
+
+
+std::vector<TableStats> TableStatsRegistry::top(size_t n) const {
+
+    std::vector<TableStats> stats;
+
+    {
+        MutexLock lock(m_mutex);
+
+        stats.reserve(m_tables.size());
+
+        for (std::map<std::string, boost::shared_ptr<TableCounters> >::const_iterator i = m_tables.begin();
+             i != m_tables.end(); ++i) {
+
+            stats.push_back(i->second->read());
+            stats.back().name = i->first;
+        }
+    }
+
+    if (n == 0 || n > stats.size())
+        n = stats.size();
+
+    std::partial_sort(stats.begin(), stats.begin() + n, stats.end(), costlier);
+    stats.resize(n);
+
+    return stats;
+}
+
+}// slave
@@ -0,0 +1,148 @@
+/* Copyright 2011 ZAO "Begun".
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3 of the License, or (at your option)
+ * any later version.
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __SLAVE_TABLE_STATS_H_
+#define __SLAVE_TABLE_STATS_H_
+
+#include <pthread.h>
+#include <time.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+
+namespace slave
+{
+
+// What a watched table has cost so far, see Slave::setTableStats().
+struct TableStats {
+
+    // "db.table"
+    std::string name;
+
+    // Row events of the table, and their bytes
+    unsigned long long events;
+    unsigned long long bytes;
+
+    // Rows given to the callback, row handler or fixed callback
+    unsigned long long rows;
+
+    // Unpacking the rows; with a row handler, that is part of the callback time
+    unsigned long long decode_nsec;
+    unsigned long long callback_nsec;
+
+    TableStats() : events(0), bytes(0), rows(0), decode_nsec(0), callback_nsec(0) {}
+
+    unsigned long long nsec() const { return decode_nsec + callback_nsec; }
+};
+
+
+inline unsigned long long now_nsec() {
+
+    struct timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (unsigned long long)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+// The counters of one table, pointed to by its Table, so that counting needs no lookups.
+// Only the binlog reading thread counts: the rows of an event are summed up as they go,
+// and published with atomic adds once it is done. Any thread may read them.
+class TableCounters {
+public:
+
+    TableCounters() : m_events(0), m_bytes(0), m_rows(0), m_decode_nsec(0), m_callback_nsec(0),
+        m_pending_rows(0), m_pending_callback_nsec(0) {}
+
+    // A row was given out, in so many nanoseconds
+    void row(unsigned long long callback_nsec) {
+        ++m_pending_rows;
+        m_pending_callback_nsec += callback_nsec;
+    }
+
+    // A row event of the table is done, it took 'nsec' with the callbacks
+    void event(unsigned long bytes, unsigned long long nsec) {
+
+        const unsigned long long decode_nsec = nsec > m_pending_callback_nsec ? nsec - m_pending_callback_nsec : 0;
+
+        __sync_fetch_and_add(&m_events, 1);
+        __sync_fetch_and_add(&m_bytes, bytes);
+        __sync_fetch_and_add(&m_decode_nsec, decode_nsec);
+
+        flush();
+    }
+
+    // The rows given out after their event, as RowCoalescer does on commit
+    void flush() {
+
+        if (m_pending_rows == 0)
+            return;
+
+        __sync_fetch_and_add(&m_rows, m_pending_rows);
+        __sync_fetch_and_add(&m_callback_nsec, m_pending_callback_nsec);
+
+        m_pending_rows = m_pending_callback_nsec = 0;
+    }
+
+    // Without 'name'
+    TableStats read() const;
+
+private:
+
+    TableCounters(const TableCounters&);
+    TableCounters& operator= (const TableCounters&);
+
+    unsigned long long m_events;
+    unsigned long long m_bytes;
+    unsigned long long m_rows;
+    unsigned long long m_decode_nsec;
+    unsigned long long m_callback_nsec;
+
+    // Of the reading thread, not published yet
+    unsigned long long m_pending_rows;
+    unsigned long long m_pending_callback_nsec;
+};
+
+
+// The counters of all the watched tables, by name. They outlive the Table objects, which are
+// made anew every time the structure is read.
+class TableStatsRegistry {
+public:
+
+    TableStatsRegistry();
+    ~TableStatsRegistry();
+
+    // Made on the first call for the table
+    boost::shared_ptr<TableCounters> get(const std::string& full_name);
+
+    // The tables by decode and callback time, the costliest first; 'n' of them, all with 0.
+    std::vector<TableStats> top(size_t n = 0) const;
+
+private:
+
+    TableStatsRegistry(const TableStatsRegistry&);
+    TableStatsRegistry& operator= (const TableStatsRegistry&);
+
+    mutable pthread_mutex_t m_mutex;
+
+    std::map<std::string, boost::shared_ptr<TableCounters> > m_tables;
+};
+
+}// slave
+
+#endif
@@ -0,0 +1,394 @@
+/* Copyright 2011 ZAO "Begun".
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3 of the License, or (at your option)
+ * any later version.
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+
+#include "temporal.h"
+
+
+namespace
+{
+
+long long read_be(const unsigned char* p, unsigned int bytes) {
+
+    unsigned long long v = 0;
+
+    for (unsigned int i = 0; i < bytes; ++i)
+        v = (v << 8) | p[i];
+
+    // Sign extended
+    const unsigned int shift = 64 - bytes * 8;
+    return shift ? (long long)(v << shift) >> shift : (long long)v;
+}
+
+const size_t TZIF_HEADER_LEN = 44;
+
+// The year of a time, UTC
+long long year_of(long long seconds) {
+
+    const long long days = (seconds >= 0 ? seconds : seconds - 86399) / 86400;
+    const long long z = days + 719468;
+    const long long era = (z >= 0 ? z : z - 146096) / 146097;
+    const long long doe = z - era * 146097;
+    const long long yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const long long doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const long long mp = (5 * doy + 2) / 153;
+
+    return yoe + era * 400 + (mp >= 10 ? 1 : 0);
+}
+
+
+// The POSIX TZ string at the end of version 2+ files, for the times after the last
+// transition: "EST5EDT,M3.2.0,M11.1.0". Only the Mm.w.d rules are read; they are all
+// the tz database has for the zones with daylight saving time.
+class Posix_tz {
+public:
+
+    explicit Posix_tz(const std::string& s) : m_p(s.c_str()), m_ok(false), m_has_dst(false) {
+
+        if (!name() || !offset(m_std))
+            return;
+
+        m_std = -m_std;
+
+        if (*m_p == '\0') {
+            m_ok = true;
+            return;
+        }
+
+        if (!name())
+            return;
+
+        m_dst = m_std + 3600;
+
+        if (*m_p != ',' && *m_p != '\0') {
+            if (!offset(m_dst))
+                return;
+            m_dst = -m_dst;
+        }
+
+        if (*m_p++ != ',' || !rule(m_start) || *m_p++ != ',' || !rule(m_end) || *m_p != '\0')
+            return;
+
+        m_ok = m_has_dst = true;
+    }
+
+    bool ok() const { return m_ok; }
+
+    // East of UTC
+    int standard() const { return m_std; }
+
+    // Transitions of a year, UTC: the start of daylight saving time and its end
+    bool transitions(long long year, long long& start, long long& end) const {
+
+        if (!m_has_dst)
+            return false;
+
+        start = m_start.local(year) - m_std;
+        end = m_end.local(year) - m_dst;
+
+        return true;
+    }
+
+    int dst() const { return m_dst; }
+
+private:
+
+    struct Rule {
+
+        unsigned int month;
+        unsigned int week;
+        unsigned int weekday;
+        long time;
+
+        // Seconds since the epoch of the local time
+        long long local(long long year) const {
+
+            const long long first = slave::days_from_civil(year, month, 1);
+            const unsigned int first_weekday = (unsigned int)(((first + 4) % 7 + 7) % 7);
+
+            static const unsigned int days_in_month[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+            const bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+            const unsigned int last = days_in_month[month - 1] + (month == 2 && leap ? 1 : 0);
+
+            unsigned int day = 1 + (weekday + 7 - first_weekday) % 7 + (week - 1) * 7;
+
+            while (day > last)
+                day -= 7;
+
+            return (first + day - 1) * 86400 + time;
+        }
+    };
+
+    bool name() {
+
+        if (*m_p == '<') {
+            while (*m_p && *m_p != '>')
+                ++m_p;
+            return *m_p++ == '>';
+        }
+
+        const char* start = m_p;
+
+        while ((*m_p >= 'A' && *m_p <= 'Z') || (*m_p >= 'a' && *m_p <= 'z'))
+            ++m_p;
+
+        return m_p - start >= 3;
+    }
+
+    // [+-]hh[:mm[:ss]], in seconds
+    bool offset(long& out) {
+
+        long sign = 1;
+
+        if (*m_p == '+' || *m_p == '-')
+            sign = (*m_p++ == '-') ? -1 : 1;
+
+        if (*m_p < '0' || *m_p > '9')
+            return false;
+
+        out = 0;
+
+        for (long unit = 3600; unit >= 1; unit /= 60) {
+
+            long n = 0;
+
+            while (*m_p >= '0' && *m_p <= '9')
+                n = n * 10 + (*m_p++ - '0');
+
+            out += n * unit;
+
+            if (unit == 1 || *m_p != ':')
+                break;
+
+            ++m_p;
+        }
+
+        out *= sign;
+        return true;
+    }
+
+    bool number(unsigned int& out) {
+
+        if (*m_p < '0' || *m_p > '9')
+            return false;
+
+        out = 0;
+
+        while (*m_p >= '0' && *m_p <= '9')
+            out = out * 10 + (*m_p++ - '0');
+
+        return true;
+    }
+
+    // Mm.w.d[/time]
+    bool rule(Rule& out) {
+
+        if (*m_p++ != 'M' || !number(out.month) || *m_p++ != '.' || !number(out.week) ||
+            *m_p++ != '.' || !number(out.weekday))
+            return false;
+
+        if (out.month < 1 || out.month > 12 || out.week < 1 || out.week > 5 || out.weekday > 6)
+            return false;
+
+        out.time = 7200;
+
+        if (*m_p == '/') {
+            ++m_p;
+            return offset(out.time);
+        }
+
+        return true;
+    }
+
+    const char* m_p;
+    bool m_ok;
+    bool m_has_dst;
+
+    long m_std;
+    long m_dst;
+    Rule m_start;
+    Rule m_end;
+};
+
+// Years the TZ string rules are unrolled for, past the last transition in the file
+const long long POSIX_TZ_YEARS = 100;
+
+}// anonymous-namespace
+
+
+namespace slave
+{
+
+TimeZone::TimeZone() :
+    m_starts(1, std::numeric_limits<long long>::min()), m_offsets(1, 0) {}
+
+TimeZone::TimeZone(int offset) :
+    m_starts(1, std::numeric_limits<long long>::min()), m_offsets(1, offset) {}
+
+
+TimeZone TimeZone::load(const std::string& name, const std::string& dir) {
+
+    const std::string path = dir + "/" + name;
+
+    std::ifstream in(path.c_str(), std::ios::binary);
+
+    if (!in)
+        throw std::runtime_error("TimeZone: could not open " + path);
+
+    const std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    const unsigned char* p = (const unsigned char*)data.data();
+    const unsigned char* end = p + data.size();
+
+    if (data.size() < TZIF_HEADER_LEN || ::memcmp(p, "TZif", 4) != 0)
+        throw std::runtime_error("TimeZone: " + path + " is not a tz database file");
+
+    // Version 2+ files repeat the data with 64-bit times after the 32-bit one
+    unsigned int time_bytes = 4;
+
+    for (int pass = 0; pass < 2; ++pass) {
+
+        if ((size_t)(end - p) < TZIF_HEADER_LEN)
+            break;
+
+        const bool v2 = p[4] >= '2';
+        const unsigned long isutcnt = read_be(p + 20, 4);
+        const unsigned long isstdcnt = read_be(p + 24, 4);
+        const unsigned long leapcnt = read_be(p + 28, 4);
+        const unsigned long timecnt = read_be(p + 32, 4);
+        const unsigned long typecnt = read_be(p + 36, 4);
+        const unsigned long charcnt = read_be(p + 40, 4);
+
+        const size_t size = timecnt * time_bytes + timecnt + typecnt * 6 + charcnt +
+                            leapcnt * (time_bytes + 4) + isstdcnt + isutcnt;
+
+        if (typecnt == 0 || (size_t)(end - p) < TZIF_HEADER_LEN + size)
+            throw std::runtime_error("TimeZone: " + path + " is broken");
+
+        const unsigned char* times = p + TZIF_HEADER_LEN;
+        const unsigned char* indices = times + timecnt * time_bytes;
+        const unsigned char* types = indices + timecnt;
+
+        if (v2 && pass == 0) {
+            p = times + size;
+            time_bytes = 8;
+            continue;
+        }
+
+        TimeZone tz((int)read_be(types, 4));
+        long long last = std::numeric_limits<long long>::min();
+
+        for (unsigned long i = 0; i < timecnt; ++i) {
+
+            const unsigned int type = indices[i];
+
+            if (type >= typecnt)
+                throw std::runtime_error("TimeZone: " + path + " is broken");
+
+            last = read_be(times + i * time_bytes, time_bytes);
+            tz.add(last, (int)read_be(types + type * 6, 4));
+        }
+
+        // The rules for the times after the last transition
+        const unsigned char* footer = times + size;
+
+        if (time_bytes == 8 && footer < end && *footer == '\n') {
+
+            const unsigned char* footer_end = std::find(footer + 1, end, '\n');
+            const Posix_tz rules(std::string(footer + 1, footer_end));
+
+            if (rules.ok()) {
+
+                const long long first_year = (last == std::numeric_limits<long long>::min()) ? 1970 :
+                                             year_of(last);
+
+                long long start, stop;
+
+                if (!rules.transitions(first_year, start, stop))
+                    tz.add(last + 1, rules.standard());
+
+                for (long long year = first_year; year < first_year + POSIX_TZ_YEARS; ++year) {
+
+                    if (!rules.transitions(year, start, stop))
+                        break;
+
+                    if (start < stop) {
+                        tz.add(start, rules.dst(), last);
+                        tz.add(stop, rules.standard(), last);
+                    } else {
+                        // Southern hemisphere: daylight saving time over the new year
+                        tz.add(stop, rules.standard(), last);
+                        tz.add(start, rules.dst(), last);
+                    }
+                }
+            }
+        }
+
+        return tz;
+    }
+
+    throw std::runtime_error("TimeZone: " + path + " is broken");
+}
+
+
+void TimeZone::add(long long utc, int offset, long long after) {
+
+    const long long start = utc + offset;
+
+    if (utc <= after || start <= m_starts.back() || offset == m_offsets.back())
+        return;
+
+    m_starts.push_back(start);
+    m_offsets.push_back(offset);
+}
+
+
+long long TimeZone::toUtc(long long local) const {
+
+    if (m_starts.size() == 1)
+        return local - m_offsets[0];
+
+    const size_t i = std::upper_bound(m_starts.begin(), m_starts.end(), local) - m_starts.begin() - 1;
+
+    return local - m_offsets[i];
+}
+
+
+long long TimeZone::datetime(unsigned long long packed) const {
+
+    if (packed == 0)
+        return 0;
+
+    const DateTimeParts t = datetime_parts(packed);
+
+    return toUtc(days_from_civil(t.year, t.month, t.day) * 86400 + t.hour * 3600 + t.minute * 60 + t.second);
+}
+
+long long TimeZone::date(unsigned int packed) const {
+
+    if (packed == 0)
+        return 0;
+
+    const DateTimeParts t = date_parts(packed);
+
+    return toUtc(days_from_civil(t.year, t.month, t.day) * 86400);
+}
+
+}// slave
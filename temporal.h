@@ -0,0 +1,132 @@
+/* Copyright 2011 ZAO "Begun".
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 3 of the License, or (at your option)
+ * any later version.
+ * This library is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Lesser General Public License for more
+ * details.
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef __SLAVE_TEMPORAL_H_
+#define __SLAVE_TEMPORAL_H_
+
+#include <limits>
+#include <string>
+#include <vector>
+
+
+/*
+ * Decoding of the values DATE, TIME and DATETIME columns give (see field.h) without
+ * mktime(): the calendar is plain arithmetic, and the time zone is a table of its
+ * UTC offsets read once, so it is thread-safe and needs no TZ.
+ */
+
+namespace slave
+{
+
+struct DateTimeParts {
+    int year;
+    int month;
+    int day;
+    int hour;
+    int minute;
+    int second;
+    unsigned int usec;
+};
+
+// Days from 1970-01-01, in the proleptic Gregorian calendar
+inline long long days_from_civil(long long y, unsigned int m, unsigned int d) {
+
+    y -= (m <= 2);
+
+    const long long era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned int yoe = (unsigned int)(y - era * 400);
+    const unsigned int doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+    const unsigned int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+    return era * 146097 + (long long)doe - 719468;
+}
+
+// DATETIME: YYYYMMDDhhmmss
+inline DateTimeParts datetime_parts(unsigned long long packed, unsigned int usec = 0) {
+
+    const unsigned long long ymd = packed / 1000000;
+    const unsigned int hms = (unsigned int)(packed % 1000000);
+
+    DateTimeParts parts;
+    parts.year = (int)(ymd / 10000);
+    parts.month = (int)(ymd / 100 % 100);
+    parts.day = (int)(ymd % 100);
+    parts.hour = hms / 10000;
+    parts.minute = hms / 100 % 100;
+    parts.second = hms % 100;
+    parts.usec = usec;
+
+    return parts;
+}
+
+// DATE: YYYY * 512 + MM * 32 + DD
+inline DateTimeParts date_parts(unsigned int packed) {
+
+    DateTimeParts parts;
+    parts.year = packed >> 9;
+    parts.month = (packed >> 5) & 15;
+    parts.day = packed & 31;
+    parts.hour = parts.minute = parts.second = 0;
+    parts.usec = 0;
+
+    return parts;
+}
+
+// TIME: signed HHMMSS in the low 24 bits -> seconds, negative for negative times
+inline long long time_seconds(unsigned int packed) {
+
+    const int v = (int)(packed << 8) >> 8;
+    const int a = v < 0 ? -v : v;
+    const long long seconds = (long long)(a / 10000) * 3600 + (a / 100 % 100) * 60 + a % 100;
+
+    return v < 0 ? -seconds : seconds;
+}
+
+
+class TimeZone {
+public:
+
+    // UTC
+    TimeZone();
+
+    // A fixed offset east of UTC, in seconds
+    explicit TimeZone(int offset);
+
+    // From the tz database: TimeZone::load("Europe/Moscow"). Past the last transition in the file,
+    // its TZ string rules are followed for a hundred years. Throws std::runtime_error if the file
+    // is missing or broken.
+    static TimeZone load(const std::string& name, const std::string& dir = "/usr/share/zoneinfo");
+
+    // Seconds since the epoch of a local time, given as seconds since the epoch as if the zone
+    // were UTC. A local time that happens twice is taken the second time; one that never
+    // happens (skipped by a change forward) is taken with the offset before the change.
+    long long toUtc(long long local) const;
+
+    // Seconds since the epoch of a DATETIME, DATE (its midnight) in the zone; 0 for the zero date
+    long long datetime(unsigned long long packed) const;
+    long long date(unsigned int packed) const;
+
+private:
+
+    // From 'utc' on, the offset is 'offset'; ignored unless it is after 'after'
+    void add(long long utc, int offset, long long after = std::numeric_limits<long long>::min());
+
+    // The local time each offset starts at, the first one is the earliest possible
+    std::vector<long long> m_starts;
+    std::vector<int> m_offsets;
+};
+
+}// slave
+
+#endif
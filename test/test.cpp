@@ -44,6 +44,8 @@ void callback(const slave::RecordSet& event) {
     case slave::RecordSet::Update: std::cout << "UPDATE"; break;
     case slave::RecordSet::Delete: std::cout << "DELETE"; break;
     case slave::RecordSet::Write:  std::cout << "INSERT"; break;
+    case slave::RecordSet::PreInit:  std::cout << "PREINIT"; break;
+    case slave::RecordSet::PostInit: std::cout << "POSTINIT"; break;
     default: break;
     }
 
@@ -121,8 +123,27 @@ struct ExampleState : public slave::ExtStateIface {
     virtual std::string getMasterLogName() { return state.master_log_name; }
 
     // Persist the binlog position on disk. (For rollback.)
-    virtual void saveMasterInfo() {}
-    virtual bool loadMasterInfo(std::string& logname, unsigned long& pos) { return false; }
+    // Here it is only kept in memory, so that get_remote_binlog() continues after snapshot().
+    std::string saved_log_name;
+    unsigned long saved_log_pos;
+
+    ExampleState() : saved_log_pos(0) {}
+
+    virtual void saveMasterInfo() {
+        saved_log_name = state.master_log_name;
+        saved_log_pos = state.master_log_pos;
+    }
+
+    virtual bool loadMasterInfo(std::string& logname, unsigned long& pos) {
+        logname = saved_log_name;
+        pos = saved_log_pos;
+        return !logname.empty();
+    }
+
+    // Transactions received so far, when positioning by GTIDs.
+    slave::GtidSet gtid_set;
+    virtual void setMasterGtidSet(const slave::GtidSet& _gtid_set) { gtid_set = _gtid_set; }
+    virtual bool loadMasterGtidSet(slave::GtidSet& _gtid_set) { return false; }
 
     // False if we are currently waiting for binlog data from the network.
     virtual void setStateProcessing(bool _state) { state.state_processing = _state; }
@@ -131,6 +152,13 @@ struct ExampleState : public slave::ExtStateIface {
     // For counting table names in the binlog stream.
     virtual void initTableCount(const std::string& t) {}
     virtual void incTableCount(const std::string& t) {}
+
+    // Network traffic, all of it and the part that went to the callbacks.
+    virtual void addReceivedBytes(unsigned long bytes) {}
+    virtual void addTableBytes(const std::string& t, unsigned long bytes) {}
+
+    // Percentiles of it can be had from Slave::getLagPercentiles().
+    virtual void addLagSample(slave::LagStage stage, unsigned long long usec) {}
 };
 
 
@@ -141,9 +169,10 @@ int main(int argc, char** argv) {
     std::string password;
     std::string database;
     unsigned int port = 3306;
+    bool snapshot = false;
 
     while (1) {
-        int c = ::getopt(argc, argv, "h:u:p:P:d:");
+        int c = ::getopt(argc, argv, "h:u:p:P:d:s");
 
         if (c == -1) 
             break;
@@ -168,15 +197,19 @@ int main(int argc, char** argv) {
             port = ::atoi(optarg);
             break;
 
+        case 's':
+            snapshot = true;
+            break;
+
         default:
-            std::cout << "Usage: libslave_test -h <mysql host> -u <mysql user> -p <mysql password> -d <mysql database> "
+            std::cout << "Usage: libslave_test -h <mysql host> -u <mysql user> -p <mysql password> -d <mysql database> [-s] "
                       << "<table name> <table name> ..." << std::endl;
             return 1;
         }
     }
 
     if (host.empty() || user.empty() || database.empty() || password.empty()) {
-        std::cout << "Usage: libslave_test -h <mysql host> -u <mysql user> -p <mysql password> -d <mysql database> "
+        std::cout << "Usage: libslave_test -h <mysql host> -u <mysql user> -p <mysql password> -d <mysql database> [-s] "
                   << "<table name> <table name> ..." << std::endl;
         return 1;
     }
@@ -218,6 +251,11 @@ int main(int argc, char** argv) {
         std::cout << "Reading database structure..." << std::endl;
         slave.createDatabaseStructure();
 
+        if (snapshot) {
+            std::cout << "Reading tables..." << std::endl;
+            slave.snapshot();
+        }
+
         while (1) {
             try {
                 
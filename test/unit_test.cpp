@@ -7,11 +7,27 @@ using namespace boost::unit_test;
 
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/split.hpp>
+#include <boost/bind.hpp>
 #include <boost/mpl/int.hpp>
 #include <boost/mpl/list.hpp>
 #include <boost/thread.hpp>
 #include "Slave.h"
+#include "change_record.h"
+#include "charset.h"
+#include "coalesce.h"
+#include "columnar.h"
+#include "connection_pool.h"
+#include "crc32.h"
+#include "eventqueue.h"
+#include "fixed_row.h"
+#include "gtid.h"
 #include "nanomysql.h"
+#include "recorder.h"
+#include "schema_cache.h"
+#include "struct_binding.h"
+#include "table_pattern.h"
+#include "table_stats.h"
+#include "temporal.h"
 
 namespace
 {
@@ -198,6 +214,868 @@ namespace
         }
     };
 
+    BOOST_AUTO_TEST_CASE(test_BinlogCrc32)
+    {
+        const std::string check = "123456789";
+        BOOST_CHECK_EQUAL(slave::binlog_crc32(0, (const unsigned char*)check.data(), check.size()), 0xCBF43926U);
+
+        // Long enough for the folding path, and computed in pieces
+        std::string data;
+        for (int i = 0; i < 1000; ++i)
+            data += char(i * 7 + 3);
+        const uint32_t whole = slave::binlog_crc32(0, (const unsigned char*)data.data(), data.size());
+        uint32_t parts = slave::binlog_crc32(0, (const unsigned char*)data.data(), 333);
+        parts = slave::binlog_crc32(parts, (const unsigned char*)data.data() + 333, data.size() - 333);
+        BOOST_CHECK_EQUAL(whole, parts);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_GtidSet)
+    {
+        // As the server prints it: several uuids, newline after comma
+        slave::GtidSet set("3E11FA47-71CA-11E1-9E33-C80AA9429562:1-5:7,\n4e11fa47-71ca-11e1-9e33-c80aa9429562:3");
+        BOOST_CHECK_EQUAL(set.str(), "3e11fa47-71ca-11e1-9e33-c80aa9429562:1-5:7,4e11fa47-71ca-11e1-9e33-c80aa9429562:3");
+
+        const std::string sid = slave::GtidSet::parseUuid("3e11fa47-71ca-11e1-9e33-c80aa9429562");
+        BOOST_CHECK(!set.contains(sid, 6));
+        set.add(sid, 6);
+        set.add(sid, 9);
+        BOOST_CHECK(set.contains(sid, 6));
+        BOOST_CHECK_EQUAL(set.str(), "3e11fa47-71ca-11e1-9e33-c80aa9429562:1-7:9,4e11fa47-71ca-11e1-9e33-c80aa9429562:3");
+
+        // Overlapping and unordered intervals are merged
+        BOOST_CHECK(slave::GtidSet("3e11fa47-71ca-11e1-9e33-c80aa9429562:8-9:1-3:2-7") ==
+                    slave::GtidSet("3e11fa47-71ca-11e1-9e33-c80aa9429562:1-9"));
+
+        // 8 bytes count + (16 bytes sid + 8 bytes count + 16 bytes per interval) per uuid
+        BOOST_CHECK_EQUAL(set.encode().size(), 8 + (16 + 8 + 2 * 16) + (16 + 8 + 16));
+
+        BOOST_CHECK_THROW(slave::GtidSet("3e11fa47:1"), std::runtime_error);
+        BOOST_CHECK_THROW(slave::GtidSet("3e11fa47-71ca-11e1-9e33-c80aa9429562:5-1"), std::runtime_error);
+    }
+
+    // Snapshot values must be the same as the binlog ones
+    BOOST_AUTO_TEST_CASE(test_FieldUnpackStr)
+    {
+        slave::Field_medium medium("f", "mediumint(9)");
+        medium.unpack_str("-1", 2);
+        BOOST_CHECK_EQUAL(boost::any_cast<uint32>(medium.field_data), 0xFFFFFFU);
+
+        slave::Field_date date("f", "date");
+        BOOST_CHECK_EQUAL(date.select_expr(), "`f` + 0");
+        date.unpack_str("20120305", 8);
+        BOOST_CHECK_EQUAL(boost::any_cast<uint32>(date.field_data), 2012U * 512 + 3 * 32 + 5);
+
+        slave::Field_datetime2 datetime("f", "datetime(3)");
+        datetime.unpack_str("20120305123456.250", 18);
+        BOOST_CHECK_EQUAL(boost::any_cast<unsigned long long>(datetime.field_data), 20120305123456ULL);
+        BOOST_CHECK_EQUAL(datetime.frac_usec, 250000U);
+
+        slave::Field_year year("f`", "year(4)");
+        BOOST_CHECK_EQUAL(year.select_expr(), "IF(`f```, `f``` - 1900, 0)");
+        year.unpack_str("112", 3);
+        BOOST_CHECK_EQUAL(boost::any_cast<char>(year.field_data), 112);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_Transcoder)
+    {
+        std::string buf;
+
+        const slave::Transcoder* cp1251 = slave::Transcoder::find("cp1251", true, false);
+        BOOST_REQUIRE(cp1251);
+
+        // ASCII is given as it is, without a copy
+        const char ascii[] = "plain ascii value";
+        size_t len = sizeof(ascii) - 1;
+        BOOST_CHECK(cp1251->convert(ascii, len, buf) == ascii);
+        BOOST_CHECK_EQUAL(len, sizeof(ascii) - 1);
+
+        const char privet[] = "\xcf\xf0\xe8\xe2\xe5\xf2, world";
+        len = sizeof(privet) - 1;
+        const char* out = cp1251->convert(privet, len, buf);
+        BOOST_CHECK_EQUAL(std::string(out, len), "\xd0\x9f\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82, world");
+
+        // MySQL's latin1 is cp1252
+        const slave::Transcoder* latin1 = slave::Transcoder::find("latin1", true, false);
+        BOOST_REQUIRE(latin1);
+        len = 3;
+        out = latin1->convert("\xe9\x80x", len, buf);
+        BOOST_CHECK_EQUAL(std::string(out, len), "\xc3\xa9\xe2\x82\xacx");
+
+        BOOST_CHECK(!slave::Transcoder::find("latin1", false, true));
+        BOOST_CHECK(!slave::Transcoder::find("utf8", true, false));
+        BOOST_CHECK(!slave::Transcoder::find("gbk", true, true));
+        BOOST_CHECK(!slave::Transcoder::isSupported("gbk"));
+        BOOST_CHECK(slave::Transcoder::isSupported("utf8mb4"));
+
+        // Overlong, surrogate, 4 bytes in utf8, cut short
+        BOOST_CHECK_EQUAL(slave::utf8_valid_prefix("ab\xc0\xaf", 4, 3), 2U);
+        BOOST_CHECK_EQUAL(slave::utf8_valid_prefix("\xed\xa0\x80", 3, 3), 0U);
+        BOOST_CHECK_EQUAL(slave::utf8_valid_prefix("\xf0\x9f\x98\x80", 4, 3), 0U);
+        BOOST_CHECK_EQUAL(slave::utf8_valid_prefix("\xf0\x9f\x98\x80", 4, 4), 4U);
+        BOOST_CHECK_EQUAL(slave::utf8_valid_prefix("0123456789\xd0", 11, 3), 10U);
+
+        const slave::Transcoder* utf8 = slave::Transcoder::find("utf8", false, true);
+        BOOST_REQUIRE(utf8);
+
+        const char valid[] = "\xd0\x9f\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82";
+        len = sizeof(valid) - 1;
+        BOOST_CHECK(utf8->convert(valid, len, buf) == valid);
+
+        len = 5;
+        out = utf8->convert("a\xff\xd0\x9f\xd0", len, buf);
+        BOOST_CHECK_EQUAL(std::string(out, len), "a\xef\xbf\xbd\xd0\x9f\xef\xbf\xbd");
+
+        // Fields give the transcoded values from both unpack() and unpack_to()
+        slave::collate_info collate;
+        collate.charset = "cp1251";
+        collate.maxlen = 1;
+
+        slave::Field_varstring varchar("f", "varchar(10)", collate);
+        varchar.setTranscoder(cp1251);
+
+        const char row[] = "\x03\xe4\xe0!";
+        varchar.unpack(row);
+        BOOST_CHECK_EQUAL(boost::any_cast<std::string>(varchar.field_data), "\xd0\xb4\xd0\xb0!");
+    }
+
+    BOOST_AUTO_TEST_CASE(test_TemporalEpoch)
+    {
+        BOOST_CHECK_EQUAL(slave::days_from_civil(1970, 1, 1), 0);
+        BOOST_CHECK_EQUAL(slave::days_from_civil(2000, 3, 1), 11017);
+        BOOST_CHECK_EQUAL(slave::days_from_civil(1969, 12, 31), -1);
+
+        const slave::TimeZone utc;
+        BOOST_CHECK_EQUAL(utc.datetime(20120305123456ULL), 1330950896LL);
+        BOOST_CHECK_EQUAL(utc.datetime(0), 0);
+        BOOST_CHECK_EQUAL(utc.date(2012 * 512 + 3 * 32 + 5), 1330905600LL);
+
+        const slave::TimeZone msk(3 * 3600);
+        BOOST_CHECK_EQUAL(msk.datetime(20120305123456ULL), 1330950896LL - 3 * 3600);
+
+        // -01:02:03 in 3 bytes
+        BOOST_CHECK_EQUAL(slave::time_seconds((unsigned int)-10203 & 0xFFFFFF), -3723LL);
+
+        // Fields switch to epoch values, and to unsigned long long for DATE and TIME
+        slave::Field_datetime datetime("f", "datetime");
+        datetime.setEpoch(&msk, false);
+
+        const unsigned long long packed = 20120305123456ULL;
+        char row[8];
+        for (int i = 0; i < 8; ++i)
+            row[i] = (char)(packed >> (i * 8));
+
+        datetime.unpack(row);
+        BOOST_CHECK_EQUAL((long long)boost::any_cast<unsigned long long>(datetime.field_data), 1330950896LL - 3 * 3600);
+
+        slave::Field_date date("f", "date");
+        BOOST_CHECK_EQUAL(date.kind(), slave::Field::KIND_UINT);
+        date.setEpoch(&utc, true);
+        BOOST_CHECK_EQUAL(date.kind(), slave::Field::KIND_ULONGLONG);
+
+        const unsigned int ymd = 1969 * 512 + 12 * 32 + 31;
+        const char date_row[3] = { (char)ymd, (char)(ymd >> 8), (char)(ymd >> 16) };
+
+        date.unpack(date_row);
+        BOOST_CHECK_EQUAL((long long)boost::any_cast<unsigned long long>(date.field_data), -86400LL * 1000000);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_NegativeTime)
+    {
+        // -01:02:03 in both storages gives the same value
+        const unsigned int expected = (unsigned int)-10203 & 0xFFFFFF;
+
+        slave::Field_time time("t", "time");
+        time.unpack("\x25\xd8\xff");
+        BOOST_CHECK_EQUAL(boost::any_cast<unsigned int>(time.field_data), expected);
+        time.unpack_str("-10203", 6);
+        BOOST_CHECK_EQUAL(boost::any_cast<unsigned int>(time.field_data), expected);
+
+        // 0x800000 - (1 << 12 | 2 << 6 | 3)
+        slave::Field_time2 time2("t", "time");
+        time2.unpack("\x7f\xef\x7d");
+        BOOST_CHECK_EQUAL(boost::any_cast<unsigned int>(time2.field_data), expected);
+        time2.unpack_str("-10203", 6);
+        BOOST_CHECK_EQUAL(boost::any_cast<unsigned int>(time2.field_data), expected);
+
+        BOOST_CHECK_EQUAL(slave::time_seconds(expected), -3723LL);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_NewDecimal)
+    {
+        // 1 digit in a byte and 9 in 4 bytes, then 4 digits in 2 bytes
+        slave::Field_new_decimal decimal("f", "decimal(14,4)");
+        const slave::Field& field = decimal;
+        BOOST_CHECK_EQUAL(field.pack_length(), 7U);
+
+        const char positive[] = "\x81\x0d\xfb\x38\xd2\x04\xd2";
+        const char negative[] = "\x7e\xf2\x04\xc7\x2d\xfb\x2d";
+
+        decimal.unpack(positive);
+        BOOST_CHECK_EQUAL(boost::any_cast<std::string>(decimal.field_data), "1234567890.1234");
+        decimal.unpack(negative);
+        BOOST_CHECK_EQUAL(boost::any_cast<std::string>(decimal.field_data), "-1234567890.1234");
+
+        BOOST_REQUIRE(decimal.setScaled(true));
+        BOOST_CHECK_EQUAL(decimal.kind(), slave::Field::KIND_ULONGLONG);
+        decimal.unpack(negative);
+        BOOST_CHECK_EQUAL((long long)boost::any_cast<unsigned long long>(decimal.field_data), -12345678901234LL);
+        decimal.unpack_str("-1234567890.1234", 16);
+        BOOST_CHECK_EQUAL((long long)boost::any_cast<unsigned long long>(decimal.field_data), -12345678901234LL);
+
+        slave::Field_new_decimal money("f", "decimal(10,2) unsigned");
+        money.unpack("\x80\x00\x00\x00\x32");
+        BOOST_CHECK_EQUAL(boost::any_cast<std::string>(money.field_data), "0.50");
+        money.unpack("\x7f\xff\xff\xff\xff");
+        BOOST_CHECK_EQUAL(boost::any_cast<std::string>(money.field_data), "0.00");
+
+        // 10^scale is over 32 bits
+        slave::Field_new_decimal fine("f", "decimal(18,12)");
+        BOOST_REQUIRE(fine.setScaled(true));
+        fine.unpack_str("-123456.5", 9);
+        BOOST_CHECK_EQUAL((long long)boost::any_cast<unsigned long long>(fine.field_data), -123456500000000000LL);
+        fine.unpack_str("1", 1);
+        BOOST_CHECK_EQUAL(boost::any_cast<unsigned long long>(fine.field_data), 1000000000000ULL);
+
+        slave::Field_new_decimal wide("f", "decimal(65,30)");
+        BOOST_CHECK(!wide.setScaled(true));
+        BOOST_CHECK_EQUAL(wide.kind(), slave::Field::KIND_STRING);
+
+        BOOST_CHECK_THROW(slave::Field_new_decimal("f", "decimal(66,2)"), std::runtime_error);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_TableStats)
+    {
+        slave::TableStatsRegistry registry;
+
+        boost::shared_ptr<slave::TableCounters> users = registry.get("db.users");
+        boost::shared_ptr<slave::TableCounters> orders = registry.get("db.orders");
+        registry.get("db.idle");
+
+        // The same slot after a reload of the structure
+        BOOST_CHECK(registry.get("db.users") == users);
+
+        // Two rows in an event of 100 bytes that took 1000 ns, 600 of them in the callbacks
+        users->row(200);
+        users->row(400);
+        users->event(100, 1000);
+
+        orders->event(50, 5000);
+
+        // Coalesced rows are given out later, on commit
+        orders->row(300);
+        BOOST_CHECK_EQUAL(orders->read().rows, 0U);
+        orders->flush();
+
+        const slave::TableStats u = users->read();
+        BOOST_CHECK_EQUAL(u.events, 1U);
+        BOOST_CHECK_EQUAL(u.bytes, 100U);
+        BOOST_CHECK_EQUAL(u.rows, 2U);
+        BOOST_CHECK_EQUAL(u.decode_nsec, 400U);
+        BOOST_CHECK_EQUAL(u.callback_nsec, 600U);
+
+        const std::vector<slave::TableStats> top = registry.top(2);
+        BOOST_REQUIRE_EQUAL(top.size(), 2U);
+        BOOST_CHECK_EQUAL(top[0].name, "db.orders");
+        BOOST_CHECK_EQUAL(top[0].nsec(), 5300U);
+        BOOST_CHECK_EQUAL(top[1].name, "db.users");
+
+        BOOST_CHECK_EQUAL(registry.top().size(), 3U);
+    }
+
+    // TABLE_MAP event of db.t with the given column types and metadata
+    std::string table_map_event(const std::string& types, const std::string& meta)
+    {
+        std::string event(LOG_EVENT_HEADER_LEN + TABLE_MAP_HEADER_LEN, '\0');
+        event += std::string("\x02" "db\0" "\x01" "t\0", 7);
+        event += (char)types.size();
+        event += types;
+        event += (char)meta.size();
+        event += meta;
+        event += std::string((types.size() + 7) / 8, '\0');
+        return event;
+    }
+
+    BOOST_AUTO_TEST_CASE(test_FitTemporalStorage)
+    {
+        // A 5.6.4+ master, so DATETIME was taken for the new storage; the table kept the old one
+        slave::Table table("db", "t");
+        table.fields.push_back(slave::PtrField(new slave::Field_datetime2("d", "datetime")));
+        table.fields.push_back(slave::PtrField(new slave::Field_long("i", "int(11)")));
+        table.column_types.push_back(18);
+        table.column_types.push_back(3);
+
+        const std::string old_map = table_map_event(std::string("\x0c\x03", 2), "");
+        const slave::Table_map_event_info old_tmi(old_map.data(), old_map.size());
+
+        BOOST_CHECK(slave::fit_temporal_storage(table, old_tmi));
+        BOOST_CHECK(!slave::fit_temporal_storage(table, old_tmi));
+        BOOST_CHECK(!dynamic_cast<slave::Field_datetime2*>(table.fields[0].get()));
+        BOOST_CHECK_EQUAL(table.column_types[0], 12);
+
+        // 2012-03-05 12:34:56 in 8 bytes, then 42
+        const unsigned long long datetime = 20120305123456ULL;
+        char row[12];
+        for (int i = 0; i < 8; ++i)
+            row[i] = (char)(datetime >> (i * 8));
+        const char i42[4] = { 42, 0, 0, 0 };
+        ::memcpy(row + 8, i42, 4);
+
+        const char* p = table.fields[0]->unpack(row);
+        BOOST_CHECK_EQUAL(boost::any_cast<unsigned long long>(table.fields[0]->field_data), datetime);
+        p = table.fields[1]->unpack(p);
+        BOOST_CHECK_EQUAL(boost::any_cast<unsigned int>(table.fields[1]->field_data), 42U);
+        BOOST_CHECK(p == row + 12);
+
+        // DATETIME(3) in the new storage, the fsp from the metadata
+        const std::string new_map = table_map_event(std::string("\x12\x03", 2), std::string("\x03", 1));
+        const slave::Table_map_event_info new_tmi(new_map.data(), new_map.size());
+
+        BOOST_REQUIRE_EQUAL(new_tmi.m_column_meta.size(), 2U);
+        BOOST_CHECK_EQUAL(new_tmi.m_column_meta[0], 3U);
+
+        BOOST_CHECK(slave::fit_temporal_storage(table, new_tmi));
+        const slave::Field_datetime2* fitted = dynamic_cast<slave::Field_datetime2*>(table.fields[0].get());
+        BOOST_REQUIRE(fitted);
+        BOOST_CHECK_EQUAL(fitted->fsp, 3U);
+        BOOST_CHECK_EQUAL(table.column_types[0], 18);
+        BOOST_CHECK_EQUAL(static_cast<const slave::Field&>(*fitted).pack_length(), 7U);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_SchemaCache)
+    {
+        slave::SchemaCache cache;
+        cache.master = "localhost:3306";
+        cache.log_name = "mysql-bin.000012";
+        cache.log_pos = 107;
+
+        slave::ColumnInfo column;
+        column.name = "name with spaces\nand 5:colons";
+        column.type = "varchar(10)";
+        column.collate.name = "utf8_general_ci";
+        column.collate.charset = "utf8";
+        column.collate.maxlen = 3;
+        column.primary = true;
+        cache.tables[std::make_pair("test", "t")].push_back(column);
+
+        const std::string path = "/tmp/libslave_unit_test_schema_cache";
+        cache.save(path);
+
+        slave::SchemaCache loaded;
+        BOOST_REQUIRE(loaded.load(path));
+        ::unlink(path.c_str());
+
+        BOOST_REQUIRE_EQUAL(loaded.tables.size(), 1);
+        const std::vector<slave::ColumnInfo>& columns = loaded.tables[std::make_pair("test", "t")];
+        BOOST_REQUIRE_EQUAL(columns.size(), 1);
+        BOOST_CHECK_EQUAL(columns[0].name, column.name);
+        BOOST_CHECK_EQUAL(columns[0].collate.maxlen, 3);
+        BOOST_CHECK(columns[0].primary);
+
+        // Usable from its own position on, for the same master only
+        BOOST_CHECK(loaded.validAt("localhost:3306", "mysql-bin.000012", 107));
+        BOOST_CHECK(loaded.validAt("localhost:3306", "mysql-bin.000013", 4));
+        BOOST_CHECK(!loaded.validAt("localhost:3306", "mysql-bin.000012", 4));
+        BOOST_CHECK(!loaded.validAt("otherhost:3306", "mysql-bin.000013", 4));
+    }
+
+    void collectBatch(std::vector<slave::ColumnBatch>& batches, const slave::ColumnBatch& batch)
+    {
+        batches.push_back(batch);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_ColumnarHandler)
+    {
+        slave::collate_info collate;
+        collate.name = "utf8_general_ci";
+        collate.charset = "utf8";
+        collate.maxlen = 3;
+
+        slave::Table table("test", "t");
+        table.fields.push_back(slave::PtrField(new slave::Field_long("id", "int(11)")));
+        table.fields.push_back(slave::PtrField(new slave::Field_varstring("name", "varchar(10)", collate)));
+
+        // Null bitmap, then the values: (1, 'abc') and (2, NULL)
+        const unsigned char rows[] = { 0x00, 1, 0, 0, 0, 3, 'a', 'b', 'c',
+                                       0x02, 2, 0, 0, 0 };
+        const std::vector<unsigned char> cols(1, 0x03);
+
+        std::vector<slave::ColumnBatch> batches;
+        slave::ColumnarHandler handler(boost::bind(&collectBatch, boost::ref(batches), _1), 10);
+
+        const unsigned char* p = handler.onRow(table, slave::RowHandler::Write, rows, cols, 100, 1);
+        BOOST_REQUIRE(p == rows + 9);
+        p = handler.onRow(table, slave::RowHandler::Delete, p, cols, 100, 1);
+        BOOST_REQUIRE(p == rows + sizeof(rows));
+
+        // Nothing until the transaction ends
+        BOOST_CHECK(batches.empty());
+        handler.onCommit();
+        BOOST_REQUIRE_EQUAL(batches.size(), 1);
+
+        const slave::ColumnBatch& batch = batches[0];
+        BOOST_CHECK_EQUAL(batch.tbl_name, "t");
+        BOOST_REQUIRE_EQUAL(batch.rows, 2);
+        BOOST_CHECK_EQUAL(batch.images[1], slave::RowHandler::Delete);
+
+        const slave::Column& id = batch.columns[0];
+        BOOST_CHECK_EQUAL(id.kind, slave::Field::KIND_UINT);
+        BOOST_CHECK_EQUAL(id.get<unsigned int>(0), 1U);
+        BOOST_CHECK_EQUAL(id.get<unsigned int>(1), 2U);
+
+        const slave::Column& name = batch.columns[1];
+        BOOST_CHECK_EQUAL(name.kind, slave::Field::KIND_STRING);
+        BOOST_CHECK(name.valid(0));
+        BOOST_CHECK(!name.valid(1));
+        BOOST_CHECK_EQUAL(name.getString(0), "abc");
+        BOOST_CHECK_EQUAL(name.getString(1), "");
+
+        handler.onCommit();
+        BOOST_CHECK_EQUAL(batches.size(), 1);
+
+        // A pending row, then the table gets a column: the row goes out with the old layout
+        handler.onRow(table, slave::RowHandler::Write, rows, cols, 101, 1);
+        table.fields.push_back(slave::PtrField(new slave::Field_long("extra", "int(11)")));
+        handler.onTable(table);
+        BOOST_REQUIRE_EQUAL(batches.size(), 2);
+        BOOST_CHECK_EQUAL(batches[1].rows, 1);
+        BOOST_CHECK_EQUAL(batches[1].columns.size(), 2);
+
+        // (3, 'x', 7)
+        const unsigned char wide[] = { 0x00, 3, 0, 0, 0, 1, 'x', 7, 0, 0, 0 };
+        p = handler.onRow(table, slave::RowHandler::Write, wide, std::vector<unsigned char>(1, 0x07), 102, 1);
+        BOOST_REQUIRE(p == wide + sizeof(wide));
+        handler.onCommit();
+
+        BOOST_REQUIRE_EQUAL(batches.size(), 3);
+        BOOST_REQUIRE_EQUAL(batches[2].columns.size(), 3);
+        BOOST_CHECK_EQUAL(batches[2].columns[1].getString(0), "x");
+        BOOST_CHECK_EQUAL(batches[2].columns[2].get<unsigned int>(0), 7U);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_ChangeRecord)
+    {
+        slave::collate_info collate;
+        collate.name = "utf8_general_ci";
+        collate.charset = "utf8";
+        collate.maxlen = 3;
+
+        slave::Table table("test", "t");
+        table.fields.push_back(slave::PtrField(new slave::Field_enum("e", "enum('a','b')")));
+        table.fields.push_back(slave::PtrField(new slave::Field_varstring("name", "varchar(10)", collate)));
+
+        // UPDATE t SET e = 'b', name = NULL WHERE name = 'abc', and the after image has no 'e'
+        const unsigned char before[] = { 0x00, 1, 3, 'a', 'b', 'c' };
+        const unsigned char after[] = { 0x01 };
+        const std::vector<unsigned char> cols(1, 0x03);
+        const std::vector<unsigned char> cols_ai(1, 0x02);
+
+        std::string buffer;
+        slave::ChangeRecordWriter writer(buffer);
+        writer.addTable("test", "t", 7);
+
+        BOOST_REQUIRE(writer.onRow(table, slave::RowHandler::UpdateBefore, before, cols, 100, 1) == before + sizeof(before));
+        BOOST_REQUIRE(writer.onRow(table, slave::RowHandler::UpdateAfter, after, cols_ai, 100, 1) == after + sizeof(after));
+
+        slave::ChangeRecordReader reader(buffer.data(), buffer.size());
+        slave::ChangeRecord record;
+
+        BOOST_REQUIRE(reader.next(record));
+        BOOST_CHECK_EQUAL(record.table_id, 7U);
+        BOOST_CHECK_EQUAL(record.type, slave::RecordSet::Update);
+        BOOST_CHECK_EQUAL(record.when, 100);
+        BOOST_CHECK_EQUAL(record.columns, 2U);
+
+        slave::ChangeValue value;
+        slave::ChangeImageReader old_row(record.before, record.before_len);
+        BOOST_REQUIRE(old_row.next(value));
+        BOOST_CHECK_EQUAL(value.kind, slave::Field::KIND_INT);
+        BOOST_CHECK_EQUAL(value.u, 1U);
+        BOOST_REQUIRE(old_row.next(value));
+        BOOST_CHECK_EQUAL(std::string(value.data, value.len), "abc");
+        BOOST_CHECK(!old_row.next(value));
+
+        slave::ChangeImageReader new_row(record.after, record.after_len);
+        BOOST_REQUIRE(new_row.next(value));
+        BOOST_CHECK_EQUAL(value.state, slave::CR_ABSENT);
+        BOOST_REQUIRE(new_row.next(value));
+        BOOST_CHECK_EQUAL(value.state, slave::CR_NULL);
+        BOOST_CHECK(!new_row.next(value));
+
+        BOOST_CHECK(!reader.next(record));
+    }
+
+    void collectRecordSet(std::vector<slave::RecordSet>& records, slave::RecordSet& rs)
+    {
+        records.push_back(rs);
+    }
+
+    slave::RecordSet makeRecordSet(slave::RecordSet::TypeEvent type, const char* old_value, const char* value)
+    {
+        slave::RecordSet rs;
+        rs.type_event = type;
+        if (old_value)
+            rs.m_old_row["v"] = std::make_pair("varchar(10)", boost::any(std::string(old_value)));
+        if (value)
+            rs.m_row["v"] = std::make_pair("varchar(10)", boost::any(std::string(value)));
+        return rs;
+    }
+
+    BOOST_AUTO_TEST_CASE(test_RowCoalescer)
+    {
+        std::vector<slave::RecordSet> records;
+
+        boost::shared_ptr<slave::Table> table(new slave::Table("test", "t"));
+        table->m_callback = boost::bind(&collectRecordSet, boost::ref(records), _1);
+
+        slave::EmptyExtState ext_state;
+        slave::RowCoalescer coalescer;
+
+        // Key 1: insert + update, key 2: update + update + delete, key 3: insert + delete
+        slave::RecordSet rs = makeRecordSet(slave::RecordSet::Write, NULL, "a");
+        coalescer.add(table, rs, "1", "1");
+        rs = makeRecordSet(slave::RecordSet::Update, "b", "c");
+        coalescer.add(table, rs, "2", "2");
+        rs = makeRecordSet(slave::RecordSet::Update, "a", "d");
+        coalescer.add(table, rs, "1", "1");
+        rs = makeRecordSet(slave::RecordSet::Write, NULL, "x");
+        coalescer.add(table, rs, "3", "3");
+        rs = makeRecordSet(slave::RecordSet::Update, "c", "e");
+        coalescer.add(table, rs, "2", "2");
+        rs = makeRecordSet(slave::RecordSet::Delete, NULL, "e");
+        coalescer.add(table, rs, "2", "2");
+        rs = makeRecordSet(slave::RecordSet::Delete, NULL, "x");
+        coalescer.add(table, rs, "3", "3");
+
+        BOOST_CHECK(records.empty());
+        coalescer.commit(ext_state);
+        BOOST_REQUIRE_EQUAL(records.size(), 2);
+
+        BOOST_CHECK_EQUAL(records[0].type_event, slave::RecordSet::Write);
+        BOOST_CHECK_EQUAL(boost::any_cast<std::string>(records[0].m_row["v"].second), "d");
+
+        // The row as it was before the transaction
+        BOOST_CHECK_EQUAL(records[1].type_event, slave::RecordSet::Delete);
+        BOOST_CHECK_EQUAL(boost::any_cast<std::string>(records[1].m_row["v"].second), "b");
+
+        coalescer.commit(ext_state);
+        BOOST_CHECK_EQUAL(records.size(), 2);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_UpdateDiffBadField)
+    {
+        std::vector<slave::RecordSet> records;
+
+        boost::shared_ptr<slave::Table> table(new slave::Table("test", "t"));
+        table->m_callback = boost::bind(&collectRecordSet, boost::ref(records), _1);
+        table->m_update_diff = true;
+
+        const char* names[] = { "id", "v", "w" };
+        for (int i = 0; i < 3; ++i) {
+            table->fields.push_back(slave::PtrField(new slave::Field_long(names[i], "int(11)")));
+            slave::ColumnInfo column;
+            column.name = names[i];
+            column.primary = (i == 0);
+            table->columns.push_back(column);
+        }
+
+        // Its values are not given, changed or not
+        table->fields[1]->is_bad = true;
+
+        slave::RelayLogInfo rli;
+        rli.setTableName(5, "t", "test");
+        rli.setTable("t", "test", table);
+
+        // UPDATE t SET v = 9, w = 4 WHERE id = 1, from (1, 2, 3)
+        std::string event(LOG_EVENT_HEADER_LEN + ROWS_HEADER_LEN, '\0');
+        event[LOG_EVENT_HEADER_LEN] = 5;
+        event += std::string("\x03\x07\x07", 3);
+        event += std::string("\x00\x01\x00\x00\x00\x02\x00\x00\x00\x03\x00\x00\x00", 13);
+        event += std::string("\x00\x01\x00\x00\x00\x09\x00\x00\x00\x04\x00\x00\x00", 13);
+
+        slave::Basic_event_info bei;
+        bei.type = slave::UPDATE_ROWS_EVENT;
+        bei.buf = event.data();
+        bei.event_len = event.size();
+
+        const slave::Row_event_info roi(event.data(), event.size(), true);
+        slave::EmptyExtState ext_state;
+        slave::apply_row_event(rli, bei, roi, ext_state);
+
+        BOOST_REQUIRE_EQUAL(records.size(), 1);
+        slave::RecordSet& rs = records[0];
+
+        BOOST_CHECK_EQUAL(rs.m_row.size(), 2);
+        BOOST_CHECK_EQUAL(rs.m_old_row.size(), 2);
+        BOOST_CHECK(rs.m_row.find("v") == rs.m_row.end());
+        BOOST_CHECK(rs.m_old_row.find("v") == rs.m_old_row.end());
+        BOOST_CHECK_EQUAL(boost::any_cast<unsigned int>(rs.m_row["w"].second), 4U);
+        BOOST_CHECK_EQUAL(boost::any_cast<unsigned int>(rs.m_old_row["w"].second), 3U);
+        BOOST_CHECK_EQUAL(boost::any_cast<unsigned int>(rs.m_row["id"].second), 1U);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_LagHistogram)
+    {
+        slave::LagHistogram histogram;
+        BOOST_CHECK_EQUAL(histogram.percentile(99), 0U);
+
+        for (unsigned long long usec = 1000; usec <= 1000000; usec += 1000)
+            histogram.add(usec);
+
+        BOOST_CHECK_EQUAL(histogram.count(), 1000U);
+        BOOST_CHECK_EQUAL(histogram.max(), 1000000U);
+        BOOST_CHECK_EQUAL(histogram.mean(), 500500U);
+
+        // Within 12.5%
+        BOOST_CHECK_CLOSE((double)histogram.percentile(50), 500000.0, 12.5);
+        BOOST_CHECK_CLOSE((double)histogram.percentile(99), 990000.0, 12.5);
+        BOOST_CHECK_EQUAL(histogram.percentile(100), 1000000U);
+    }
+
+    void addLag(slave::SharedLagStats* stats, unsigned long long usec)
+    {
+        for (int i = 0; i < 10000; ++i)
+            stats->add(slave::LAG_TOTAL, usec);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_SharedLagStats)
+    {
+        slave::SharedLagStats stats;
+
+        // Read while another thread writes
+        boost::thread writer(boost::bind(&addLag, &stats, 1000ULL));
+        for (int i = 0; i < 100; ++i)
+            stats.percentiles(slave::LAG_TOTAL);
+        writer.join();
+
+        const slave::LagPercentiles total = stats.percentiles(slave::LAG_TOTAL);
+        BOOST_CHECK_EQUAL(total.count, 10000U);
+        BOOST_CHECK_EQUAL(total.mean, 1000U);
+        BOOST_CHECK_EQUAL(total.max, 1000U);
+        BOOST_CHECK_CLOSE((double)total.p99, 1000.0, 12.5);
+        BOOST_CHECK_EQUAL(stats.percentiles(slave::LAG_NETWORK).count, 0U);
+
+        stats.reset();
+        BOOST_CHECK_EQUAL(stats.percentiles(slave::LAG_TOTAL).count, 0U);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_FixedLayout)
+    {
+        std::vector<slave::PtrField> fields;
+        fields.push_back(slave::PtrField(new slave::Field_long("id", "int(10) unsigned")));
+        fields.push_back(slave::PtrField(new slave::Field_short("delta", "smallint(6)")));
+        fields.push_back(slave::PtrField(new slave::Field_timestamp2("ts", "timestamp(3)")));
+
+        boost::shared_ptr<slave::FixedLayout> layout = slave::FixedLayout::make(fields);
+        BOOST_REQUIRE(layout);
+        BOOST_CHECK_EQUAL(layout->count(), 3U);
+
+        const std::vector<unsigned char> cols(1, 0x07);
+        BOOST_CHECK(layout->isFull(cols));
+        BOOST_CHECK(!layout->isFull(std::vector<unsigned char>(1, 0x05)));
+
+        // (4000000000, -2, 1500000000.123), then (1, NULL, 2)
+        const unsigned char rows[] = { 0x00, 0x00, 0x28, 0x6b, 0xee, 0xfe, 0xff, 0x59, 0x68, 0x2f, 0x00, 0x04, 0xce,
+                                       0x02, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00 };
+        const unsigned char* end = rows + sizeof(rows);
+
+        long long values[3];
+        unsigned char nulls[1];
+        bool has_nulls = true;
+
+        const unsigned char* p = layout->decode(rows, end, cols, true, values, nulls, has_nulls);
+        BOOST_REQUIRE(p == rows + 13);
+        BOOST_CHECK(!has_nulls);
+        BOOST_CHECK_EQUAL(values[0], 4000000000LL);
+        BOOST_CHECK_EQUAL(values[1], -2);
+        BOOST_CHECK_EQUAL(values[2], 1500000000LL);
+
+        p = layout->decode(p, end, cols, true, values, nulls, has_nulls);
+        BOOST_REQUIRE(p == end);
+        BOOST_CHECK(has_nulls);
+        BOOST_CHECK_EQUAL(nulls[0], 0x02);
+        BOOST_CHECK_EQUAL(values[0], 1);
+        BOOST_CHECK_EQUAL(values[2], 2);
+
+        // Cut short
+        BOOST_CHECK(layout->decode(rows, rows + 10, cols, true, values, nulls, has_nulls) == NULL);
+
+        fields.push_back(slave::PtrField(new slave::Field_double("d", "double")));
+        BOOST_CHECK(!slave::FixedLayout::make(fields));
+    }
+
+    struct BoundUser
+    {
+        unsigned int id;
+        int delta;
+        std::string name;
+
+        BoundUser() : id(0), delta(0) {}
+    };
+
+    void collectUser(std::vector<BoundUser>& users, const slave::BoundRow<BoundUser>& row)
+    {
+        if (row.old_row)
+            users.push_back(*row.old_row);
+
+        users.push_back(*row.row);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_StructBinding)
+    {
+        slave::collate_info collate;
+        collate.name = "utf8_general_ci";
+        collate.charset = "utf8";
+        collate.maxlen = 3;
+
+        slave::Table table("test", "users");
+        table.fields.push_back(slave::PtrField(new slave::Field_long("id", "int(10) unsigned")));
+        table.fields.push_back(slave::PtrField(new slave::Field_short("delta", "smallint(6)")));
+        table.fields.push_back(slave::PtrField(new slave::Field_varstring("name", "varchar(10)", collate)));
+
+        std::vector<BoundUser> users;
+        slave::StructBinding<BoundUser> binding(boost::bind(&collectUser, boost::ref(users), _1));
+        binding.bind("id", &BoundUser::id).bind("delta", &BoundUser::delta).bind("name", &BoundUser::name);
+        binding.onTable(table);
+
+        // (7, -2, 'ab') -> (7, NULL, 'c')
+        const unsigned char rows[] = { 0x00, 7, 0, 0, 0, 0xfe, 0xff, 2, 'a', 'b',
+                                       0x02, 7, 0, 0, 0, 1, 'c' };
+        const std::vector<unsigned char> cols(1, 0x07);
+
+        const unsigned char* p = binding.onRow(table, slave::RowHandler::UpdateBefore, rows, cols, 100, 1);
+        BOOST_REQUIRE(p == rows + 10);
+        BOOST_CHECK(users.empty());
+        p = binding.onRow(table, slave::RowHandler::UpdateAfter, p, cols, 100, 1);
+        BOOST_REQUIRE(p == rows + sizeof(rows));
+
+        BOOST_REQUIRE_EQUAL(users.size(), 2);
+        BOOST_CHECK_EQUAL(users[0].id, 7U);
+        BOOST_CHECK_EQUAL(users[0].delta, -2);
+        BOOST_CHECK_EQUAL(users[0].name, "ab");
+        BOOST_CHECK_EQUAL(users[1].delta, 0);
+        BOOST_CHECK_EQUAL(users[1].name, "c");
+
+        // Does not fit: signed into unsigned, and a missing column
+        slave::StructBinding<BoundUser> wrong(boost::bind(&collectUser, boost::ref(users), _1));
+        wrong.bind("delta", &BoundUser::id);
+        BOOST_CHECK_THROW(wrong.onTable(table), std::runtime_error);
+
+        slave::StructBinding<BoundUser> missing(boost::bind(&collectUser, boost::ref(users), _1));
+        missing.bind("nope", &BoundUser::id);
+        BOOST_CHECK_THROW(missing.onTable(table), std::runtime_error);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_BinlogRecorder)
+    {
+        char dir_template[] = "/tmp/libslave-record-XXXXXX";
+        const std::string dir = ::mkdtemp(dir_template);
+
+        {
+            // A batch per event, a few events per segment, the last two segments kept
+            slave::BinlogRecorder recorder(dir, 200, 2, slave::BinlogRecorder::SYNC_NONE, 50);
+
+            for (int i = 0; i < 40; ++i) {
+                const std::string event(20 + i, 'a' + i % 26);
+                recorder.record(event.data(), event.size(), 1000 + i, 1, "mysql-bin.000001", 4 + i * 100);
+            }
+        }
+
+        slave::BinlogReplayer replayer(dir);
+        slave::BinlogReplayer::Event event;
+
+        BOOST_REQUIRE(replayer.next(event));
+        const unsigned long long first = event.usec;
+        BOOST_CHECK(first > 1000);
+        BOOST_CHECK_EQUAL(event.len, 20 + (first - 1000));
+        BOOST_CHECK_EQUAL(event.checksum_alg, 1);
+
+        unsigned long long last = first;
+        while (replayer.next(event))
+            last = event.usec;
+        BOOST_CHECK_EQUAL(last, 1039U);
+
+        // The older segments are gone
+        BOOST_CHECK(!replayer.seek("mysql-bin.000001", 4));
+
+        BOOST_REQUIRE(replayer.seek("mysql-bin.000001", 3850));
+        BOOST_REQUIRE(replayer.next(event));
+        BOOST_CHECK_EQUAL(event.usec, 1038U);
+        BOOST_CHECK_EQUAL(std::string(event.data, event.len), std::string(58, 'm'));
+
+        ::system(("rm -rf " + dir).c_str());
+    }
+
+    void produce(slave::EventQueue<int>* queue, int count)
+    {
+        for (int i = 0; i < count; ++i)
+            queue->push(i);
+
+        queue->close();
+    }
+
+    BOOST_AUTO_TEST_CASE(test_EventQueue)
+    {
+        slave::EventQueue<int> queue(4);
+
+        int v = -1;
+        BOOST_CHECK(!queue.try_pop(v));
+        BOOST_CHECK(!queue.pop(v, 10));
+
+        for (int i = 0; i < 4; ++i)
+            BOOST_CHECK(queue.try_push(i));
+
+        BOOST_CHECK(!queue.try_push(4));
+        BOOST_CHECK_EQUAL(queue.size(), 4U);
+        BOOST_CHECK_EQUAL(queue.high_water(), 4U);
+
+        for (int i = 0; i < 4; ++i) {
+            BOOST_CHECK(queue.try_pop(v));
+            BOOST_CHECK_EQUAL(v, i);
+        }
+
+        // The producer keeps stopping on the full queue
+        boost::thread producer(boost::bind(&produce, &queue, 10000));
+
+        int expected = 0;
+        while (queue.pop(v)) {
+            BOOST_CHECK_EQUAL(v, expected);
+            ++expected;
+        }
+
+        producer.join();
+
+        BOOST_CHECK_EQUAL(expected, 10000);
+        BOOST_CHECK_EQUAL(queue.size(), 0U);
+        BOOST_CHECK(!queue.push(0));
+        BOOST_CHECK(!queue.try_push(0));
+        BOOST_CHECK_EQUAL(queue.size(), 0U);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_TablePattern)
+    {
+        const slave::TablePattern glob = slave::TablePattern::glob("db_*", "orders_????");
+
+        BOOST_CHECK(glob.matches("db_1", "orders_0001"));
+        BOOST_CHECK(glob.matches("db_", "orders_4096"));
+        BOOST_CHECK(!glob.matches("db1", "orders_0001"));
+        BOOST_CHECK(!glob.matches("db_1", "orders_00011"));
+        BOOST_CHECK(!glob.matches("db_1", "xorders_0001"));
+        BOOST_CHECK_EQUAL(glob.text(), "db_*.orders_????");
+
+        // Dots and the like are themselves in a glob
+        const slave::TablePattern dot = slave::TablePattern::glob("a.b", "t");
+        BOOST_CHECK(dot.matches("a.b", "t"));
+        BOOST_CHECK(!dot.matches("axb", "t"));
+
+        const slave::TablePattern regex = slave::TablePattern::regex("db_[0-9]+", "orders|users");
+        BOOST_CHECK(regex.matches("db_12", "orders"));
+        BOOST_CHECK(regex.matches("db_12", "users"));
+        BOOST_CHECK(!regex.matches("db_12", "orders_1"));
+        BOOST_CHECK(!regex.matches("db_x", "users"));
+
+        BOOST_CHECK_THROW(slave::TablePattern::regex("db(", "t"), std::runtime_error);
+    }
+
     BOOST_FIXTURE_TEST_SUITE(Slave, Fixture)
 
     BOOST_AUTO_TEST_CASE(test_HelloWorld)
@@ -212,7 +1090,10 @@ namespace
         MYSQL_CHAR,
         MYSQL_VARCHAR,
         MYSQL_TINYTEXT,
-        MYSQL_TEXT
+        MYSQL_TEXT,
+        MYSQL_DATETIME,
+        MYSQL_BIT,
+        MYSQL_DECIMAL
     };
 
     template <MYSQL_TYPE T>
@@ -258,6 +1139,30 @@ namespace
     };
     const std::string MYSQL_type_traits<MYSQL_TEXT>::name = "TEXT";
 
+    template <>
+    struct MYSQL_type_traits<MYSQL_DATETIME>
+    {
+        typedef unsigned long long slave_type;
+        static const std::string name;
+    };
+    const std::string MYSQL_type_traits<MYSQL_DATETIME>::name = "DATETIME";
+
+    template <>
+    struct MYSQL_type_traits<MYSQL_BIT>
+    {
+        typedef unsigned long long slave_type;
+        static const std::string name;
+    };
+    const std::string MYSQL_type_traits<MYSQL_BIT>::name = "BIT";
+
+    template <>
+    struct MYSQL_type_traits<MYSQL_DECIMAL>
+    {
+        typedef std::string slave_type;
+        static const std::string name;
+    };
+    const std::string MYSQL_type_traits<MYSQL_DECIMAL>::name = "DECIMAL";
+
     template <typename T>
     struct CheckEquality
     {
@@ -319,7 +1224,10 @@ namespace
         boost::mpl::int_<MYSQL_CHAR>,
         boost::mpl::int_<MYSQL_VARCHAR>,
         boost::mpl::int_<MYSQL_TINYTEXT>,
-        boost::mpl::int_<MYSQL_TEXT>
+        boost::mpl::int_<MYSQL_TEXT>,
+        boost::mpl::int_<MYSQL_DATETIME>,
+        boost::mpl::int_<MYSQL_BIT>,
+        boost::mpl::int_<MYSQL_DECIMAL>
     > mysql_one_field_types;
 
     BOOST_AUTO_TEST_CASE_TEMPLATE(test_OneField, T, mysql_one_field_types)
@@ -343,11 +1251,15 @@ namespace
                 continue;
             if (tokens.front() == "define")
             {
-                if (tokens.size() != 2)
+                if (tokens.size() < 2)
                     BOOST_FAIL("Malformed string '" << line << "' in the file '" << sDataFilename << "'");
+                // DECIMAL(10,2) has a comma of its own
+                std::string sColumnType = tokens[1];
+                for (size_t i = 2; i < tokens.size(); ++i)
+                    sColumnType += "," + tokens[i];
                 const std::string sDropTableQuery = "DROP TABLE IF EXISTS test";
                 conn->query(sDropTableQuery);
-                const std::string sCreateTableQuery = "CREATE TABLE test (value " + tokens[1] + ")";
+                const std::string sCreateTableQuery = "CREATE TABLE test (value " + sColumnType + ")";
                 conn->query(sCreateTableQuery);
             }
             else if (tokens.front() == "data")
@@ -400,5 +1312,150 @@ namespace
         }
     }
 
+    struct CollectValues
+    {
+        boost::mutex m_Mutex;
+        std::vector<uint32_t> values;
+
+        void operator() (const slave::RecordSet& rs)
+        {
+            const slave::Row::const_iterator it = rs.m_row.find("value");
+            boost::mutex::scoped_lock l(m_Mutex);
+            values.push_back(it == rs.m_row.end() ? 0 : boost::any_cast<uint32_t>(it->second.second));
+        }
+
+        size_t size()
+        {
+            boost::mutex::scoped_lock l(m_Mutex);
+            return values.size();
+        }
+    };
+
+    void waitFor(CollectValues& collect, size_t count)
+    {
+        const timespec ts = {0 , 1000000};
+        for (size_t i = 0; i < 1000 && collect.size() < count; ++i)
+            ::nanosleep(&ts, NULL);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_TableMapMismatch)
+    {
+        conn->query("DROP TABLE IF EXISTS test");
+        conn->query("CREATE TABLE test (value INT)");
+
+        CollectValues collect;
+        m_Callback.setCallback(boost::ref(collect));
+
+        conn->query("INSERT INTO test VALUES (1)");
+        waitFor(collect, 1);
+        BOOST_REQUIRE_EQUAL(collect.size(), 1U);
+
+        // Not in the binlog: the slave learns of it only from the next TABLE_MAP event,
+        // and the rows event after it must still be given.
+        conn->query("SET sql_log_bin = 0");
+        conn->query("ALTER TABLE test ADD COLUMN extra INT");
+        conn->query("SET sql_log_bin = 1");
+
+        conn->query("INSERT INTO test VALUES (2, 20)");
+        waitFor(collect, 2);
+
+        m_Callback.setCallback();
+
+        BOOST_REQUIRE_EQUAL(collect.values.size(), 2U);
+        BOOST_CHECK_EQUAL(collect.values[1], 2U);
+    }
+
+    struct NullRowHandler : public slave::RowHandler
+    {
+        const unsigned char* onRow(slave::Table&, Image, const unsigned char*,
+                                   const std::vector<unsigned char>&, time_t, unsigned int)
+        {
+            return NULL;
+        }
+    };
+
+    BOOST_AUTO_TEST_CASE(test_SnapshotRowHandler)
+    {
+        slave::MasterInfo sMasterInfo;
+        sMasterInfo.host = cfg.mysql_host;
+        sMasterInfo.port = cfg.mysql_port;
+        sMasterInfo.user = cfg.mysql_user;
+        sMasterInfo.password = cfg.mysql_pass;
+
+        slave::EmptyExtState state;
+        slave::Slave handled(sMasterInfo, state);
+        handled.setRowHandler(cfg.mysql_db, "test", slave::PtrRowHandler(new NullRowHandler));
+        handled.init();
+        handled.createDatabaseStructure();
+
+        // Fails before anything is read, rather than from a worker thread
+        BOOST_CHECK_THROW(handled.snapshot(1), std::runtime_error);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_NanomysqlResult)
+    {
+        nanomysql::Result res;
+
+        conn->query("SELECT 42 AS a, NULL AS b, '-12x' AS c UNION ALL SELECT 7, 'str', '3.5'");
+        conn->store(res);
+
+        BOOST_REQUIRE_EQUAL(res.rows(), 2);
+        BOOST_REQUIRE_EQUAL(res.columns(), 3);
+        BOOST_CHECK_EQUAL(res.name(1), "b");
+        BOOST_CHECK_EQUAL(res.column("c"), 2);
+        BOOST_CHECK(!res.has("d"));
+        BOOST_CHECK_THROW(res.column("d"), std::runtime_error);
+
+        BOOST_CHECK_EQUAL(res.toInt(0, 0), 42);
+        BOOST_CHECK(res.isNull(0, 1));
+        BOOST_CHECK_EQUAL(res.str(0, 1), "");
+        BOOST_CHECK_EQUAL(res.toInt(0, 2), -12);
+
+        BOOST_CHECK_EQUAL(res.toUInt(1, 0), 7U);
+        BOOST_CHECK(!res.isNull(1, 1));
+        BOOST_CHECK_EQUAL(res.str(1, 1), "str");
+        BOOST_CHECK_EQUAL(res.length(1, 1), 3);
+        BOOST_CHECK_CLOSE(res.toDouble(1, 2), 3.5, 0.001);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_ConnectionPool)
+    {
+        slave::ConnectionPool pool(nanomysql::Connection::Attributes(cfg.mysql_host, cfg.mysql_user, cfg.mysql_pass), 1);
+
+        {
+            slave::ConnectionPool::Lease a(pool);
+            slave::ConnectionPool::Lease b(pool);
+            a->query("SELECT 1");
+            b->query("SELECT 1");
+        }
+        BOOST_CHECK_EQUAL(pool.connects(), 2);
+        BOOST_CHECK_EQUAL(pool.idle(), 1);
+
+        {
+            slave::ConnectionPool::Lease a(pool);
+            nanomysql::Result res;
+            a->query("SELECT 2");
+            a->store(res);
+            BOOST_CHECK_EQUAL(res.toInt(0, 0), 2);
+        }
+        BOOST_CHECK_EQUAL(pool.connects(), 2);
+
+        // A failed query may leave the connection half read: it is not given back
+        try {
+            slave::ConnectionPool::Lease a(pool);
+            a->query("SELECT * FROM no_such_table_here");
+        } catch (const std::runtime_error&) {
+        }
+        BOOST_CHECK_EQUAL(pool.idle(), 0);
+
+        {
+            slave::ConnectionPool::Lease a(pool);
+        }
+        BOOST_CHECK_EQUAL(pool.connects(), 3);
+
+        pool.clear();
+        BOOST_CHECK_EQUAL(pool.idle(), 0);
+    }
+
     BOOST_AUTO_TEST_SUITE_END()
 }// anonymous-namespace